@@ -59,7 +59,6 @@ class ChatServer : noncopyable
                        const string& message,
                        Timestamp)
   {
-    EventLoop::Functor f = std::bind(&ChatServer::distributeMessage, this, message);
     LOG_DEBUG;
 
     MutexLockGuard lock(mutex_);
@@ -67,7 +66,7 @@ class ChatServer : noncopyable
         it != loops_.end();
         ++it)
     {
-      (*it)->queueInLoop(f);
+      (*it)->queueInLoop(std::bind(&ChatServer::distributeMessage, this, message));
     }
     LOG_DEBUG;
   }
@@ -44,9 +44,9 @@ void MemcacheServer::stop()
 bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy policy, bool* exists)
 {
   assert(item->neededBytes() == 0);
-  MutexLock& mutex = shards_[item->hash() % kShards].mutex;
+  SpinThenParkMutex& mutex = shards_[item->hash() % kShards].mutex;
   ItemMap& items = shards_[item->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
+  LockGuard<SpinThenParkMutex> lock(mutex);
   ItemMap::const_iterator it = items.find(item);
   *exists = it != items.end();
   if (policy == Item::kSet)
@@ -139,18 +139,18 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
 
 ConstItemPtr MemcacheServer::getItem(const ConstItemPtr& key) const
 {
-  MutexLock& mutex = shards_[key->hash() % kShards].mutex;
+  SpinThenParkMutex& mutex = shards_[key->hash() % kShards].mutex;
   const ItemMap& items = shards_[key->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
+  LockGuard<SpinThenParkMutex> lock(mutex);
   ItemMap::const_iterator it = items.find(key);
   return it != items.end() ? *it : ConstItemPtr();
 }
 
 bool MemcacheServer::deleteItem(const ConstItemPtr& key)
 {
-  MutexLock& mutex = shards_[key->hash() % kShards].mutex;
+  SpinThenParkMutex& mutex = shards_[key->hash() % kShards].mutex;
   ItemMap& items = shards_[key->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
+  LockGuard<SpinThenParkMutex> lock(mutex);
   return items.erase(key) == 1;
 }
 
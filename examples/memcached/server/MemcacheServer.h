@@ -71,7 +71,7 @@ class MemcacheServer : muduo::noncopyable
   struct MapWithLock
   {
     ItemMap items;
-    mutable muduo::MutexLock mutex;
+    mutable muduo::SpinThenParkMutex mutex;
   };
 
   const static int kShards = 4096;
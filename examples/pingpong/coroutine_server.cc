@@ -0,0 +1,62 @@
+#include "muduo/net/TcpServer.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/Coroutine.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// same as server.cc, with a coroutine per connection instead of callbacks
+coro::Task<> session(TcpConnectionPtr conn)
+{
+  conn->setTcpNoDelay(true);
+  coro::Stream stream(conn);
+  while (Buffer* buf = co_await stream.read())
+  {
+    co_await stream.write(buf);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    fprintf(stderr, "Usage: coroutine_server <address> <port> <threads>\n");
+  }
+  else
+  {
+    LOG_INFO << "pid = " << getpid() << ", tid = " << CurrentThread::tid();
+    Logger::setLogLevel(Logger::WARN);
+
+    const char* ip = argv[1];
+    uint16_t port = static_cast<uint16_t>(atoi(argv[2]));
+    InetAddress listenAddr(ip, port);
+    int threadCount = atoi(argv[3]);
+
+    EventLoop loop;
+
+    TcpServer server(&loop, listenAddr, "PingPong");
+
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        coro::spawn(session(conn));
+      }
+    });
+
+    if (threadCount > 1)
+    {
+      server.setThreadNum(threadCount);
+    }
+
+    server.start();
+
+    loop.loop();
+  }
+}
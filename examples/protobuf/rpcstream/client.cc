@@ -0,0 +1,129 @@
+#include "examples/protobuf/rpcstream/feed.pb.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpConnection.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Subscribes a feed, optionally consumes slowly, to see the server stop
+// producing instead of piling up updates in its output buffer.
+class FeedClient : noncopyable
+{
+ public:
+  FeedClient(EventLoop* loop, const InetAddress& serverAddr, int64_t count, int delayUs)
+    : loop_(loop),
+      client_(loop, serverAddr, "FeedClient"),
+      channel_(new RpcChannel),
+      count_(count),
+      delayUs_(delayUs),
+      received_(0),
+      lastSeq_(-1),
+      bytes_(0)
+  {
+    client_.setConnectionCallback(
+        std::bind(&FeedClient::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&RpcChannel::onMessage, get_pointer(channel_), _1, _2, _3));
+  }
+
+  void connect()
+  {
+    client_.connect();
+  }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      channel_->setConnection(conn);
+      start_ = Timestamp::now();
+      RpcStreamPtr stream = channel_->newStream(
+          feed::FeedService::descriptor()->FindMethodByName("Subscribe"));
+      stream->setMessageCallback(
+          std::bind(&FeedClient::onUpdate, this, _1, _2));
+      stream->setCloseCallback(
+          std::bind(&FeedClient::onClose, this, _1));
+      stream->open();
+      feed::SubscribeRequest request;
+      request.set_topic("quotes");
+      request.set_count(count_);
+      stream->write(request);
+      // server push, nothing more to send
+      stream->close();
+      loop_->runEvery(1.0, std::bind(&FeedClient::printStats, this));
+    }
+    else
+    {
+      loop_->quit();
+    }
+  }
+
+  void onUpdate(const RpcStreamPtr&, const MessagePtr& message)
+  {
+    const feed::Update& update = static_cast<const feed::Update&>(*message);
+    if (update.seq() != lastSeq_ + 1)
+    {
+      LOG_ERROR << "out of order " << update.seq() << " after " << lastSeq_;
+    }
+    lastSeq_ = update.seq();
+    ++received_;
+    bytes_ += update.payload().size();
+    if (delayUs_ > 0)
+    {
+      ::usleep(delayUs_);
+    }
+  }
+
+  void onClose(const RpcStreamPtr& stream)
+  {
+    double seconds = timeDifference(Timestamp::now(), start_);
+    printf("stream closed %s, %" PRId64 " updates in %f seconds, %.1f updates/s, %.2f MiB/s\n",
+           stream->error().c_str(), received_, seconds, static_cast<double>(received_) / seconds,
+           static_cast<double>(bytes_) / seconds / 1024 / 1024);
+    client_.disconnect();
+  }
+
+  void printStats()
+  {
+    printf("%" PRId64 " updates received, last seq %" PRId64 "\n", received_, lastSeq_);
+  }
+
+  EventLoop* loop_;
+  TcpClient client_;
+  RpcChannelPtr channel_;
+  const int64_t count_;
+  const int delayUs_;
+  Timestamp start_;
+  int64_t received_;
+  int64_t lastSeq_;
+  int64_t bytes_;
+};
+
+int main(int argc, char* argv[])
+{
+  LOG_INFO << "pid = " << getpid();
+  if (argc > 1)
+  {
+    int64_t count = argc > 2 ? atoll(argv[2]) : 1000000;
+    int delayUs = argc > 3 ? atoi(argv[3]) : 0;
+    EventLoop loop;
+    InetAddress serverAddr(argv[1], 9982);
+    FeedClient client(&loop, serverAddr, count, delayUs);
+    client.connect();
+    loop.loop();
+  }
+  else
+  {
+    printf("Usage: %s host_ip [count] [delay_us_per_update]\n", argv[0]);
+  }
+}
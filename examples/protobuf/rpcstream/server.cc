@@ -0,0 +1,113 @@
+#include "examples/protobuf/rpcstream/feed.pb.h"
+
+#include "muduo/base/Atomic.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/protorpc/RpcServer.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Pushes updates as fast as flow control allows.
+class FeedServer : noncopyable
+{
+ public:
+  FeedServer(EventLoop* loop, const InetAddress& listenAddr, int payloadSize)
+    : server_(loop, listenAddr),
+      payload_(payloadSize, 'x')
+  {
+    server_.registerStream(feed::FeedService::descriptor()->FindMethodByName("Subscribe"),
+                           std::bind(&FeedServer::onSubscribe, this, _1));
+    loop->runEvery(1.0, std::bind(&FeedServer::printStats, this));
+  }
+
+  void setThreadNum(int numThreads)
+  {
+    server_.setThreadNum(numThreads);
+  }
+
+  void start()
+  {
+    server_.start();
+  }
+
+ private:
+  struct Subscription
+  {
+    int64_t seq = 0;
+    int64_t count = -1;  // not subscribed yet
+  };
+  typedef std::shared_ptr<Subscription> SubscriptionPtr;
+
+  void onSubscribe(const RpcStreamPtr& stream)
+  {
+    SubscriptionPtr sub(new Subscription);
+    stream->setMessageCallback(
+        std::bind(&FeedServer::onRequest, this, sub, _1, _2));
+    stream->setWritableCallback(
+        std::bind(&FeedServer::produce, this, sub, _1));
+    stream->setCloseCallback([](const RpcStreamPtr& s)
+      {
+        LOG_INFO << "stream " << s->id() << " " << (s->error().empty() ? "finished by client" : s->error());
+      });
+  }
+
+  void onRequest(const SubscriptionPtr& sub, const RpcStreamPtr& stream, const MessagePtr& message)
+  {
+    const feed::SubscribeRequest& request = static_cast<const feed::SubscribeRequest&>(*message);
+    LOG_INFO << "stream " << stream->id() << " subscribes " << request.topic()
+             << " count " << request.count();
+    if (sub->count < 0)
+    {
+      sub->count = request.count();
+      produce(sub, stream);
+    }
+  }
+
+  void produce(const SubscriptionPtr& sub, const RpcStreamPtr& stream)
+  {
+    feed::Update update;
+    update.set_payload(payload_);
+    while (sub->count == 0 || sub->seq < sub->count)
+    {
+      update.set_seq(sub->seq++);
+      sent_.increment();
+      if (!stream->write(update))
+      {
+        // stops producing until the client catches up
+        return;
+      }
+    }
+    stream->close();
+  }
+
+  void printStats()
+  {
+    int64_t sent = sent_.getAndSet(0);
+    if (sent > 0)
+    {
+      printf("%" PRId64 " updates/s\n", sent);
+    }
+  }
+
+  RpcServer server_;
+  const string payload_;
+  AtomicInt64 sent_;
+};
+
+int main(int argc, char* argv[])
+{
+  int nThreads = argc > 1 ? atoi(argv[1]) : 0;
+  int payloadSize = argc > 2 ? atoi(argv[2]) : 64;
+  LOG_INFO << "pid = " << getpid() << " threads = " << nThreads;
+  EventLoop loop;
+  InetAddress listenAddr(9982);
+  FeedServer server(&loop, listenAddr, payloadSize);
+  server.setThreadNum(nThreads);
+  server.start();
+  loop.loop();
+}
@@ -0,0 +1,154 @@
+#include "examples/socks4a/tunnel.h"
+
+#include "muduo/base/Thread.h"
+
+#include <map>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// source -> relay:kRelayPort -> sink:kSinkPort, all on loopback,
+// the relay runs in the main thread, as tcprelay does.
+const uint16_t kRelayPort = 26666;
+const uint16_t kSinkPort = 26667;
+const size_t kChunk = 256 * 1024;
+
+double threadCpuSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+int64_t sink(int listenfd)
+{
+  int sockfd = ::accept(listenfd, NULL, NULL);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "accept";
+  }
+  std::vector<char> buf(kChunk);
+  int64_t total = 0;
+  ssize_t n;
+  while ((n = ::read(sockfd, buf.data(), buf.size())) > 0)
+  {
+    total += n;
+  }
+  ::close(sockfd);
+  return total;
+}
+
+int64_t source(const InetAddress& relayAddr, double seconds)
+{
+  int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(sockfd, relayAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0)
+  {
+    LOG_SYSFATAL << "connect";
+  }
+  std::vector<char> buf(kChunk, 'x');
+  int64_t total = 0;
+  Timestamp start(Timestamp::now());
+  while (timeDifference(Timestamp::now(), start) < seconds)
+  {
+    ssize_t n = ::write(sockfd, buf.data(), buf.size());
+    if (n <= 0)
+    {
+      break;
+    }
+    total += n;
+  }
+  // half-closed, the relay closes us when the sink has got everything
+  ::shutdown(sockfd, SHUT_WR);
+  char c;
+  while (::read(sockfd, &c, 1) > 0)
+  {
+  }
+  ::close(sockfd);
+  return total;
+}
+
+void run(bool splice, double seconds)
+{
+  int listenfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  InetAddress sinkAddr("127.0.0.1", kSinkPort);
+  int yes = 1;
+  ::setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
+  if (::bind(listenfd, sinkAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0
+      || ::listen(listenfd, 5) < 0)
+  {
+    LOG_SYSFATAL << "sink";
+  }
+
+  EventLoop loop;
+  InetAddress relayAddr("127.0.0.1", kRelayPort);
+  TcpServer server(&loop, relayAddr, "RelayBench");
+  std::map<string, TunnelPtr> tunnels;
+  server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      conn->setTcpNoDelay(true);
+      conn->stopRead();
+      TunnelPtr tunnel(new Tunnel(&loop, sinkAddr, conn, splice));
+      tunnel->setup();
+      tunnel->connect();
+      tunnels[conn->name()] = tunnel;
+    }
+    else
+    {
+      tunnels[conn->name()]->disconnect();
+      tunnels.erase(conn->name());
+    }
+  });
+  server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    if (!conn->getContext().empty())
+    {
+      boost::any_cast<const TcpConnectionPtr&>(conn->getContext())->send(buf);
+    }
+  });
+  server.start();
+
+  int64_t sent = 0;
+  int64_t received = 0;
+  double elapsed = 0;
+  Thread test([&] {
+    Thread sinkThread([&] { received = sink(listenfd); });
+    sinkThread.start();
+    Timestamp start(Timestamp::now());
+    sent = source(relayAddr, seconds);
+    sinkThread.join();
+    elapsed = timeDifference(Timestamp::now(), start);
+    loop.runAfter(0.1, [&loop] { loop.quit(); });
+  });
+
+  double cpu = threadCpuSeconds();
+  test.start();
+  loop.loop();
+  test.join();
+  cpu = threadCpuSeconds() - cpu;
+  ::close(listenfd);
+
+  if (sent != received)
+  {
+    LOG_ERROR << "sent " << sent << " received " << received;
+  }
+  double gigabytes = static_cast<double>(received) / 1e9;
+  printf("%-6s %8.2f Gbps  %6.3f s relay CPU  %6.3f s CPU per GB\n",
+         splice ? "splice" : "copy",
+         gigabytes * 8 / elapsed, cpu, cpu / gigabytes);
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  double seconds = argc > 1 ? atof(argv[1]) : 5;
+  printf("relaying for %.1f seconds on loopback\n", seconds);
+  run(false, seconds);
+  run(true, seconds);
+}
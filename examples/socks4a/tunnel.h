@@ -4,6 +4,7 @@
 #include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/InetAddress.h"
+#include "muduo/net/SpliceRelay.h"
 #include "muduo/net/TcpClient.h"
 #include "muduo/net/TcpServer.h"
 
@@ -13,12 +14,14 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
  public:
   Tunnel(muduo::net::EventLoop* loop,
          const muduo::net::InetAddress& serverAddr,
-         const muduo::net::TcpConnectionPtr& serverConn)
+         const muduo::net::TcpConnectionPtr& serverConn,
+         bool splice = false)
     : client_(loop, serverAddr, serverConn->name()),
-      serverConn_(serverConn)
+      serverConn_(serverConn),
+      splice_(splice)
   {
     LOG_INFO << "Tunnel " << serverConn->peerAddress().toIpPort()
-             << " <-> " << serverAddr.toIpPort();
+             << (splice ? " <=> " : " <-> ") << serverAddr.toIpPort();
   }
 
   ~Tunnel()
@@ -36,6 +39,11 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
         std::bind(&Tunnel::onClientConnection, shared_from_this(), _1));
     client_.setMessageCallback(
         std::bind(&Tunnel::onClientMessage, shared_from_this(), _1, _2, _3));
+    if (splice_)
+    {
+      // SpliceRelay has its own flow control
+      return;
+    }
     serverConn_->setHighWaterMarkCallback(
         std::bind(&Tunnel::onHighWaterMarkWeak,
                   std::weak_ptr<Tunnel>(shared_from_this()), kServer, _1, _2),
@@ -64,6 +72,7 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
       serverConn_->shutdown();
     }
     clientConn_.reset();
+    relay_.reset();
   }
 
   void onClientConnection(const muduo::net::TcpConnectionPtr& conn)
@@ -72,7 +81,14 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
     using std::placeholders::_2;
 
     LOG_DEBUG << (conn->connected() ? "UP" : "DOWN");
-    if (conn->connected())
+    if (conn->connected() && splice_)
+    {
+      conn->setTcpNoDelay(true);
+      clientConn_ = conn;
+      relay_ = std::make_shared<muduo::net::SpliceRelay>(serverConn_, conn);
+      relay_->start();
+    }
+    else if (conn->connected())
     {
       conn->setTcpNoDelay(true);
       conn->setHighWaterMarkCallback(
@@ -189,6 +205,9 @@ class Tunnel : public std::enable_shared_from_this<Tunnel>,
   muduo::net::TcpClient client_;
   muduo::net::TcpConnectionPtr serverConn_;
   muduo::net::TcpConnectionPtr clientConn_;
+  // bytes are moved by the kernel, instead of the message callbacks
+  const bool splice_;
+  muduo::net::SpliceRelayPtr relay_;
 };
 typedef std::shared_ptr<Tunnel> TunnelPtr;
 
@@ -0,0 +1,39 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_BASE_FUTEX_H
+#define MUDUO_BASE_FUTEX_H
+
+#include <atomic>
+
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace muduo
+{
+namespace detail
+{
+
+inline void futexWait(std::atomic<uint32_t>* addr, uint32_t expected)
+{
+  // returns at once if *addr != expected, spurious wakeups are fine.
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE,
+            expected, NULL, NULL, 0);
+}
+
+inline void futexWake(std::atomic<uint32_t>* addr, int count)
+{
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE,
+            count, NULL, NULL, 0);
+}
+
+}  // namespace detail
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_FUTEX_H
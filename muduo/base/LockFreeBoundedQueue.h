@@ -0,0 +1,251 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_LOCKFREEBOUNDEDQUEUE_H
+#define MUDUO_BASE_LOCKFREEBOUNDEDQUEUE_H
+
+#include "muduo/base/Futex.h"
+#include "muduo/base/noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+
+namespace muduo
+{
+
+///
+/// Bounded MPMC queue of Dmitry Vyukov, same interface as BoundedBlockingQueue.
+/// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+///
+/// Each slot has a sequence number, producers and consumers claim slots by
+/// CAS on their own position, which are on separate cache lines.
+/// put() and take() spin a little, then sleep on a futex, only when
+/// the queue is full or empty. Capacity is rounded up to a power of 2.
+/// T must be default constructible.
+///
+template<typename T>
+class LockFreeBoundedQueue : noncopyable
+{
+ public:
+  explicit LockFreeBoundedQueue(int maxSize)
+    : capacity_(roundUp(maxSize)),
+      mask_(capacity_ - 1),
+      slots_(new Slot[capacity_]),
+      enqueuePos_(0),
+      dequeuePos_(0),
+      notEmpty_(0),
+      notFull_(0),
+      takers_(0),
+      putters_(0)
+  {
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  void put(const T& x)
+  {
+    T copy(x);
+    put(std::move(copy));
+  }
+
+  void put(T&& x)
+  {
+    for (int i = 0; !tryPut(std::move(x)); ++i)
+    {
+      if (i < kSpinRounds)
+      {
+        sched_yield();
+        continue;
+      }
+      uint32_t seq = notFull_.load(std::memory_order_acquire);
+      putters_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (full())
+      {
+        detail::futexWait(&notFull_, seq);
+      }
+      else
+      {
+        // a taker is releasing the slot
+        sched_yield();
+      }
+      putters_.fetch_sub(1);
+    }
+    wake(&takers_, &notEmpty_);
+  }
+
+  T take()
+  {
+    T x;
+    for (int i = 0; !tryTake(&x); ++i)
+    {
+      if (i < kSpinRounds)
+      {
+        sched_yield();
+        continue;
+      }
+      uint32_t seq = notEmpty_.load(std::memory_order_acquire);
+      takers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (empty())
+      {
+        detail::futexWait(&notEmpty_, seq);
+      }
+      else
+      {
+        // a putter is filling the slot
+        sched_yield();
+      }
+      takers_.fetch_sub(1);
+    }
+    wake(&putters_, &notFull_);
+    return x;
+  }
+
+  /// Never blocks, returns false if full, x is not moved from then.
+  /// Doesn't wake up blocking take(), use put() if there may be one.
+  bool tryPut(T&& x)
+  {
+    Slot* slot = NULL;
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      slot = &slots_[pos & mask_];
+      size_t seq = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0)
+      {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = std::move(x);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Never blocks, returns false if empty.
+  /// Doesn't wake up blocking put(), use take() if there may be one.
+  bool tryTake(T* x)
+  {
+    Slot* slot = NULL;
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      slot = &slots_[pos & mask_];
+      size_t seq = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0)
+      {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    *x = std::move(slot->value);
+    slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // approximate, if other threads are putting or taking.
+  bool empty() const
+  {
+    return size() == 0;
+  }
+
+  bool full() const
+  {
+    return size() >= capacity_;
+  }
+
+  size_t size() const
+  {
+    size_t dequeuePos = dequeuePos_.load(std::memory_order_relaxed);
+    size_t enqueuePos = enqueuePos_.load(std::memory_order_relaxed);
+    return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+  }
+
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+ private:
+  static const int kSpinRounds = 16;
+  static const size_t kCacheLineSize = 64;
+
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t roundUp(int maxSize)
+  {
+    assert(maxSize > 0);
+    size_t n = 2;
+    while (n < static_cast<size_t>(maxSize))
+    {
+      n <<= 1;
+    }
+    return n;
+  }
+
+  // pairs with the fence in put() or take(), either this sees the waiter,
+  // or the waiter sees the change of queue before sleeping.
+  static void wake(std::atomic<int>* waiters, std::atomic<uint32_t>* futex)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters->load(std::memory_order_relaxed) > 0)
+    {
+      futex->fetch_add(1, std::memory_order_release);
+      detail::futexWake(futex, 1);
+    }
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  char pad0_[kCacheLineSize];
+  std::atomic<size_t> enqueuePos_;
+  char pad1_[kCacheLineSize - sizeof(size_t)];
+  std::atomic<size_t> dequeuePos_;
+  char pad2_[kCacheLineSize - sizeof(size_t)];
+  // futex words, bumped to wake up waiters
+  std::atomic<uint32_t> notEmpty_;
+  std::atomic<uint32_t> notFull_;
+  std::atomic<int> takers_;
+  std::atomic<int> putters_;
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_LOCKFREEBOUNDEDQUEUE_H
@@ -0,0 +1,308 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/base/Metrics.h"
+
+#include <algorithm>
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::metrics;
+
+namespace muduo
+{
+namespace metrics
+{
+namespace detail
+{
+
+__thread int t_slot = -1;
+std::atomic<int> g_nextSlot(0);
+
+int assignSlot()
+{
+  t_slot = g_nextSlot.fetch_add(1, std::memory_order_relaxed) % kSlots;
+  return t_slot;
+}
+
+}  // namespace detail
+}  // namespace metrics
+}  // namespace muduo
+
+namespace
+{
+
+void appendf(string* out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+void appendf(string* out, const char* fmt, ...)
+{
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof buf, fmt, args);
+  va_end(args);
+  if (n > 0)
+  {
+    out->append(buf, std::min(static_cast<size_t>(n), sizeof buf - 1));
+  }
+}
+
+void appendHeader(string* out, const Metric& metric, const char* type)
+{
+  appendf(out, "# HELP %s %s\n", metric.name(), metric.help());
+  appendf(out, "# TYPE %s %s\n", metric.name(), type);
+}
+
+const double kPercentiles[] = { 50, 90, 99, 99.9 };
+
+}  // namespace
+
+Metric::Metric(const char* name, const char* help)
+  : name_(name),
+    help_(help)
+{
+}
+
+Counter::Counter(const char* name, const char* help)
+  : Metric(name, help)
+{
+  for (Cell& cell : cells_)
+  {
+    cell.value.store(0, std::memory_order_relaxed);
+  }
+  Registry::instance().add(this);
+}
+
+Counter::~Counter()
+{
+  Registry::instance().remove(this);
+}
+
+int64_t Counter::value() const
+{
+  int64_t sum = 0;
+  for (const Cell& cell : cells_)
+  {
+    sum += cell.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+void Counter::formatText(string* out) const
+{
+  appendf(out, "%s %" PRId64 "\n", name(), value());
+}
+
+void Counter::formatPrometheus(string* out) const
+{
+  appendHeader(out, *this, "counter");
+  formatText(out);
+}
+
+Gauge::Gauge(const char* name, const char* help)
+  : Metric(name, help),
+    value_(0)
+{
+  Registry::instance().add(this);
+}
+
+Gauge::Gauge(const char* name, const char* help, const Callback& cb)
+  : Metric(name, help),
+    value_(0),
+    callback_(cb)
+{
+  Registry::instance().add(this);
+}
+
+Gauge::~Gauge()
+{
+  Registry::instance().remove(this);
+}
+
+int64_t Gauge::value() const
+{
+  return callback_ ? callback_() : value_.load(std::memory_order_relaxed);
+}
+
+void Gauge::formatText(string* out) const
+{
+  appendf(out, "%s %" PRId64 "\n", name(), value());
+}
+
+void Gauge::formatPrometheus(string* out) const
+{
+  appendHeader(out, *this, "gauge");
+  formatText(out);
+}
+
+Histogram::Histogram(const char* name, const char* help)
+  : Metric(name, help)
+{
+  for (auto& shard : shards_)
+  {
+    shard.store(NULL, std::memory_order_relaxed);
+  }
+  Registry::instance().add(this);
+}
+
+Histogram::~Histogram()
+{
+  Registry::instance().remove(this);
+  for (auto& shard : shards_)
+  {
+    delete shard.load(std::memory_order_relaxed);
+  }
+}
+
+Histogram::Shard* Histogram::newShard()
+{
+  std::atomic<Shard*>& slot = shards_[detail::slot()];
+  Shard* shard = new Shard();
+  Shard* expected = NULL;
+  if (!slot.compare_exchange_strong(expected, shard, std::memory_order_acq_rel))
+  {
+    // another thread of the same slot won
+    delete shard;
+    shard = expected;
+  }
+  return shard;
+}
+
+int64_t Histogram::upperBound(int bucket)
+{
+  if (bucket < kSubBuckets)
+  {
+    return bucket;
+  }
+  int e = bucket / kSubBuckets + kSubBucketBits - 1;
+  int64_t top = bucket % kSubBuckets + kSubBuckets;
+  return ((top + 1) << (e - kSubBucketBits)) - 1;
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+  Snapshot result;
+  result.buckets.resize(kBuckets);
+  for (const auto& slot : shards_)
+  {
+    const Shard* shard = slot.load(std::memory_order_acquire);
+    if (shard == NULL)
+    {
+      continue;
+    }
+    for (int i = 0; i < kBuckets; ++i)
+    {
+      int64_t n = shard->counts[i].load(std::memory_order_relaxed);
+      result.buckets[i] += n;
+      result.count += n;
+    }
+    result.sum += shard->sum.load(std::memory_order_relaxed);
+    result.max = std::max(result.max, shard->max.load(std::memory_order_relaxed));
+  }
+  return result;
+}
+
+int64_t Histogram::Snapshot::percentile(double p) const
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+  int64_t rank = static_cast<int64_t>(static_cast<double>(count) * p / 100.0);
+  if (rank >= count)
+  {
+    rank = count - 1;
+  }
+  int64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i)
+  {
+    seen += buckets[i];
+    if (seen > rank)
+    {
+      return std::min(upperBound(static_cast<int>(i)), max);
+    }
+  }
+  return max;
+}
+
+void Histogram::formatText(string* out) const
+{
+  Snapshot snap(snapshot());
+  appendf(out, "%s count=%" PRId64 " sum=%" PRId64, name(), snap.count, snap.sum);
+  for (double p : kPercentiles)
+  {
+    appendf(out, " p%g=%" PRId64, p, snap.percentile(p));
+  }
+  appendf(out, " max=%" PRId64 "\n", snap.max);
+}
+
+// As a summary, quantiles are computed from the buckets.
+void Histogram::formatPrometheus(string* out) const
+{
+  Snapshot snap(snapshot());
+  appendHeader(out, *this, "summary");
+  for (double p : kPercentiles)
+  {
+    appendf(out, "%s{quantile=\"%g\"} %" PRId64 "\n", name(), p / 100, snap.percentile(p));
+  }
+  appendf(out, "%s_sum %" PRId64 "\n", name(), snap.sum);
+  appendf(out, "%s_count %" PRId64 "\n", name(), snap.count);
+}
+
+Registry& Registry::instance()
+{
+  // constructed by the first metric, never destroyed, as metrics may be
+  // destroyed after any static object.
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+void Registry::add(Metric* metric)
+{
+  MutexLockGuard lock(mutex_);
+  metrics_.push_back(metric);
+}
+
+void Registry::remove(Metric* metric)
+{
+  MutexLockGuard lock(mutex_);
+  metrics_.erase(std::remove(metrics_.begin(), metrics_.end(), metric), metrics_.end());
+}
+
+std::vector<const Metric*> Registry::sorted() const
+{
+  std::vector<const Metric*> result(metrics_.begin(), metrics_.end());
+  std::sort(result.begin(), result.end(), [](const Metric* lhs, const Metric* rhs) {
+    return strcmp(lhs->name(), rhs->name()) < 0;
+  });
+  return result;
+}
+
+// with the lock held, or a metric could be destroyed meanwhile
+string Registry::toText() const
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (const Metric* metric : sorted())
+  {
+    metric->formatText(&result);
+  }
+  return result;
+}
+
+string Registry::toPrometheus() const
+{
+  string result;
+  MutexLockGuard lock(mutex_);
+  for (const Metric* metric : sorted())
+  {
+    metric->formatPrometheus(&result);
+  }
+  return result;
+}
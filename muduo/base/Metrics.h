@@ -0,0 +1,242 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_METRICS_H
+#define MUDUO_BASE_METRICS_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Types.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+namespace muduo
+{
+namespace metrics
+{
+
+namespace detail
+{
+
+const int kSlots = 32;  // per-thread shards of a metric, threads share them beyond that
+const int kCacheLineSize = 64;
+
+extern __thread int t_slot;
+int assignSlot();
+
+// slot of calling thread
+inline int slot()
+{
+  if (__builtin_expect(t_slot < 0, 0))
+  {
+    return assignSlot();
+  }
+  return t_slot;
+}
+
+}  // namespace detail
+
+///
+/// A named value in Registry, usually a global or static object.
+/// Names follow Prometheus conventions, eg. muduo_tcp_bytes_sent_total.
+///
+/// A global Histogram is allocated and never destroyed, as its shards are
+/// freed on destruction while threads may still record at exit, eg.
+/// metrics::Histogram& g_rtt = *new metrics::Histogram(...);
+///
+/// Concrete metrics are final, they add themselves to Registry when
+/// constructed and remove themselves first thing when destroyed, so
+/// Registry never formats a half-destroyed one.
+///
+class Metric : noncopyable
+{
+ public:
+  Metric(const char* name, const char* help);
+  virtual ~Metric() = default;
+
+  const char* name() const { return name_; }
+  const char* help() const { return help_; }
+
+  virtual void formatText(string* out) const = 0;
+  virtual void formatPrometheus(string* out) const = 0;
+
+ private:
+  const char* const name_;
+  const char* const help_;
+};
+
+///
+/// Monotonic counter, add() touches a cache line of the calling thread only,
+/// value() sums all threads.
+///
+class Counter final : public Metric
+{
+ public:
+  Counter(const char* name, const char* help);
+  ~Counter() override;
+
+  void add(int64_t n = 1)
+  {
+    cells_[detail::slot()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  int64_t value() const;
+
+  void formatText(string* out) const override;
+  void formatPrometheus(string* out) const override;
+
+ private:
+  struct alignas(detail::kCacheLineSize) Cell
+  {
+    std::atomic<int64_t> value;
+  };
+
+  Cell cells_[detail::kSlots];
+};
+
+///
+/// Current value, set() or add() by any thread, or computed by a callback on read.
+///
+class Gauge final : public Metric
+{
+ public:
+  typedef std::function<int64_t()> Callback;
+
+  Gauge(const char* name, const char* help);
+  Gauge(const char* name, const char* help, const Callback& cb);
+  ~Gauge() override;
+
+  void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+  void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+  int64_t value() const;
+
+  void formatText(string* out) const override;
+  void formatPrometheus(string* out) const override;
+
+ private:
+  std::atomic<int64_t> value_;
+  Callback callback_;
+};
+
+///
+/// Distribution of non-negative integers, eg. latency in microseconds.
+///
+/// Buckets are log-linear like HdrHistogram, 16 per power of 2, so
+/// percentiles are within 1/16 of the true value. Values above 2^40 are
+/// clamped. Each thread records to its own shard, which is allocated on
+/// first use, shards are merged on read.
+///
+class Histogram final : public Metric
+{
+ public:
+  static const int kSubBucketBits = 4;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kMaxBits = 40;
+  static const int kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+  struct Snapshot
+  {
+    int64_t count = 0;
+    int64_t sum = 0;
+    int64_t max = 0;
+    std::vector<int64_t> buckets;
+
+    /// upper bound of bucket at p percent, 0 if empty.
+    int64_t percentile(double p) const;
+  };
+
+  Histogram(const char* name, const char* help);
+  ~Histogram() override;
+
+  void record(int64_t value)
+  {
+    Shard* shard = shards_[detail::slot()].load(std::memory_order_acquire);
+    if (__builtin_expect(shard == NULL, 0))
+    {
+      shard = newShard();
+    }
+    if (value < 0)
+    {
+      value = 0;
+    }
+    shard->counts[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    shard->sum.fetch_add(value, std::memory_order_relaxed);
+    if (value > shard->max.load(std::memory_order_relaxed))
+    {
+      shard->max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  Snapshot snapshot() const;
+
+  static int bucketOf(int64_t value)
+  {
+    if (value < kSubBuckets)
+    {
+      return static_cast<int>(value);
+    }
+    if (value >= (int64_t(1) << kMaxBits))
+    {
+      return kBuckets - 1;
+    }
+    int e = 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+    int top = static_cast<int>(value >> (e - kSubBucketBits));
+    return (e - kSubBucketBits + 1) * kSubBuckets + top - kSubBuckets;
+  }
+
+  /// largest value in bucket
+  static int64_t upperBound(int bucket);
+
+  void formatText(string* out) const override;
+  void formatPrometheus(string* out) const override;
+
+ private:
+  struct Shard
+  {
+    std::atomic<int64_t> counts[kBuckets];
+    std::atomic<int64_t> sum;
+    std::atomic<int64_t> max;
+  };
+
+  Shard* newShard();
+
+  std::atomic<Shard*> shards_[detail::kSlots];
+};
+
+///
+/// All metrics of the process, served by Inspector at /metrics/text and
+/// /metrics/prometheus.
+/// Metrics are formatted with the lock held, so a Gauge callback must not
+/// create or destroy metrics.
+///
+class Registry : noncopyable
+{
+ public:
+  static Registry& instance();
+
+  void add(Metric* metric);
+  void remove(Metric* metric);
+
+  string toText() const;
+  string toPrometheus() const;
+
+ private:
+  Registry() = default;
+
+  // sorted by name
+  std::vector<const Metric*> sorted() const REQUIRES(mutex_);
+
+  mutable MutexLock mutex_;
+  std::vector<Metric*> metrics_ GUARDED_BY(mutex_);
+};
+
+}  // namespace metrics
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_METRICS_H
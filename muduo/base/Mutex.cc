@@ -0,0 +1,127 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Futex.h"
+
+#include <algorithm>
+
+#include <limits.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+namespace
+{
+
+const int kMaxSpins = 100;  // same as glibc
+const bool kMultiCore = ::sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+}  // namespace
+
+void SpinThenParkMutex::lockSlow()
+{
+  // the holder can't make progress while we spin on a single CPU.
+  int spins = spins_.load(std::memory_order_relaxed);
+  const int maxSpins = kMultiCore ? std::min(kMaxSpins, spins * 2 + 10) : 0;
+  int count = 0;
+  uint32_t c = state_.load(std::memory_order_relaxed);
+  for (; count < maxSpins; ++count)
+  {
+    if (c == kUnlocked
+        && state_.compare_exchange_weak(c, kLocked, std::memory_order_acquire))
+    {
+      spins_.store(spins + (count - spins) / 8, std::memory_order_relaxed);
+      return;
+    }
+    cpuRelax();
+    c = state_.load(std::memory_order_relaxed);
+  }
+  spins_.store(spins + (count - spins) / 8, std::memory_order_relaxed);
+
+  // mutex3 of Ulrich Drepper, "Futexes Are Tricky"
+  if (c != kContended)
+  {
+    c = state_.exchange(kContended, std::memory_order_acquire);
+  }
+  while (c != kUnlocked)
+  {
+    detail::futexWait(&state_, kContended);
+    c = state_.exchange(kContended, std::memory_order_acquire);
+  }
+}
+
+void SpinThenParkMutex::wakeOne()
+{
+  detail::futexWake(&state_, 1);
+}
+
+void SpinThenParkRWMutex::waitForReaders()
+{
+  for (int i = 0; kMultiCore && i < kMaxSpins; ++i)
+  {
+    if ((state_.load(std::memory_order_acquire) & kReaderMask) == 0)
+    {
+      return;
+    }
+    cpuRelax();
+  }
+  for (;;)
+  {
+    uint32_t s = state_.load(std::memory_order_acquire);
+    if ((s & kReaderMask) == 0)
+    {
+      return;
+    }
+    if (!(s & kWaiters)
+        && !state_.compare_exchange_weak(s, s | kWaiters, std::memory_order_relaxed))
+    {
+      continue;
+    }
+    detail::futexWait(&state_, s | kWaiters);
+  }
+}
+
+void SpinThenParkRWMutex::lockSharedSlow()
+{
+  for (int i = 0; ; ++i)
+  {
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    if (!(s & kWriter))
+    {
+      if (state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+      {
+        return;
+      }
+      continue;
+    }
+    if (kMultiCore && i < kMaxSpins)
+    {
+      cpuRelax();
+      continue;
+    }
+    // kWaiters is only set while kWriter is, unlock() clears both
+    if (!(s & kWaiters)
+        && !state_.compare_exchange_weak(s, s | kWaiters, std::memory_order_relaxed))
+    {
+      continue;
+    }
+    detail::futexWait(&state_, s | kWaiters);
+  }
+}
+
+void SpinThenParkRWMutex::wakeAll()
+{
+  detail::futexWake(&state_, INT_MAX);
+}
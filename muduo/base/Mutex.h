@@ -8,8 +8,10 @@
 
 #include "muduo/base/CurrentThread.h"
 #include "muduo/base/noncopyable.h"
+#include <atomic>
 #include <assert.h>
 #include <pthread.h>
+#include <stdint.h>
 
 // Thread safety annotations {
 // https://clang.llvm.org/docs/ThreadSafetyAnalysis.html
@@ -198,6 +200,165 @@ class CAPABILITY("mutex") MutexLock : noncopyable
   pid_t holder_;
 };
 
+// Drop-in replacement of MutexLock for short critical sections,
+// works with LockGuard but not Condition.
+//
+// Spins adaptively like PTHREAD_MUTEX_ADAPTIVE_NP before sleeping on a futex,
+// the uncontended lock() and unlock() are one atomic instruction each.
+// It never spins on a single CPU machine.
+class CAPABILITY("mutex") SpinThenParkMutex : noncopyable
+{
+ public:
+  SpinThenParkMutex()
+    : state_(kUnlocked),
+      spins_(0),
+      holder_(0)
+  {
+  }
+
+  ~SpinThenParkMutex()
+  {
+    assert(holder_ == 0);
+  }
+
+  bool isLockedByThisThread() const
+  {
+    return holder_ == CurrentThread::tid();
+  }
+
+  void assertLocked() const ASSERT_CAPABILITY(this)
+  {
+    assert(isLockedByThisThread());
+  }
+
+  void lock() ACQUIRE()
+  {
+    uint32_t c = kUnlocked;
+    if (!state_.compare_exchange_strong(c, kLocked, std::memory_order_acquire))
+    {
+      lockSlow();
+    }
+    holder_ = CurrentThread::tid();
+  }
+
+  bool tryLock() TRY_ACQUIRE(true)
+  {
+    uint32_t c = kUnlocked;
+    if (state_.compare_exchange_strong(c, kLocked, std::memory_order_acquire))
+    {
+      holder_ = CurrentThread::tid();
+      return true;
+    }
+    return false;
+  }
+
+  void unlock() RELEASE()
+  {
+    holder_ = 0;
+    if (state_.exchange(kUnlocked, std::memory_order_release) == kContended)
+    {
+      wakeOne();
+    }
+  }
+
+ private:
+  enum State { kUnlocked, kLocked, kContended };
+
+  void lockSlow();
+  void wakeOne();
+
+  std::atomic<uint32_t> state_;
+  std::atomic<int> spins_;  // moving average of spins to get the lock
+  pid_t holder_;
+};
+
+// Reader-writer lock of the same kind, writers are preferred.
+// LockGuard locks it for writing, ReaderLockGuard for reading.
+class CAPABILITY("mutex") SpinThenParkRWMutex : noncopyable
+{
+ public:
+  SpinThenParkRWMutex()
+    : state_(0),
+      holder_(0)
+  {
+  }
+
+  ~SpinThenParkRWMutex()
+  {
+    assert(holder_ == 0);
+  }
+
+  // of writer
+  bool isLockedByThisThread() const
+  {
+    return holder_ == CurrentThread::tid();
+  }
+
+  void assertLocked() const ASSERT_CAPABILITY(this)
+  {
+    assert(isLockedByThisThread());
+  }
+
+  void lock() ACQUIRE()
+  {
+    writerMutex_.lock();
+    // blocks new readers
+    uint32_t s = state_.fetch_or(kWriter, std::memory_order_acquire);
+    if ((s & kReaderMask) != 0)
+    {
+      waitForReaders();
+    }
+    holder_ = CurrentThread::tid();
+  }
+
+  void unlock() RELEASE()
+  {
+    holder_ = 0;
+    uint32_t s = state_.fetch_and(~(kWriter | kWaiters), std::memory_order_release);
+    if (s & kWaiters)
+    {
+      wakeAll();
+    }
+    writerMutex_.unlock();
+  }
+
+  void lockShared() ACQUIRE_SHARED()
+  {
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    if ((s & kWriter)
+        || !state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+    {
+      lockSharedSlow();
+    }
+  }
+
+  void unlockShared() RELEASE_SHARED()
+  {
+    uint32_t s = state_.fetch_sub(1, std::memory_order_release) - 1;
+    // the last reader lets the writer in
+    if ((s & kReaderMask) == 0 && (s & kWaiters))
+    {
+      if (state_.fetch_and(~kWaiters, std::memory_order_relaxed) & kWaiters)
+      {
+        wakeAll();
+      }
+    }
+  }
+
+ private:
+  static const uint32_t kWriter = 1u << 31;  // held or waiting for readers
+  static const uint32_t kWaiters = 1u << 30;  // sleeping on state_
+  static const uint32_t kReaderMask = kWaiters - 1;
+
+  void waitForReaders();
+  void lockSharedSlow();
+  void wakeAll();
+
+  SpinThenParkMutex writerMutex_;
+  std::atomic<uint32_t> state_;
+  pid_t holder_;
+};
+
 // Use as a stack variable, eg.
 // int Foo::size() const
 // {
@@ -223,11 +384,54 @@ class SCOPED_CAPABILITY MutexLockGuard : noncopyable
   MutexLock& mutex_;
 };
 
+// Same for other mutexes, eg.
+// LockGuard<SpinThenParkMutex> lock(mutex_);
+// locks SpinThenParkRWMutex for writing.
+template<typename Mutex>
+class SCOPED_CAPABILITY LockGuard : noncopyable
+{
+ public:
+  explicit LockGuard(Mutex& mutex) ACQUIRE(mutex)
+    : mutex_(mutex)
+  {
+    mutex_.lock();
+  }
+
+  ~LockGuard() RELEASE()
+  {
+    mutex_.unlock();
+  }
+
+ private:
+
+  Mutex& mutex_;
+};
+
+class SCOPED_CAPABILITY ReaderLockGuard : noncopyable
+{
+ public:
+  explicit ReaderLockGuard(SpinThenParkRWMutex& mutex) ACQUIRE_SHARED(mutex)
+    : mutex_(mutex)
+  {
+    mutex_.lockShared();
+  }
+
+  ~ReaderLockGuard() RELEASE()
+  {
+    mutex_.unlockShared();
+  }
+
+ private:
+
+  SpinThenParkRWMutex& mutex_;
+};
+
 }  // namespace muduo
 
 // Prevent misuse like:
 // MutexLockGuard(mutex_);
 // A tempory object doesn't hold the lock for long!
 #define MutexLockGuard(x) error "Missing guard object name"
+#define ReaderLockGuard(x) error "Missing guard object name"
 
 #endif  // MUDUO_BASE_MUTEX_H
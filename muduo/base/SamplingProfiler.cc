@@ -0,0 +1,365 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/base/SamplingProfiler.h"
+
+#include "muduo/base/Logging.h"
+
+#include <cxxabi.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+namespace
+{
+const double kDrainInterval = 0.1;
+// record(), signalHandler() and the signal trampoline
+const int kMaxSkipFrames = 4;
+
+void* interruptedPc(void* context)
+{
+  const ucontext_t* uc = static_cast<const ucontext_t*>(context);
+#if defined(__x86_64__)
+  return reinterpret_cast<void*>(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+  return reinterpret_cast<void*>(uc->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+  return reinterpret_cast<void*>(uc->uc_mcontext.pc);
+#else
+  (void)uc;
+  return NULL;
+#endif
+}
+
+}  // namespace
+
+SamplingProfiler& SamplingProfiler::instance()
+{
+  // never destroyed, a late SIGPROF or the drainer thread could still use it
+  static SamplingProfiler* profiler = new SamplingProfiler;
+  return *profiler;
+}
+
+SamplingProfiler::SamplingProfiler()
+  : started_(false),
+    samples_(0),
+    cond_(mutex_),
+    dropped_(0)
+{
+  memZero(&oldAction_, sizeof oldAction_);
+}
+
+bool SamplingProfiler::start(int hz)
+{
+  MutexLockGuard lock(mutex_);
+  if (started_.load() || hz <= 0)
+  {
+    return false;
+  }
+  if (!rings_)
+  {
+    rings_.reset(new Ring[kRings]);
+    for (int i = 0; i < kRings; ++i)
+    {
+      Ring& ring = rings_[i];
+      ring.head.store(0, std::memory_order_relaxed);
+      ring.tail = 0;
+      for (Sample& sample : ring.samples)
+      {
+        sample.seq.store(0, std::memory_order_relaxed);
+      }
+    }
+    // the first backtrace() loads libgcc_s, which is not async signal safe
+    void* pcs[2];
+    ::backtrace(pcs, 2);
+  }
+
+  struct sigaction action;
+  memZero(&action, sizeof action);
+  action.sa_sigaction = &SamplingProfiler::signalHandler;
+  action.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  if (::sigaction(SIGPROF, &action, &oldAction_) < 0)
+  {
+    LOG_SYSERR << "SamplingProfiler::start sigaction";
+    return false;
+  }
+
+  started_.store(true);
+  drainer_.reset(new Thread(std::bind(&SamplingProfiler::drainLoop, this), "SamplingProfiler"));
+  drainer_->start();
+
+  struct itimerval timer;
+  int64_t interval = hz > 1000 ? 1000 : 1000000 / hz;
+  timer.it_interval.tv_sec = static_cast<time_t>(interval / 1000000);
+  timer.it_interval.tv_usec = static_cast<suseconds_t>(interval % 1000000);
+  timer.it_value = timer.it_interval;
+  if (::setitimer(ITIMER_PROF, &timer, NULL) < 0)
+  {
+    LOG_SYSERR << "SamplingProfiler::start setitimer";
+  }
+  return true;
+}
+
+void SamplingProfiler::stop()
+{
+  std::unique_ptr<Thread> drainer;
+  {
+  MutexLockGuard lock(mutex_);
+  if (!started_.load())
+  {
+    return;
+  }
+  struct itimerval timer;
+  memZero(&timer, sizeof timer);
+  ::setitimer(ITIMER_PROF, &timer, NULL);
+  // keep our handler if nobody had one, a pending SIGPROF would kill the process
+  if (oldAction_.sa_handler != SIG_DFL)
+  {
+    ::sigaction(SIGPROF, &oldAction_, NULL);
+  }
+  started_.store(false);
+  cond_.notify();
+  drainer.swap(drainer_);
+  }
+  drainer->join();
+  MutexLockGuard lock(mutex_);
+  drain();
+}
+
+bool SamplingProfiler::started() const
+{
+  return started_.load();
+}
+
+int64_t SamplingProfiler::samples() const
+{
+  return samples_.load(std::memory_order_relaxed);
+}
+
+int64_t SamplingProfiler::dropped() const
+{
+  MutexLockGuard lock(mutex_);
+  return dropped_;
+}
+
+void SamplingProfiler::reset()
+{
+  MutexLockGuard lock(mutex_);
+  if (rings_)
+  {
+    drain();
+  }
+  stacks_.clear();
+  dropped_ = 0;
+  samples_.store(0, std::memory_order_relaxed);
+}
+
+void SamplingProfiler::signalHandler(int, siginfo_t*, void* context)
+{
+  int savedErrno = errno;
+  instance().record(context);
+  errno = savedErrno;
+}
+
+// in signal handler, async signal safe
+void SamplingProfiler::record(void* context)
+{
+  if (!started_.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  int tid = CurrentThread::t_cachedTid;
+  if (tid == 0)
+  {
+    tid = static_cast<int>(::syscall(SYS_gettid));
+  }
+  Ring& ring = rings_[tid % kRings];
+  uint64_t pos = ring.head.fetch_add(1, std::memory_order_relaxed);
+  Sample& sample = ring.samples[pos % kRingSize];
+  sample.seq.store(2 * pos + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  void* pcs[kMaxDepth + kMaxSkipFrames];
+  int total = ::backtrace(pcs, kMaxDepth + kMaxSkipFrames);
+  // skips frames of signal handling, which end with the interrupted pc
+  int skip = 0;
+  void* interrupted = interruptedPc(context);
+  if (interrupted)
+  {
+    while (skip < total && skip < kMaxSkipFrames && pcs[skip] != interrupted)
+    {
+      ++skip;
+    }
+  }
+  if (skip == total || skip == kMaxSkipFrames)
+  {
+    skip = total < kMaxSkipFrames ? 0 : kMaxSkipFrames - 1;
+  }
+  int depth = total - skip;
+  if (depth > kMaxDepth)
+  {
+    depth = kMaxDepth;
+  }
+  memcpy(sample.pcs, pcs + skip, depth * sizeof(void*));
+  sample.depth = depth;
+  sample.seq.store(2 * pos + 2, std::memory_order_release);
+  samples_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SamplingProfiler::drainLoop()
+{
+  MutexLockGuard lock(mutex_);
+  while (started_.load())
+  {
+    cond_.waitForSeconds(kDrainInterval);
+    drain();
+  }
+}
+
+// seqlock reader, a sample being overwritten is dropped
+void SamplingProfiler::drain()
+{
+  Sample copy;
+  for (int i = 0; i < kRings; ++i)
+  {
+    Ring& ring = rings_[i];
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    if (head - ring.tail > kRingSize)
+    {
+      dropped_ += static_cast<int64_t>(head - ring.tail - kRingSize);
+      ring.tail = head - kRingSize;
+    }
+    for (; ring.tail < head; ++ring.tail)
+    {
+      uint64_t pos = ring.tail;
+      Sample& sample = ring.samples[pos % kRingSize];
+      uint64_t seq = sample.seq.load(std::memory_order_acquire);
+      if (seq < 2 * pos + 2)
+      {
+        break;  // being written, try next time
+      }
+      copy.depth = sample.depth;
+      if (copy.depth > kMaxDepth)
+      {
+        copy.depth = kMaxDepth;
+      }
+      memcpy(copy.pcs, sample.pcs, copy.depth * sizeof(void*));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq != 2 * pos + 2 || sample.seq.load(std::memory_order_relaxed) != seq)
+      {
+        ++dropped_;
+        continue;
+      }
+      ++stacks_[Stack(copy.pcs, copy.pcs + copy.depth)];
+    }
+  }
+}
+
+const string& SamplingProfiler::symbolize(void* pc, bool leaf)
+{
+  std::map<void*, string>::iterator it = symbols_.find(pc);
+  if (it != symbols_.end())
+  {
+    return it->second;
+  }
+  // return address is after the call instruction, it could be the next function
+  void* addr = leaf ? pc : static_cast<char*>(pc) - 1;
+  string name;
+  char** strings = ::backtrace_symbols(&addr, 1);
+  if (strings)
+  {
+    // bin/exception_test(_ZN3Bar4testEv+0x79) [0x401909]
+    char* str = strings[0];
+    char* leftPar = strchr(str, '(');
+    char* plus = leftPar ? strchr(leftPar, '+') : NULL;
+    if (leftPar && plus && plus > leftPar + 1)
+    {
+      *plus = '\0';
+      int status = 0;
+      char* demangled = abi::__cxa_demangle(leftPar + 1, NULL, NULL, &status);
+      name = status == 0 ? demangled : leftPar + 1;
+      free(demangled);
+    }
+    else
+    {
+      // no symbol, use module and offset
+      if (leftPar)
+      {
+        *leftPar = '\0';
+      }
+      const char* slash = strrchr(str, '/');
+      name = slash ? slash + 1 : str;
+      if (plus)
+      {
+        char* rightPar = strchr(plus, ')');
+        if (rightPar)
+        {
+          *rightPar = '\0';
+        }
+        name += plus;
+      }
+    }
+    free(strings);
+  }
+  if (name.empty())
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "%p", pc);
+    name = buf;
+  }
+  // ';' separates frames in collapsed stacks
+  for (char& c : name)
+  {
+    if (c == ';')
+    {
+      c = ':';
+    }
+  }
+  return symbols_[pc] = name;
+}
+
+string SamplingProfiler::collapsed()
+{
+  MutexLockGuard lock(mutex_);
+  if (!rings_)
+  {
+    return string();
+  }
+  drain();
+  // different pcs in the same functions are merged
+  std::map<string, int64_t> merged;
+  for (const auto& stack : stacks_)
+  {
+    const Stack& pcs = stack.first;
+    string frames;
+    // root first
+    for (size_t i = pcs.size(); i > 0; --i)
+    {
+      frames += symbolize(pcs[i-1], i == 1);
+      if (i > 1)
+      {
+        frames += ';';
+      }
+    }
+    merged[frames] += stack.second;
+  }
+  string result;
+  for (const auto& stack : merged)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, " %lld\n", static_cast<long long>(stack.second));
+    result += stack.first;
+    result += buf;
+  }
+  return result;
+}
@@ -0,0 +1,98 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_SAMPLINGPROFILER_H
+#define MUDUO_BASE_SAMPLINGPROFILER_H
+
+#include "muduo/base/Condition.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Types.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <signal.h>
+
+namespace muduo
+{
+
+///
+/// CPU profiler of the whole process, without gperftools.
+///
+/// SIGPROF of setitimer(ITIMER_PROF) interrupts the thread using CPU,
+/// the signal handler saves its stack with backtrace() into a ring picked
+/// by tid, lock free. A background thread drains rings into counts of
+/// distinct stacks, which are symbolized only when collapsed() is called.
+///
+/// Like gperftools, a sample taken while the interrupted thread holds
+/// the dynamic loader lock (dlopen, throwing exception) could deadlock.
+///
+class SamplingProfiler : noncopyable
+{
+ public:
+  static const int kMaxDepth = 64;
+  static const int kRings = 16;
+  static const int kRingSize = 128;
+
+  static SamplingProfiler& instance();
+
+  /// Starts sampling at hz of CPU time, returns false if already started.
+  bool start(int hz = 99);
+  void stop();
+  bool started() const;
+
+  /// Stacks sampled since start() or reset(), in collapsed format of
+  /// FlameGraph, eg. "main;foo;bar 42", one line per stack.
+  string collapsed();
+  void reset();
+
+  int64_t samples() const;
+  int64_t dropped() const;
+
+ private:
+  struct Sample
+  {
+    std::atomic<uint64_t> seq;  // 2*pos+1 while writing, 2*pos+2 when done
+    int depth;
+    void* pcs[kMaxDepth];
+  };
+
+  struct Ring
+  {
+    std::atomic<uint64_t> head;
+    char pad[64 - sizeof(std::atomic<uint64_t>)];
+    uint64_t tail;  // by drainer only
+    Sample samples[kRingSize];
+  };
+
+  typedef std::vector<void*> Stack;
+
+  SamplingProfiler();
+
+  static void signalHandler(int, siginfo_t*, void*);
+  void record(void* context);
+  void drainLoop();
+  void drain() REQUIRES(mutex_);
+  const string& symbolize(void* pc, bool leaf) REQUIRES(mutex_);
+
+  std::unique_ptr<Ring[]> rings_;  // allocated by the first start()
+  std::atomic<bool> started_;
+  std::atomic<int64_t> samples_;
+  struct sigaction oldAction_;
+
+  mutable MutexLock mutex_;
+  Condition cond_;
+  std::unique_ptr<Thread> drainer_;
+  std::map<Stack, int64_t> stacks_ GUARDED_BY(mutex_);
+  std::map<void*, string> symbols_ GUARDED_BY(mutex_);
+  int64_t dropped_ GUARDED_BY(mutex_);
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_SAMPLINGPROFILER_H
@@ -0,0 +1,150 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/base/SlabAllocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace muduo;
+
+const size_t SlabAllocator::kAlignment;
+const size_t SlabAllocator::kMaxSize;
+const size_t SlabAllocator::kSlabSize;
+
+SlabAllocator::SlabAllocator()
+  : current_(NULL),
+    remaining_(0),
+    reserved_(NULL),
+    bytesInUse_(0),
+    allocations_(0),
+    fallbacks_(0)
+{
+  for (FreeBlock*& list : freeLists_)
+  {
+    list = NULL;
+  }
+}
+
+SlabAllocator::~SlabAllocator()
+{
+  for (void* slab : slabs_)
+  {
+    ::free(slab);
+  }
+  ::free(reserved_);
+}
+
+void* SlabAllocator::allocate(size_t size)
+{
+  if (size > kMaxSize)
+  {
+    {
+    LockGuard<SpinThenParkMutex> lock(mutex_);
+    ++fallbacks_;
+    }
+    return ::operator new(size);
+  }
+
+  size_t cls = classOf(size);
+  size_t blockSize = (cls + 1) * kAlignment;
+  LockGuard<SpinThenParkMutex> lock(mutex_);
+  ++allocations_;
+  bytesInUse_ += blockSize;
+  if (FreeBlock* block = freeLists_[cls])
+  {
+    freeLists_[cls] = block->next;
+    return block;
+  }
+  if (remaining_ < blockSize)
+  {
+    // the tail of the last slab goes to free lists of smaller classes
+    while (remaining_ >= kAlignment)
+    {
+      size_t tail = classOf(remaining_ < kMaxSize ? remaining_ : kMaxSize);
+      if ((tail + 1) * kAlignment > remaining_)
+      {
+        --tail;
+      }
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(current_);
+      block->next = freeLists_[tail];
+      freeLists_[tail] = block;
+      current_ += (tail + 1) * kAlignment;
+      remaining_ -= (tail + 1) * kAlignment;
+    }
+    // malloc() returns memory aligned for any type, at least 16 bytes on 64-bit
+    void* slab = reserved_ ? reserved_ : ::malloc(kSlabSize);
+    if (slab == NULL)
+    {
+      throw std::bad_alloc();
+    }
+    reserved_ = NULL;
+    slabs_.push_back(slab);
+    current_ = static_cast<char*>(slab);
+    remaining_ = kSlabSize;
+  }
+  void* block = current_;
+  current_ += blockSize;
+  remaining_ -= blockSize;
+  return block;
+}
+
+void SlabAllocator::deallocate(void* p, size_t size)
+{
+  if (p == NULL)
+  {
+    return;
+  }
+  if (size > kMaxSize)
+  {
+    ::operator delete(p);
+    return;
+  }
+  size_t cls = classOf(size);
+  FreeBlock* block = static_cast<FreeBlock*>(p);
+  LockGuard<SpinThenParkMutex> lock(mutex_);
+  bytesInUse_ -= (cls + 1) * kAlignment;
+  block->next = freeLists_[cls];
+  freeLists_[cls] = block;
+}
+
+void SlabAllocator::reserve()
+{
+  {
+  LockGuard<SpinThenParkMutex> lock(mutex_);
+  if (reserved_ != NULL)
+  {
+    return;
+  }
+  }
+  // touched without the lock
+  void* slab = ::malloc(kSlabSize);
+  if (slab == NULL)
+  {
+    return;
+  }
+  ::memset(slab, 0, kSlabSize);
+  {
+  LockGuard<SpinThenParkMutex> lock(mutex_);
+  if (reserved_ == NULL)
+  {
+    reserved_ = slab;
+    slab = NULL;
+  }
+  }
+  // another thread reserved meanwhile
+  ::free(slab);
+}
+
+SlabAllocator::Stats SlabAllocator::stats() const
+{
+  Stats result;
+  LockGuard<SpinThenParkMutex> lock(mutex_);
+  result.slabBytes = (slabs_.size() + (reserved_ ? 1 : 0)) * kSlabSize;
+  result.bytesInUse = bytesInUse_;
+  result.allocations = allocations_;
+  result.fallbacks = fallbacks_;
+  return result;
+}
@@ -0,0 +1,202 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_SLABALLOCATOR_H
+#define MUDUO_BASE_SLABALLOCATOR_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Types.h"
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace muduo
+{
+
+///
+/// Pool of small blocks carved from 64KiB slabs, with a free list per size
+/// class of 16 bytes. Freed blocks are reused for the same size class,
+/// slabs are released by the destructor only.
+///
+/// For objects of the same lifetime and few sizes, eg. connections of an
+/// EventLoop, they are packed together instead of scattered in the heap.
+/// Blocks over kMaxSize come from malloc(). Thread safe.
+///
+class SlabAllocator : noncopyable
+{
+ public:
+  static const size_t kAlignment = 16;
+  static const size_t kMaxSize = 1024;
+  static const size_t kSlabSize = 64 * 1024;
+
+  struct Stats
+  {
+    size_t slabBytes;    // from malloc() for slabs, including the reserved one
+    size_t bytesInUse;   // in blocks allocated, rounded up to size class
+    int64_t allocations;
+    int64_t fallbacks;   // larger than kMaxSize
+  };
+
+  SlabAllocator();
+  ~SlabAllocator();
+
+  void* allocate(size_t size);
+  void deallocate(void* p, size_t size);
+
+  /// Allocates and touches the next slab now, unless one is reserved, so its
+  /// pages are on the NUMA node of the calling thread, not of whichever
+  /// thread runs out of the current slab, eg. by an EventLoop in its thread.
+  void reserve();
+
+  Stats stats() const;
+
+ private:
+  struct FreeBlock
+  {
+    FreeBlock* next;
+  };
+
+  static const size_t kClasses = kMaxSize / kAlignment;
+
+  static size_t classOf(size_t size)
+  {
+    return size == 0 ? 0 : (size - 1) / kAlignment;
+  }
+
+  mutable SpinThenParkMutex mutex_;
+  FreeBlock* freeLists_[kClasses] GUARDED_BY(mutex_);
+  char* current_ GUARDED_BY(mutex_);  // unused part of the last slab
+  size_t remaining_ GUARDED_BY(mutex_);
+  std::vector<void*> slabs_ GUARDED_BY(mutex_);
+  void* reserved_ GUARDED_BY(mutex_);  // by reserve(), used for the next slab
+  size_t bytesInUse_ GUARDED_BY(mutex_);
+  int64_t allocations_ GUARDED_BY(mutex_);
+  int64_t fallbacks_ GUARDED_BY(mutex_);
+};
+
+///
+/// STL allocator from a SlabAllocator, eg. for std::allocate_shared().
+/// Arrays come from operator new. T must not be aligned beyond kAlignment.
+///
+/// It shares the ownership of pool, the control block of std::allocate_shared()
+/// keeps a copy, so the pool lives until the last weak_ptr is gone.
+///
+template<typename T>
+class PoolAllocator
+{
+ public:
+  typedef T value_type;
+
+  explicit PoolAllocator(const std::shared_ptr<SlabAllocator>& pool)
+    : pool_(pool)
+  {
+  }
+
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>& rhs)
+    : pool_(rhs.pool())
+  {
+  }
+
+  T* allocate(size_t n)
+  {
+    static_assert(alignof(T) <= SlabAllocator::kAlignment, "T is over-aligned for SlabAllocator");
+    if (n == 1 && pool_)
+    {
+      return static_cast<T*>(pool_->allocate(sizeof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n)
+  {
+    if (n == 1 && pool_)
+    {
+      pool_->deallocate(p, sizeof(T));
+    }
+    else
+    {
+      ::operator delete(p);
+    }
+  }
+
+  const std::shared_ptr<SlabAllocator>& pool() const { return pool_; }
+
+  template<typename U>
+  bool operator==(const PoolAllocator<U>& rhs) const { return pool_ == rhs.pool(); }
+  template<typename U>
+  bool operator!=(const PoolAllocator<U>& rhs) const { return pool_ != rhs.pool(); }
+
+ private:
+  std::shared_ptr<SlabAllocator> pool_;
+};
+
+///
+/// Deleter of std::unique_ptr for an object from makePooled(),
+/// the pool must outlive the object.
+///
+template<typename T>
+class PoolDeleter
+{
+ public:
+  PoolDeleter()
+    : pool_(NULL)
+  {
+  }
+
+  explicit PoolDeleter(SlabAllocator* pool)
+    : pool_(pool)
+  {
+  }
+
+  void operator()(T* p) const
+  {
+    typedef char T_must_be_complete_type[sizeof(T) == 0 ? -1 : 1];
+    T_must_be_complete_type dummy; (void) dummy;
+    if (pool_)
+    {
+      p->~T();
+      pool_->deallocate(p, sizeof(T));
+    }
+    else
+    {
+      delete p;
+    }
+  }
+
+ private:
+  SlabAllocator* pool_;
+};
+
+template<typename T>
+using PooledPtr = std::unique_ptr<T, PoolDeleter<T>>;
+
+/// new T(args...) in pool, or from operator new if pool is NULL.
+/// T must not be aligned beyond kAlignment.
+template<typename T, typename... Args>
+PooledPtr<T> makePooled(SlabAllocator* pool, Args&&... args)
+{
+  static_assert(alignof(T) <= SlabAllocator::kAlignment, "T is over-aligned for SlabAllocator");
+  if (pool == NULL)
+  {
+    return PooledPtr<T>(new T(std::forward<Args>(args)...));
+  }
+  void* p = pool->allocate(sizeof(T));
+  try
+  {
+    return PooledPtr<T>(new (p) T(std::forward<Args>(args)...), PoolDeleter<T>(pool));
+  }
+  catch (...)
+  {
+    pool->deallocate(p, sizeof(T));
+    throw;
+  }
+}
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_SLABALLOCATOR_H
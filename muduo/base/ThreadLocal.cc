@@ -0,0 +1,181 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/base/ThreadLocal.h"
+
+#include "muduo/base/Mutex.h"
+
+#include <vector>
+
+#include <stdlib.h>
+
+namespace muduo
+{
+namespace detail
+{
+
+__thread ThreadLocalSlot* t_slots = NULL;
+__thread size_t t_numSlots = 0;
+
+}  // namespace detail
+}  // namespace muduo
+
+using namespace muduo;
+using namespace muduo::detail;
+
+namespace
+{
+
+struct ExitHandler
+{
+  void (*fn)(void*);
+  void* arg;
+  ExitHandler* next;
+};
+
+__thread ExitHandler* t_exitHandlers = NULL;
+
+// Its destructor runs the handlers of a thread, it is registered with
+// __cxa_thread_atexit() by the first atThreadExit() of the thread.
+class ThreadExit
+{
+ public:
+  ~ThreadExit()
+  {
+    // a handler may register another one
+    while (ExitHandler* handler = t_exitHandlers)
+    {
+      t_exitHandlers = handler->next;
+      handler->fn(handler->arg);
+      delete handler;
+    }
+  }
+
+  void touch() {}
+};
+
+thread_local ThreadExit t_threadExit;
+
+void deleteSlots(void*)
+{
+  // deleting a value may create another one
+  bool deleted = true;
+  while (deleted)
+  {
+    deleted = false;
+    for (size_t i = 0; i < t_numSlots; ++i)
+    {
+      ThreadLocalSlot& slot = t_slots[i];
+      if (slot.generation != 0)
+      {
+        void* value = slot.value;
+        slot.generation = 0;
+        slot.value = NULL;
+        slot.deleter(value);
+        deleted = true;
+      }
+    }
+  }
+  ::free(t_slots);
+  t_slots = NULL;
+  t_numSlots = 0;
+}
+
+struct Indexes
+{
+  MutexLock mutex;
+  size_t numIndexes GUARDED_BY(mutex) = 0;
+  uint64_t nextGeneration GUARDED_BY(mutex) = 1;
+  std::vector<size_t> freeIndexes GUARDED_BY(mutex);
+};
+
+// ThreadLocals are often globals of other translation units,
+// constructed and destroyed in any order.
+Indexes& indexes()
+{
+  static Indexes* indexes = new Indexes;
+  return *indexes;
+}
+
+}  // namespace
+
+void detail::allocateThreadLocalIndex(size_t* index, uint64_t* generation)
+{
+  Indexes& all = indexes();
+  MutexLockGuard lock(all.mutex);
+  if (all.freeIndexes.empty())
+  {
+    *index = all.numIndexes++;
+  }
+  else
+  {
+    *index = all.freeIndexes.back();
+    all.freeIndexes.pop_back();
+  }
+  *generation = all.nextGeneration++;
+}
+
+void detail::releaseThreadLocalIndex(size_t index)
+{
+  Indexes& all = indexes();
+  MutexLockGuard lock(all.mutex);
+  all.freeIndexes.push_back(index);
+}
+
+void* detail::newThreadLocalValue(size_t index, uint64_t generation,
+                                  void* (*creator)(), void (*deleter)(void*))
+{
+  if (index >= t_numSlots)
+  {
+    if (t_slots == NULL)
+    {
+      atThreadExit(&deleteSlots, NULL);
+    }
+    size_t numSlots = t_numSlots == 0 ? 8 : t_numSlots;
+    while (numSlots <= index)
+    {
+      numSlots *= 2;
+    }
+    void* slots = ::realloc(t_slots, numSlots * sizeof(ThreadLocalSlot));
+    if (slots == NULL)
+    {
+      abort();
+    }
+    t_slots = static_cast<ThreadLocalSlot*>(slots);
+    for (size_t i = t_numSlots; i < numSlots; ++i)
+    {
+      t_slots[i].value = NULL;
+      t_slots[i].generation = 0;
+      t_slots[i].deleter = NULL;
+    }
+    t_numSlots = numSlots;
+  }
+
+  ThreadLocalSlot& slot = t_slots[index];
+  if (slot.generation != 0)
+  {
+    // left by a destroyed ThreadLocal
+    void* value = slot.value;
+    slot.generation = 0;
+    slot.deleter(value);
+  }
+  void* value = creator();
+  // the constructor could have touched other ThreadLocals and moved t_slots
+  ThreadLocalSlot& newSlot = t_slots[index];
+  newSlot.value = value;
+  newSlot.generation = generation;
+  newSlot.deleter = deleter;
+  return value;
+}
+
+void detail::atThreadExit(void (*fn)(void*), void* arg)
+{
+  t_threadExit.touch();
+  ExitHandler* handler = new ExitHandler;
+  handler->fn = fn;
+  handler->arg = arg;
+  handler->next = t_exitHandlers;
+  t_exitHandlers = handler;
+}
@@ -6,41 +6,80 @@
 #ifndef MUDUO_BASE_THREADLOCAL_H
 #define MUDUO_BASE_THREADLOCAL_H
 
-#include "muduo/base/Mutex.h"
 #include "muduo/base/noncopyable.h"
 
-#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 
 namespace muduo
 {
+namespace detail
+{
+
+struct ThreadLocalSlot
+{
+  void* value;
+  uint64_t generation;  // of the ThreadLocal which owns value, 0 if none
+  void (*deleter)(void*);
+};
+
+// slots of the calling thread, indexed by ThreadLocal::index_
+extern __thread ThreadLocalSlot* t_slots;
+extern __thread size_t t_numSlots;
 
+void allocateThreadLocalIndex(size_t* index, uint64_t* generation);
+void releaseThreadLocalIndex(size_t index);
+void* newThreadLocalValue(size_t index, uint64_t generation,
+                          void* (*creator)(), void (*deleter)(void*));
+
+/// Calls fn(arg) when the calling thread exits, by pthread_exit() or returning
+/// from its thread function, in reverse order of registration.
+void atThreadExit(void (*fn)(void*), void* arg);
+
+}  // namespace detail
+
+///
+/// Per-thread value of T, created by the first value() in each thread,
+/// and deleted when the thread exits.
+///
+/// value() is an index into a __thread array, without pthread_getspecific().
+/// Values of a destroyed ThreadLocal are deleted when their threads exit,
+/// or when the slot is reused by a new ThreadLocal.
+///
 template<typename T>
 class ThreadLocal : noncopyable
 {
  public:
   ThreadLocal()
   {
-    MCHECK(pthread_key_create(&pkey_, &ThreadLocal::destructor));
+    detail::allocateThreadLocalIndex(&index_, &generation_);
   }
 
   ~ThreadLocal()
   {
-    MCHECK(pthread_key_delete(pkey_));
+    detail::releaseThreadLocalIndex(index_);
   }
 
   T& value()
   {
-    T* perThreadValue = static_cast<T*>(pthread_getspecific(pkey_));
-    if (!perThreadValue)
+    if (__builtin_expect(index_ < detail::t_numSlots, 1))
     {
-      T* newObj = new T();
-      MCHECK(pthread_setspecific(pkey_, newObj));
-      perThreadValue = newObj;
+      const detail::ThreadLocalSlot& slot = detail::t_slots[index_];
+      if (__builtin_expect(slot.generation == generation_, 1))
+      {
+        return *static_cast<T*>(slot.value);
+      }
     }
-    return *perThreadValue;
+    return *static_cast<T*>(detail::newThreadLocalValue(index_, generation_,
+                                                        &ThreadLocal::creator,
+                                                        &ThreadLocal::destructor));
   }
 
  private:
+  static void* creator()
+  {
+    return new T();
+  }
 
   static void destructor(void *x)
   {
@@ -51,7 +90,8 @@ class ThreadLocal : noncopyable
   }
 
  private:
-  pthread_key_t pkey_;
+  size_t index_;
+  uint64_t generation_;
 };
 
 }  // namespace muduo
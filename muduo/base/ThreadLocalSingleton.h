@@ -6,14 +6,18 @@
 #ifndef MUDUO_BASE_THREADLOCALSINGLETON_H
 #define MUDUO_BASE_THREADLOCALSINGLETON_H
 
+#include "muduo/base/ThreadLocal.h"
 #include "muduo/base/noncopyable.h"
 
 #include <assert.h>
-#include <pthread.h>
 
 namespace muduo
 {
 
+///
+/// Per-thread singleton of T, instance() reads a __thread pointer only.
+/// The object is deleted when the thread exits, see detail::atThreadExit().
+///
 template<typename T>
 class ThreadLocalSingleton : noncopyable
 {
@@ -26,7 +30,7 @@ class ThreadLocalSingleton : noncopyable
     if (!t_value_)
     {
       t_value_ = new T();
-      deleter_.set(t_value_);
+      detail::atThreadExit(&ThreadLocalSingleton::destructor, t_value_);
     }
     return *t_value_;
   }
@@ -46,37 +50,11 @@ class ThreadLocalSingleton : noncopyable
     t_value_ = 0;
   }
 
-  class Deleter
-  {
-   public:
-    Deleter()
-    {
-      pthread_key_create(&pkey_, &ThreadLocalSingleton::destructor);
-    }
-
-    ~Deleter()
-    {
-      pthread_key_delete(pkey_);
-    }
-
-    void set(T* newObj)
-    {
-      assert(pthread_getspecific(pkey_) == NULL);
-      pthread_setspecific(pkey_, newObj);
-    }
-
-    pthread_key_t pkey_;
-  };
-
   static __thread T* t_value_;
-  static Deleter deleter_;
 };
 
 template<typename T>
 __thread T* ThreadLocalSingleton<T>::t_value_ = 0;
 
-template<typename T>
-typename ThreadLocalSingleton<T>::Deleter ThreadLocalSingleton<T>::deleter_;
-
 }  // namespace muduo
 #endif  // MUDUO_BASE_THREADLOCALSINGLETON_H
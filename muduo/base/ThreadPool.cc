@@ -7,16 +7,210 @@
 
 #include "muduo/base/Exception.h"
 
+#include <algorithm>
+
 #include <assert.h>
+#include <sched.h>
 #include <stdio.h>
 
 using namespace muduo;
 
+namespace
+{
+
+const int kDequeCapacity = 1024;  // of each worker, power of 2
+const int kRingCapacity = 4096;  // if maxQueueSize is 0
+const int kMaxFreeNodes = 256;  // cached by each worker
+const int kSpinRounds = 32;  // before sleeping
+// takes from injection queue first every so many tasks,
+// so tasks spawning tasks don't starve others.
+const uint32_t kInjectionInterval = 61;
+
+__thread ThreadPool* t_pool = NULL;
+__thread int t_workerIndex = -1;
+
+}  // namespace
+
+struct ThreadPool::TaskNode
+{
+  Task task;
+  TaskNode* next;  // in free list
+};
+
+// Chase and Lev, Dynamic circular work-stealing deque, SPAA 2005,
+// with memory orders of Le et al., Correct and efficient work-stealing
+// for weak memory models, PPoPP 2013.
+// Fixed capacity, push() fails if full.
+class ThreadPool::WorkStealingDeque : noncopyable
+{
+ public:
+  WorkStealingDeque()
+    : top_(0),
+      bottom_(0)
+  {
+    for (std::atomic<TaskNode*>& slot : buffer_)
+    {
+      slot.store(NULL, std::memory_order_relaxed);
+    }
+  }
+
+  // by owner
+  bool push(TaskNode* node)
+  {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= kDequeCapacity)
+    {
+      return false;
+    }
+    buffer_[b & (kDequeCapacity - 1)].store(node, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // by owner, newest first
+  TaskNode* pop()
+  {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    TaskNode* node = NULL;
+    if (t <= b)
+    {
+      node = buffer_[b & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+      if (t == b)
+      {
+        // the last one, races with thieves
+        if (!top_.compare_exchange_strong(t, t + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+        {
+          node = NULL;
+        }
+        bottom_.store(b + 1, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return node;
+  }
+
+  // by other workers, oldest first, NULL if empty or lost the race.
+  TaskNode* steal()
+  {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t < b)
+    {
+      TaskNode* node = buffer_[t & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+      if (top_.compare_exchange_strong(t, t + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+      {
+        return node;
+      }
+    }
+    return NULL;
+  }
+
+  bool empty() const
+  {
+    return bottom_.load(std::memory_order_relaxed)
+        <= top_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> top_;
+  char pad_[64];
+  std::atomic<int64_t> bottom_;
+  std::atomic<TaskNode*> buffer_[kDequeCapacity];
+};
+
+struct ThreadPool::Worker : noncopyable
+{
+  explicit Worker(int i)
+    : freeNodes(NULL),
+      numFreeNodes(0),
+      ticks(0),
+      random(static_cast<uint32_t>(i) * 2654435761u + 1)
+  {
+  }
+
+  // after threads joined
+  ~Worker()
+  {
+    while (TaskNode* node = deque.pop())
+    {
+      delete node;
+    }
+    while (freeNodes)
+    {
+      TaskNode* node = freeNodes;
+      freeNodes = node->next;
+      delete node;
+    }
+  }
+
+  // Nodes are recycled by the worker running their tasks,
+  // so each free list is used by one thread only.
+  TaskNode* newNode()
+  {
+    TaskNode* node = freeNodes;
+    if (node)
+    {
+      freeNodes = node->next;
+      --numFreeNodes;
+    }
+    else
+    {
+      node = new TaskNode;
+    }
+    return node;
+  }
+
+  void deleteNode(TaskNode* node)
+  {
+    if (numFreeNodes < kMaxFreeNodes)
+    {
+      node->next = freeNodes;
+      freeNodes = node;
+      ++numFreeNodes;
+    }
+    else
+    {
+      delete node;
+    }
+  }
+
+  uint32_t nextRandom()
+  {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random;
+  }
+
+  WorkStealingDeque deque;
+  TaskNode* freeNodes;
+  int numFreeNodes;
+  uint32_t ticks;
+  uint32_t random;
+};
+
 ThreadPool::ThreadPool(const string& nameArg)
   : mutex_(),
     notEmpty_(mutex_),
     notFull_(mutex_),
     name_(nameArg),
+    overflowSize_(0),
+    queued_(0),
+    idle_(0),
+    fullWaiters_(0),
     maxQueueSize_(0),
     running_(false)
 {
@@ -34,13 +228,21 @@ void ThreadPool::start(int numThreads)
 {
   assert(threads_.empty());
   running_ = true;
+  ring_.reset(new LockFreeBoundedQueue<Task>(
+        maxQueueSize_ > 0 ? static_cast<int>(maxQueueSize_) : kRingCapacity));
+  // all workers exist before any steals
+  workers_.reserve(numThreads);
+  for (int i = 0; i < numThreads; ++i)
+  {
+    workers_.emplace_back(new Worker(i));
+  }
   threads_.reserve(numThreads);
   for (int i = 0; i < numThreads; ++i)
   {
     char id[32];
     snprintf(id, sizeof id, "%d", i+1);
     threads_.emplace_back(new muduo::Thread(
-          std::bind(&ThreadPool::runInThread, this), name_+id));
+          std::bind(&ThreadPool::runInThread, this, i), name_+id));
     threads_[i]->start();
   }
   if (numThreads == 0 && threadInitCallback_)
@@ -55,6 +257,7 @@ void ThreadPool::stop()
   MutexLockGuard lock(mutex_);
   running_ = false;
   notEmpty_.notifyAll();
+  notFull_.notifyAll();
   }
   for (auto& thr : threads_)
   {
@@ -64,8 +267,7 @@ void ThreadPool::stop()
 
 size_t ThreadPool::queueSize() const
 {
-  MutexLockGuard lock(mutex_);
-  return queue_.size();
+  return queued_.load(std::memory_order_relaxed);
 }
 
 void ThreadPool::run(Task task)
@@ -73,62 +275,249 @@ void ThreadPool::run(Task task)
   if (threads_.empty())
   {
     task();
+    return;
+  }
+  if (!running_)
+  {
+    // stopped, as the queue is never taken again
+    return;
+  }
+
+  if (t_pool == this)
+  {
+    // spawned by a task, never blocks
+    queued_.fetch_add(1);
+    Worker* w = workers_[t_workerIndex].get();
+    TaskNode* node = w->newNode();
+    node->task = std::move(task);
+    if (!w->deque.push(node))
+    {
+      task = std::move(node->task);
+      w->deleteNode(node);
+      inject(std::move(task));
+    }
   }
   else
   {
-    MutexLockGuard lock(mutex_);
-    while (isFull())
+    if (maxQueueSize_ > 0)
+    {
+      if (!reserve())
+      {
+        return;
+      }
+    }
+    else
     {
-      notFull_.wait();
+      queued_.fetch_add(1);
     }
-    assert(!isFull());
+    inject(std::move(task));
+  }
+  wakeOne();
+}
 
-    queue_.push_back(std::move(task));
-    notEmpty_.notify();
+bool ThreadPool::tryRun(Task task)
+{
+  if (threads_.empty() || t_pool == this || maxQueueSize_ == 0)
+  {
+    if (!running_ && !threads_.empty())
+    {
+      return false;
+    }
+    run(std::move(task));
+    return true;
   }
+
+  size_t n = queued_.load(std::memory_order_relaxed);
+  do
+  {
+    if (n >= maxQueueSize_ || !running_)
+    {
+      return false;
+    }
+  } while (!queued_.compare_exchange_weak(n, n + 1));
+  inject(std::move(task));
+  wakeOne();
+  return true;
 }
 
-ThreadPool::Task ThreadPool::take()
+bool ThreadPool::reserve()
 {
-  MutexLockGuard lock(mutex_);
-  // always use a while-loop, due to spurious wakeup
-  while (queue_.empty() && running_)
+  size_t n = queued_.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    if (n < maxQueueSize_)
+    {
+      if (queued_.compare_exchange_weak(n, n + 1))
+      {
+        return true;
+      }
+    }
+    else
+    {
+      MutexLockGuard lock(mutex_);
+      fullWaiters_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (queued_.load() >= maxQueueSize_ && running_)
+      {
+        notFull_.wait();
+      }
+      fullWaiters_.fetch_sub(1);
+      if (!running_)
+      {
+        return false;
+      }
+      n = queued_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void ThreadPool::inject(Task&& task)
+{
+  // keeps FIFO order, once some tasks are in overflow_
+  if (overflowSize_.load(std::memory_order_acquire) == 0 && ring_->tryPut(std::move(task)))
   {
-    notEmpty_.wait();
+    return;
   }
-  Task task;
-  if (!queue_.empty())
+  MutexLockGuard lock(overflowMutex_);
+  overflow_.push_back(std::move(task));
+  overflowSize_.fetch_add(1, std::memory_order_release);
+}
+
+void ThreadPool::wakeOne()
+{
+  // pairs with the fence in runInThread(), either this sees the idle worker,
+  // or the worker sees the task.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (idle_.load(std::memory_order_relaxed) > 0)
   {
-    task = queue_.front();
-    queue_.pop_front();
-    if (maxQueueSize_ > 0)
+    MutexLockGuard lock(mutex_);
+    notEmpty_.notify();
+  }
+}
+
+void ThreadPool::finishOne()
+{
+  queued_.fetch_sub(1);
+  if (maxQueueSize_ > 0)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (fullWaiters_.load(std::memory_order_relaxed) > 0)
     {
+      MutexLockGuard lock(mutex_);
       notFull_.notify();
     }
   }
-  return task;
 }
 
-bool ThreadPool::isFull() const
+bool ThreadPool::take(Worker* w, Task* task)
+{
+  if (++w->ticks % kInjectionInterval == 0 && takeInjected(task))
+  {
+    return true;
+  }
+  if (TaskNode* node = w->deque.pop())
+  {
+    *task = std::move(node->task);
+    w->deleteNode(node);
+    return true;
+  }
+  return takeInjected(task) || steal(w, task);
+}
+
+bool ThreadPool::takeInjected(Task* task)
+{
+  if (ring_->tryTake(task))
+  {
+    return true;
+  }
+  if (overflowSize_.load(std::memory_order_acquire) > 0)
+  {
+    MutexLockGuard lock(overflowMutex_);
+    if (!overflow_.empty())
+    {
+      *task = std::move(overflow_.front());
+      overflow_.pop_front();
+      overflowSize_.fetch_sub(1, std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::steal(Worker* w, Task* task)
+{
+  const size_t n = workers_.size();
+  const size_t start = w->nextRandom() % n;
+  for (size_t i = 0; i < n; ++i)
+  {
+    Worker* victim = workers_[(start + i) % n].get();
+    if (victim != w)
+    {
+      if (TaskNode* node = victim->deque.steal())
+      {
+        *task = std::move(node->task);
+        w->deleteNode(node);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::hasTask() const
 {
-  mutex_.assertLocked();
-  return maxQueueSize_ > 0 && queue_.size() >= maxQueueSize_;
+  if (!ring_->empty() || overflowSize_.load(std::memory_order_relaxed) > 0)
+  {
+    return true;
+  }
+  for (const std::unique_ptr<Worker>& w : workers_)
+  {
+    if (!w->deque.empty())
+    {
+      return true;
+    }
+  }
+  return false;
 }
 
-void ThreadPool::runInThread()
+void ThreadPool::runInThread(int index)
 {
   try
   {
+    t_pool = this;
+    t_workerIndex = index;
+    Worker* w = workers_[index].get();
     if (threadInitCallback_)
     {
       threadInitCallback_();
     }
+    Task task;
+    int spins = 0;
     while (running_)
     {
-      Task task(take());
-      if (task)
+      if (take(w, &task))
       {
+        spins = 0;
+        finishOne();
         task();
+        task = nullptr;
+      }
+      else if (spins < kSpinRounds)
+      {
+        ++spins;
+        sched_yield();
+      }
+      else
+      {
+        spins = 0;
+        MutexLockGuard lock(mutex_);
+        idle_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (running_ && !hasTask())
+        {
+          notEmpty_.wait();
+        }
+        idle_.fetch_sub(1);
       }
     }
   }
@@ -7,27 +7,40 @@
 #define MUDUO_BASE_THREADPOOL_H
 
 #include "muduo/base/Condition.h"
+#include "muduo/base/LockFreeBoundedQueue.h"
 #include "muduo/base/Mutex.h"
 #include "muduo/base/Thread.h"
 #include "muduo/base/Types.h"
+#include "muduo/base/UniqueFunction.h"
 
+#include <atomic>
 #include <deque>
 #include <vector>
 
 namespace muduo
 {
 
+///
+/// Work-stealing thread pool.
+///
+/// Tasks from other threads go to a lock-free injection queue, tasks from
+/// running tasks go to the deque of that worker, which takes the newest
+/// first, while idle workers steal the oldest ones from others.
+/// Idle workers spin a while before sleeping on a condition variable.
+///
 class ThreadPool : noncopyable
 {
  public:
-  typedef std::function<void ()> Task;
+  /// Move-only, captures of a few pointers are stored without allocation.
+  typedef UniqueFunction<void ()> Task;
+  typedef std::function<void ()> ThreadInitCallback;
 
   explicit ThreadPool(const string& nameArg = string("ThreadPool"));
   ~ThreadPool();
 
   // Must be called before start().
   void setMaxQueueSize(int maxSize) { maxQueueSize_ = maxSize; }
-  void setThreadInitCallback(const Task& cb)
+  void setThreadInitCallback(const ThreadInitCallback& cb)
   { threadInitCallback_ = cb; }
 
   void start(int numThreads);
@@ -36,29 +49,50 @@ class ThreadPool : noncopyable
   const string& name() const
   { return name_; }
 
+  /// Tasks not started yet.
   size_t queueSize() const;
 
-  // Could block if maxQueueSize > 0
-  // There is no move-only version of std::function in C++ as of C++14.
-  // So we don't need to overload a const& and an && versions
-  // as we do in (Bounded)BlockingQueue.
-  // https://stackoverflow.com/a/25408989
+  // Could block if maxQueueSize > 0, unless called by a task of this pool.
+  // Drops f after stop().
   void run(Task f);
+  /// Same as run(), but never blocks, returns false and drops f
+  /// if the queue is full or the pool is stopped.
+  bool tryRun(Task f);
 
  private:
-  bool isFull() const REQUIRES(mutex_);
-  void runInThread();
-  Task take();
+  class WorkStealingDeque;
+  struct TaskNode;
+  struct Worker;
+
+  void runInThread(int index);
+  bool take(Worker* w, Task* task);
+  bool takeInjected(Task* task);
+  bool steal(Worker* w, Task* task);
+  bool hasTask() const;
+  void inject(Task&& task);
+  // waits for room in queue, false if stopped meanwhile
+  bool reserve();
+  void wakeOne();
+  void finishOne();
 
   mutable MutexLock mutex_;
   Condition notEmpty_ GUARDED_BY(mutex_);
   Condition notFull_ GUARDED_BY(mutex_);
   string name_;
-  Task threadInitCallback_;
+  ThreadInitCallback threadInitCallback_;
   std::vector<std::unique_ptr<muduo::Thread>> threads_;
-  std::deque<Task> queue_ GUARDED_BY(mutex_);
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // of tasks from other threads, never blocks
+  std::unique_ptr<LockFreeBoundedQueue<Task>> ring_;
+  // when ring_ is full and maxQueueSize_ is 0
+  MutexLock overflowMutex_;
+  std::deque<Task> overflow_ GUARDED_BY(overflowMutex_);
+  std::atomic<size_t> overflowSize_;
+  std::atomic<size_t> queued_;
+  std::atomic<int> idle_;  // workers waiting for notEmpty_
+  std::atomic<int> fullWaiters_;  // producers waiting for notFull_
   size_t maxQueueSize_;
-  bool running_;
+  std::atomic<bool> running_;
 };
 
 }  // namespace muduo
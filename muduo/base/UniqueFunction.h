@@ -0,0 +1,242 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_UNIQUEFUNCTION_H
+#define MUDUO_BASE_UNIQUEFUNCTION_H
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace muduo
+{
+
+template<typename Signature>
+class UniqueFunction;
+
+///
+/// Move-only std::function, with a larger inline buffer.
+///
+/// Callables of no more than kInlineSize bytes, which covers a lambda of
+/// a few pointers or a shared_ptr, or std::bind of a member function with
+/// this and a string, are stored in place without heap allocation.
+/// Callables with move-only captures are accepted too.
+///
+template<typename R, typename... Args>
+class UniqueFunction<R (Args...)>
+{
+ public:
+  // sizeof(UniqueFunction) is 64 bytes on 64-bit, a cache line
+  static const size_t kInlineSize = 7 * sizeof(void*);
+
+  UniqueFunction() noexcept
+    : ops_(NULL)
+  {
+  }
+
+  UniqueFunction(std::nullptr_t) noexcept  // NOLINT, implicit as std::function
+    : ops_(NULL)
+  {
+  }
+
+  template<typename F,
+           typename = typename std::enable_if<
+             !std::is_same<typename std::decay<F>::type, UniqueFunction>::value>::type>
+  UniqueFunction(F&& f)  // NOLINT, implicit as std::function
+    : ops_(NULL)
+  {
+    typedef typename std::decay<F>::type Functor;
+    if (!isEmpty(f))
+    {
+      construct<Functor>(std::forward<F>(f), Inline<Functor>());
+    }
+  }
+
+  UniqueFunction(UniqueFunction&& rhs) noexcept
+    : ops_(rhs.ops_)
+  {
+    if (ops_)
+    {
+      ops_->move(&storage_, &rhs.storage_);
+      rhs.ops_ = NULL;
+    }
+  }
+
+  UniqueFunction& operator=(UniqueFunction&& rhs) noexcept
+  {
+    if (this != &rhs)
+    {
+      reset();
+      if (rhs.ops_)
+      {
+        rhs.ops_->move(&storage_, &rhs.storage_);
+        ops_ = rhs.ops_;
+        rhs.ops_ = NULL;
+      }
+    }
+    return *this;
+  }
+
+  UniqueFunction& operator=(std::nullptr_t) noexcept
+  {
+    reset();
+    return *this;
+  }
+
+  UniqueFunction(const UniqueFunction&) = delete;
+  UniqueFunction& operator=(const UniqueFunction&) = delete;
+
+  ~UniqueFunction()
+  {
+    reset();
+  }
+
+  void swap(UniqueFunction& rhs) noexcept
+  {
+    UniqueFunction tmp(std::move(rhs));
+    rhs = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+  explicit operator bool() const noexcept
+  {
+    return ops_ != NULL;
+  }
+
+  /// True if the callable is stored in place, for tests.
+  bool isInline() const noexcept
+  {
+    return ops_ != NULL && ops_->isInline;
+  }
+
+  R operator()(Args... args) const
+  {
+    assert(ops_ != NULL);
+    return ops_->invoke(&storage_, std::forward<Args>(args)...);
+  }
+
+ private:
+  typedef typename std::aligned_storage<kInlineSize, alignof(void*)>::type Storage;
+
+  struct Ops
+  {
+    R (*invoke)(Storage* storage, Args&&... args);
+    // move constructs dst from src, then destroys src
+    void (*move)(Storage* dst, Storage* src);
+    void (*destroy)(Storage* storage);
+    bool isInline;
+  };
+
+  template<typename Functor>
+  struct Inline
+    : std::integral_constant<bool,
+                             sizeof(Functor) <= kInlineSize
+                             && alignof(Functor) <= alignof(Storage)
+                             && std::is_nothrow_move_constructible<Functor>::value>
+  {
+  };
+
+  template<typename Functor>
+  struct InlineOps
+  {
+    static Functor* get(Storage* storage)
+    { return reinterpret_cast<Functor*>(storage); }
+
+    static R invoke(Storage* storage, Args&&... args)
+    { return (*get(storage))(std::forward<Args>(args)...); }
+
+    static void move(Storage* dst, Storage* src)
+    {
+      new (dst) Functor(std::move(*get(src)));
+      get(src)->~Functor();
+    }
+
+    static void destroy(Storage* storage)
+    { get(storage)->~Functor(); }
+
+    static const Ops ops;
+  };
+
+  template<typename Functor>
+  struct HeapOps
+  {
+    static Functor*& get(Storage* storage)
+    { return *reinterpret_cast<Functor**>(storage); }
+
+    static R invoke(Storage* storage, Args&&... args)
+    { return (*get(storage))(std::forward<Args>(args)...); }
+
+    static void move(Storage* dst, Storage* src)
+    { *reinterpret_cast<Functor**>(dst) = get(src); }
+
+    static void destroy(Storage* storage)
+    { delete get(storage); }
+
+    static const Ops ops;
+  };
+
+  template<typename F>
+  static bool isEmpty(const F&) { return false; }
+  template<typename Sig>
+  static bool isEmpty(const std::function<Sig>& f) { return !f; }
+  template<typename T>
+  static bool isEmpty(T* const& p) { return p == NULL; }
+
+  template<typename Functor, typename F>
+  void construct(F&& f, std::true_type /* inline */)
+  {
+    new (&storage_) Functor(std::forward<F>(f));
+    ops_ = &InlineOps<Functor>::ops;
+  }
+
+  template<typename Functor, typename F>
+  void construct(F&& f, std::false_type /* inline */)
+  {
+    *reinterpret_cast<Functor**>(&storage_) = new Functor(std::forward<F>(f));
+    ops_ = &HeapOps<Functor>::ops;
+  }
+
+  void reset() noexcept
+  {
+    if (ops_)
+    {
+      ops_->destroy(&storage_);
+      ops_ = NULL;
+    }
+  }
+
+  mutable Storage storage_;
+  const Ops* ops_;
+};
+
+template<typename R, typename... Args>
+template<typename Functor>
+const typename UniqueFunction<R (Args...)>::Ops
+UniqueFunction<R (Args...)>::InlineOps<Functor>::ops =
+{
+  &InlineOps<Functor>::invoke,
+  &InlineOps<Functor>::move,
+  &InlineOps<Functor>::destroy,
+  true
+};
+
+template<typename R, typename... Args>
+template<typename Functor>
+const typename UniqueFunction<R (Args...)>::Ops
+UniqueFunction<R (Args...)>::HeapOps<Functor>::ops =
+{
+  &HeapOps<Functor>::invoke,
+  &HeapOps<Functor>::move,
+  &HeapOps<Functor>::destroy,
+  false
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_UNIQUEFUNCTION_H
@@ -1,5 +1,8 @@
 #include "muduo/base/BlockingQueue.h"
+#include "muduo/base/BoundedBlockingQueue.h"
 #include "muduo/base/CountDownLatch.h"
+#include "muduo/base/LockFreeBoundedQueue.h"
+#include "muduo/base/Mutex.h"
 #include "muduo/base/Thread.h"
 #include "muduo/base/Timestamp.h"
 
@@ -9,11 +12,35 @@
 #include <stdio.h>
 #include <unistd.h>
 
+const int kQueueSize = 1024;
+
+// BlockingQueue is unbounded
+template<typename Queue>
+Queue* newQueue()
+{
+  return new Queue(kQueueSize);
+}
+
+template<>
+muduo::BlockingQueue<muduo::Timestamp>* newQueue<muduo::BlockingQueue<muduo::Timestamp>>()
+{
+  return new muduo::BlockingQueue<muduo::Timestamp>;
+}
+
+template<>
+muduo::BlockingQueue<int>* newQueue<muduo::BlockingQueue<int>>()
+{
+  return new muduo::BlockingQueue<int>;
+}
+
+// latency of waking up an idle consumer
+template<typename Queue>
 class Bench
 {
  public:
   Bench(int numThreads)
-    : latch_(numThreads)
+    : queue_(newQueue<Queue>()),
+      latch_(numThreads)
   {
     threads_.reserve(numThreads);
     for (int i = 0; i < numThreads; ++i)
@@ -31,13 +58,11 @@ class Bench
 
   void run(int times)
   {
-    printf("waiting for count down latch\n");
     latch_.wait();
-    printf("all threads started\n");
     for (int i = 0; i < times; ++i)
     {
       muduo::Timestamp now(muduo::Timestamp::now());
-      queue_.put(now);
+      queue_->put(now);
       usleep(1000);
     }
   }
@@ -46,7 +71,7 @@ class Bench
   {
     for (size_t i = 0; i < threads_.size(); ++i)
     {
-      queue_.put(muduo::Timestamp::invalid());
+      queue_->put(muduo::Timestamp::invalid());
     }
 
     for (auto& thr : threads_)
@@ -55,52 +80,141 @@ class Bench
     }
   }
 
+  void print(const char* name)
+  {
+    int total = 0;
+    for (const auto& delay : delays_)
+    {
+      total += delay.second;
+    }
+    const double percentiles[] = { 50, 90, 99, 99.9, 100 };
+    size_t p = 0;
+    int count = 0;
+    printf("%-22s latency us", name);
+    for (const auto& delay : delays_)
+    {
+      count += delay.second;
+      while (p < sizeof percentiles / sizeof percentiles[0]
+             && count >= total * percentiles[p] / 100)
+      {
+        printf("  p%g=%d", percentiles[p], delay.first);
+        ++p;
+      }
+    }
+    printf("\n");
+  }
+
  private:
 
   void threadFunc()
   {
-    printf("tid=%d, %s started\n",
-           muduo::CurrentThread::tid(),
-           muduo::CurrentThread::name());
-
     std::map<int, int> delays;
     latch_.countDown();
     bool running = true;
     while (running)
     {
-      muduo::Timestamp t(queue_.take());
+      muduo::Timestamp t(queue_->take());
       muduo::Timestamp now(muduo::Timestamp::now());
       if (t.valid())
       {
         int delay = static_cast<int>(timeDifference(now, t) * 1000000);
-        // printf("tid=%d, latency = %d us\n",
-        //        muduo::CurrentThread::tid(), delay);
         ++delays[delay];
       }
       running = t.valid();
     }
 
-    printf("tid=%d, %s stopped\n",
-           muduo::CurrentThread::tid(),
-           muduo::CurrentThread::name());
+    muduo::MutexLockGuard lock(mutex_);
     for (const auto& delay : delays)
     {
-      printf("tid = %d, delay = %d, count = %d\n",
-             muduo::CurrentThread::tid(),
-             delay.first, delay.second);
+      delays_[delay.first] += delay.second;
     }
   }
 
-  muduo::BlockingQueue<muduo::Timestamp> queue_;
+  std::unique_ptr<Queue> queue_;
   muduo::CountDownLatch latch_;
   std::vector<std::unique_ptr<muduo::Thread>> threads_;
+  muduo::MutexLock mutex_;
+  std::map<int, int> delays_ GUARDED_BY(mutex_);
+};
+
+// throughput of busy producers and consumers, -1 stops a consumer
+template<typename Queue>
+double throughput(int numThreads, int items)
+{
+  std::unique_ptr<Queue> queue(newQueue<Queue>());
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  const int perProducer = items / numThreads;
+  muduo::CountDownLatch latch(1);
+  for (int i = 0; i < numThreads; ++i)
+  {
+    threads.emplace_back(new muduo::Thread([&queue, &latch, perProducer] {
+      latch.wait();
+      for (int j = 0; j < perProducer; ++j)
+      {
+        queue->put(j);
+      }
+    }));
+    threads.emplace_back(new muduo::Thread([&queue] {
+      while (queue->take() >= 0)
+      {
+      }
+    }));
+  }
+  for (auto& thr : threads)
+  {
+    thr->start();
+  }
+  muduo::Timestamp start(muduo::Timestamp::now());
+  latch.countDown();
+  for (size_t i = 0; i < threads.size(); i += 2)
+  {
+    threads[i]->join();
+  }
+  for (int i = 0; i < numThreads; ++i)
+  {
+    queue->put(-1);
+  }
+  for (size_t i = 1; i < threads.size(); i += 2)
+  {
+    threads[i]->join();
+  }
+  double seconds = timeDifference(muduo::Timestamp::now(), start);
+  return perProducer * numThreads / seconds;
+}
+
+template<typename T>
+struct Queues
+{
+  typedef muduo::BlockingQueue<T> Blocking;
+  typedef muduo::BoundedBlockingQueue<T> Bounded;
+  typedef muduo::LockFreeBoundedQueue<T> LockFree;
 };
 
+template<typename Queue>
+void latency(const char* name, int threads, int times)
+{
+  Bench<Queue> t(threads);
+  t.run(times);
+  t.joinAll();
+  t.print(name);
+}
+
 int main(int argc, char* argv[])
 {
   int threads = argc > 1 ? atoi(argv[1]) : 1;
+  int times = argc > 2 ? atoi(argv[2]) : 2000;
+  int items = argc > 3 ? atoi(argv[3]) : 1000 * 1000;
 
-  Bench t(threads);
-  t.run(10000);
-  t.joinAll();
+  printf("%d consumer threads, %d items, queue size %d\n", threads, times, kQueueSize);
+  latency<Queues<muduo::Timestamp>::Blocking>("BlockingQueue", threads, times);
+  latency<Queues<muduo::Timestamp>::Bounded>("BoundedBlockingQueue", threads, times);
+  latency<Queues<muduo::Timestamp>::LockFree>("LockFreeBoundedQueue", threads, times);
+
+  printf("%d producer and %d consumer threads, %d items\n", threads, threads, items);
+  printf("%-22s %.0f items/s\n", "BlockingQueue",
+         throughput<Queues<int>::Blocking>(threads, items));
+  printf("%-22s %.0f items/s\n", "BoundedBlockingQueue",
+         throughput<Queues<int>::Bounded>(threads, items));
+  printf("%-22s %.0f items/s\n", "LockFreeBoundedQueue",
+         throughput<Queues<int>::LockFree>(threads, items));
 }
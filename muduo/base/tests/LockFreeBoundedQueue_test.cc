@@ -0,0 +1,113 @@
+#include "muduo/base/LockFreeBoundedQueue.h"
+#include "muduo/base/Thread.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+// every item is taken exactly once, with a small queue to block both sides.
+void testThreads(int numProducers, int numConsumers)
+{
+  const int kItems = 100 * 1000;
+  muduo::LockFreeBoundedQueue<int> queue(8);
+  std::atomic<int64_t> sum(0);
+  std::atomic<int> count(0);
+  std::vector<std::unique_ptr<muduo::Thread>> producers, consumers;
+  for (int i = 0; i < numProducers; ++i)
+  {
+    producers.emplace_back(new muduo::Thread([&queue] {
+      for (int j = 1; j <= kItems; ++j)
+      {
+        queue.put(j);
+      }
+    }));
+  }
+  for (int i = 0; i < numConsumers; ++i)
+  {
+    consumers.emplace_back(new muduo::Thread([&queue, &sum, &count] {
+      int x = 0;
+      while ((x = queue.take()) > 0)
+      {
+        sum += x;
+        ++count;
+      }
+    }));
+  }
+  for (auto& thr : producers)
+    thr->start();
+  for (auto& thr : consumers)
+    thr->start();
+  for (auto& thr : producers)
+    thr->join();
+  for (int i = 0; i < numConsumers; ++i)
+    queue.put(0);
+  for (auto& thr : consumers)
+    thr->join();
+
+  BOOST_CHECK_EQUAL(count.load(), kItems * numProducers);
+  BOOST_CHECK_EQUAL(sum.load(), int64_t(kItems) * (kItems + 1) / 2 * numProducers);
+  BOOST_CHECK(queue.empty());
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testBasic)
+{
+  muduo::LockFreeBoundedQueue<int> queue(3);
+  BOOST_CHECK_EQUAL(queue.capacity(), 4u);
+  BOOST_CHECK(queue.empty());
+  for (int i = 0; i < 4; ++i)
+  {
+    BOOST_CHECK(queue.tryPut(std::move(i)));
+  }
+  int x = 42;
+  BOOST_CHECK(queue.full());
+  BOOST_CHECK(!queue.tryPut(std::move(x)));
+  BOOST_CHECK_EQUAL(queue.size(), 4u);
+  for (int i = 0; i < 4; ++i)
+  {
+    BOOST_CHECK_EQUAL(queue.take(), i);
+  }
+  BOOST_CHECK(!queue.tryTake(&x));
+  BOOST_CHECK_EQUAL(x, 42);
+}
+
+BOOST_AUTO_TEST_CASE(testMove)
+{
+  muduo::LockFreeBoundedQueue<std::unique_ptr<int>> queue(10);
+  queue.put(std::unique_ptr<int>(new int(42)));
+  std::unique_ptr<int> x = queue.take();
+  BOOST_CHECK_EQUAL(*x, 42);
+  std::unique_ptr<int> y(new int(43));
+  BOOST_CHECK(queue.tryPut(std::move(y)));
+  BOOST_CHECK(y == NULL);
+  BOOST_CHECK(queue.tryTake(&x));
+  BOOST_CHECK_EQUAL(*x, 43);
+}
+
+BOOST_AUTO_TEST_CASE(testOneProducerOneConsumer)
+{
+  testThreads(1, 1);
+}
+
+BOOST_AUTO_TEST_CASE(testManyProducers)
+{
+  testThreads(4, 1);
+}
+
+BOOST_AUTO_TEST_CASE(testManyConsumers)
+{
+  testThreads(1, 4);
+}
+
+BOOST_AUTO_TEST_CASE(testManyProducersManyConsumers)
+{
+  testThreads(4, 4);
+}
@@ -0,0 +1,121 @@
+#include "muduo/base/Metrics.h"
+#include "muduo/base/Thread.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+
+BOOST_AUTO_TEST_CASE(testBuckets)
+{
+  int last = -1;
+  for (int64_t v = 0; v < (int64_t(1) << 20); ++v)
+  {
+    int b = metrics::Histogram::bucketOf(v);
+    // checked one by one, a million checks are slow
+    if ((b != last && b != last + 1)
+        || v > metrics::Histogram::upperBound(b)
+        || (b > 0 && v <= metrics::Histogram::upperBound(b - 1)))
+    {
+      BOOST_ERROR("wrong bucket " << b << " of " << v);
+      break;
+    }
+    last = b;
+  }
+  int64_t huge = int64_t(1) << 50;
+  BOOST_CHECK_EQUAL(metrics::Histogram::bucketOf(huge), metrics::Histogram::kBuckets - 1);
+}
+
+BOOST_AUTO_TEST_CASE(testPercentile)
+{
+  metrics::Histogram histogram("test_percentile", "values 1..1000");
+  for (int64_t v = 1; v <= 1000; ++v)
+  {
+    histogram.record(v);
+  }
+  metrics::Histogram::Snapshot snap(histogram.snapshot());
+  BOOST_CHECK_EQUAL(snap.count, 1000);
+  BOOST_CHECK_EQUAL(snap.sum, 500500);
+  BOOST_CHECK_EQUAL(snap.max, 1000);
+  int64_t p50 = snap.percentile(50);
+  int64_t p99 = snap.percentile(99);
+  // within 1/16 of the true value
+  BOOST_CHECK(p50 >= 500 && p50 <= 500 + 500 / 16);
+  BOOST_CHECK(p99 >= 990 && p99 <= 1000);
+  BOOST_CHECK_EQUAL(snap.percentile(100), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(testThreads)
+{
+  metrics::Counter counter("test_counter_total", "added by threads");
+  metrics::Histogram histogram("test_threads", "recorded by threads");
+  const int kThreads = 8;
+  const int kTimes = 100000;
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < kThreads; ++i)
+  {
+    threads.emplace_back(new Thread([&counter, &histogram] {
+      for (int j = 0; j < kTimes; ++j)
+      {
+        counter.add();
+        histogram.record(j % 100);
+      }
+    }));
+    threads.back()->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  BOOST_CHECK_EQUAL(counter.value(), kThreads * kTimes);
+  BOOST_CHECK_EQUAL(histogram.snapshot().count, kThreads * kTimes);
+  BOOST_CHECK_EQUAL(histogram.snapshot().max, 99);
+}
+
+BOOST_AUTO_TEST_CASE(testRegistry)
+{
+  string text;
+  {
+  metrics::Gauge gauge("test_gauge", "a gauge");
+  metrics::Gauge computed("test_computed", "a computed gauge", [] { return 42; });
+  gauge.set(7);
+  text = metrics::Registry::instance().toText();
+  BOOST_CHECK(text.find("test_gauge 7\n") != string::npos);
+  BOOST_CHECK(text.find("test_computed 42\n") != string::npos);
+  string prometheus = metrics::Registry::instance().toPrometheus();
+  BOOST_CHECK(prometheus.find("# TYPE test_gauge gauge\n") != string::npos);
+  }
+  text = metrics::Registry::instance().toText();
+  BOOST_CHECK(text.find("test_gauge") == string::npos);
+}
+
+// metrics destroyed while being formatted, best run with -fsanitize=address
+BOOST_AUTO_TEST_CASE(testFormatWhileDestroying)
+{
+  std::atomic<bool> running(true);
+  Thread churn([&running] {
+    while (running)
+    {
+      metrics::Histogram histogram("test_churn", "created and destroyed");
+      histogram.record(1);
+      metrics::Gauge gauge("test_churn_gauge", "created and destroyed", [] { return 1; });
+    }
+  });
+  churn.start();
+  int formatted = 0;
+  for (int i = 0; i < 10000; ++i)
+  {
+    if (metrics::Registry::instance().toPrometheus().find("test_churn_count 1\n") != string::npos)
+    {
+      ++formatted;
+    }
+  }
+  running = false;
+  churn.join();
+  BOOST_TEST_MESSAGE("formatted test_churn " << formatted << " times");
+}
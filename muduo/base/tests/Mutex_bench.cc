@@ -0,0 +1,110 @@
+// Contention of MutexLock, SpinThenParkMutex and SpinThenParkRWMutex,
+// with short critical sections like EventLoop::queueInLoop().
+//
+// Usage: mutex_bench [max_threads] [ops_per_thread]
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+
+struct Counter
+{
+  int64_t value = 0;
+  int64_t padding[7];
+};
+
+template<typename Mutex>
+struct Reader
+{
+  static int64_t get(Mutex& mutex, const Counter& counter)
+  {
+    LockGuard<Mutex> lock(mutex);
+    return counter.value;
+  }
+};
+
+template<>
+struct Reader<SpinThenParkRWMutex>
+{
+  static int64_t get(SpinThenParkRWMutex& mutex, const Counter& counter)
+  {
+    ReaderLockGuard lock(mutex);
+    return counter.value;
+  }
+};
+
+// every readRatio-th operation is a write, 0 for all writes.
+template<typename Mutex>
+double bench(int numThreads, int ops, int readRatio)
+{
+  Mutex mutex;
+  Counter counter;
+  CountDownLatch latch(1);
+  std::vector<std::unique_ptr<Thread>> threads;
+  int64_t sink = 0;
+  for (int i = 0; i < numThreads; ++i)
+  {
+    threads.emplace_back(new Thread([&mutex, &counter, &latch, &sink, ops, readRatio] {
+      latch.wait();
+      int64_t sum = 0;
+      for (int j = 0; j < ops; ++j)
+      {
+        if (readRatio > 0 && j % readRatio != 0)
+        {
+          sum += Reader<Mutex>::get(mutex, counter);
+        }
+        else
+        {
+          LockGuard<Mutex> lock(mutex);
+          ++counter.value;
+        }
+      }
+      LockGuard<Mutex> lock(mutex);
+      sink += sum;
+    }));
+    threads.back()->start();
+  }
+  Timestamp start(Timestamp::now());
+  latch.countDown();
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  int64_t writes = readRatio > 0 ? (ops + readRatio - 1) / readRatio : ops;
+  if (counter.value != writes * numThreads)
+  {
+    printf("FAIL %lld != %lld\n",
+           static_cast<long long>(counter.value),
+           static_cast<long long>(writes * numThreads));
+    abort();
+  }
+  return static_cast<double>(ops) * numThreads / seconds / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+  int maxThreads = argc > 1 ? atoi(argv[1]) : 64;
+  int ops = argc > 2 ? atoi(argv[2]) : 200 * 1000;
+
+  printf("million lock/unlock per second, %d per thread\n", ops);
+  printf("threads   MutexLock  SpinThenPark  RWMutex(w)  |  MutexLock  RWMutex(r)  1 write per 16\n");
+  for (int n = 1; n <= maxThreads; n *= 2)
+  {
+    printf("%7d  %10.2f  %12.2f  %10.2f  |  %9.2f  %10.2f\n", n,
+           bench<MutexLock>(n, ops, 0),
+           bench<SpinThenParkMutex>(n, ops, 0),
+           bench<SpinThenParkRWMutex>(n, ops, 0),
+           bench<MutexLock>(n, ops, 16),
+           bench<SpinThenParkRWMutex>(n, ops, 16));
+  }
+}
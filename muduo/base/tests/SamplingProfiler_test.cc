@@ -0,0 +1,50 @@
+#include "muduo/base/SamplingProfiler.h"
+#include "muduo/base/Timestamp.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+
+namespace
+{
+
+volatile double g_sink;
+
+// burns CPU for seconds
+__attribute__((noinline)) void spin(double seconds)
+{
+  Timestamp start(Timestamp::now());
+  double x = 1.0;
+  while (timeDifference(Timestamp::now(), start) < seconds)
+  {
+    for (int i = 0; i < 10000; ++i)
+    {
+      x = x * 1.0000001 + 0.5;
+    }
+  }
+  g_sink = x;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testProfile)
+{
+  SamplingProfiler& profiler = SamplingProfiler::instance();
+  BOOST_REQUIRE(profiler.start(250));
+  BOOST_CHECK(!profiler.start(250));
+  spin(1.0);
+  profiler.stop();
+  BOOST_CHECK(!profiler.started());
+
+  string stacks = profiler.collapsed();
+  BOOST_TEST_MESSAGE(stacks);
+  BOOST_TEST_MESSAGE(profiler.samples() << " samples, " << profiler.dropped() << " dropped");
+  BOOST_CHECK_GT(profiler.samples(), 0);
+  BOOST_CHECK(!stacks.empty());
+  BOOST_CHECK(stacks.find('\n') != string::npos);
+
+  profiler.reset();
+  BOOST_CHECK(profiler.collapsed().empty());
+}
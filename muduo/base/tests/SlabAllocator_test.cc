@@ -0,0 +1,164 @@
+#include "muduo/base/SlabAllocator.h"
+#include "muduo/base/Thread.h"
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+
+namespace
+{
+
+std::atomic<int> g_alive(0);
+
+struct Object
+{
+  explicit Object(int v) : value(v) { ++g_alive; }
+  ~Object() { --g_alive; }
+  int value;
+  char payload[100];
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testReuse)
+{
+  SlabAllocator pool;
+  std::vector<void*> blocks;
+  std::set<void*> distinct;
+  for (size_t size = 1; size <= SlabAllocator::kMaxSize; size += 7)
+  {
+    void* p = pool.allocate(size);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(p) % SlabAllocator::kAlignment, 0u);
+    memset(p, 0xcc, size);
+    blocks.push_back(p);
+    BOOST_CHECK(distinct.insert(p).second);
+  }
+  SlabAllocator::Stats stats = pool.stats();
+  BOOST_CHECK_EQUAL(stats.allocations, static_cast<int64_t>(blocks.size()));
+  BOOST_CHECK_EQUAL(stats.fallbacks, 0);
+  BOOST_CHECK_GT(stats.bytesInUse, 0u);
+
+  size_t i = 0;
+  for (size_t size = 1; size <= SlabAllocator::kMaxSize; size += 7)
+  {
+    pool.deallocate(blocks[i++], size);
+  }
+  BOOST_CHECK_EQUAL(pool.stats().bytesInUse, 0u);
+
+  // same size class, same block
+  void* p = pool.allocate(100);
+  pool.deallocate(p, 100);
+  void* q = pool.allocate(97);
+  BOOST_CHECK_EQUAL(p, q);
+  pool.deallocate(q, 97);
+
+  size_t slabBytes = pool.stats().slabBytes;
+  for (int n = 0; n < 10000; ++n)
+  {
+    pool.deallocate(pool.allocate(200), 200);
+  }
+  BOOST_CHECK_EQUAL(pool.stats().slabBytes, slabBytes);
+
+  void* big = pool.allocate(SlabAllocator::kMaxSize + 1);
+  BOOST_CHECK_EQUAL(pool.stats().fallbacks, 1);
+  pool.deallocate(big, SlabAllocator::kMaxSize + 1);
+}
+
+BOOST_AUTO_TEST_CASE(testReserve)
+{
+  SlabAllocator pool;
+  pool.reserve();
+  pool.reserve();  // already reserved
+  BOOST_CHECK_EQUAL(pool.stats().slabBytes, SlabAllocator::kSlabSize);
+
+  // the first slab is the reserved one
+  void* p = pool.allocate(100);
+  BOOST_CHECK_EQUAL(pool.stats().slabBytes, SlabAllocator::kSlabSize);
+  pool.reserve();
+  BOOST_CHECK_EQUAL(pool.stats().slabBytes, 2 * SlabAllocator::kSlabSize);
+  pool.deallocate(p, 100);
+}
+
+BOOST_AUTO_TEST_CASE(testPooled)
+{
+  std::shared_ptr<SlabAllocator> pool = std::make_shared<SlabAllocator>();
+  {
+  PooledPtr<Object> obj = makePooled<Object>(pool.get(), 42);
+  BOOST_CHECK_EQUAL(obj->value, 42);
+  BOOST_CHECK_EQUAL(g_alive.load(), 1);
+  BOOST_CHECK_EQUAL(pool->stats().allocations, 1);
+  PooledPtr<Object> heap = makePooled<Object>(NULL, 43);
+  BOOST_CHECK_EQUAL(heap->value, 43);
+  BOOST_CHECK_EQUAL(pool->stats().allocations, 1);
+  }
+  BOOST_CHECK_EQUAL(g_alive.load(), 0);
+  BOOST_CHECK_EQUAL(pool->stats().bytesInUse, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testAllocateShared)
+{
+  std::weak_ptr<Object> weak;
+  std::weak_ptr<SlabAllocator> weakPool;
+  {
+  std::shared_ptr<SlabAllocator> pool = std::make_shared<SlabAllocator>();
+  weakPool = pool;
+  std::shared_ptr<Object> obj =
+      std::allocate_shared<Object>(PoolAllocator<Object>(pool), 7);
+  BOOST_CHECK_EQUAL(obj->value, 7);
+  BOOST_CHECK_EQUAL(pool->stats().allocations, 1);
+  weak = obj;
+  obj.reset();
+  BOOST_CHECK_EQUAL(g_alive.load(), 0);
+  }
+  // the control block keeps the pool
+  BOOST_CHECK(!weakPool.expired());
+  weak.reset();
+  BOOST_CHECK(weakPool.expired());
+}
+
+BOOST_AUTO_TEST_CASE(testThreads)
+{
+  std::shared_ptr<SlabAllocator> pool = std::make_shared<SlabAllocator>();
+  const int kObjects = 100000;
+  std::vector<std::shared_ptr<Object>> objects;
+  objects.reserve(kObjects);
+  for (int i = 0; i < kObjects; ++i)
+  {
+    objects.push_back(std::allocate_shared<Object>(PoolAllocator<Object>(pool), i));
+  }
+  // freed in other threads, like connections destroyed out of their loops
+  std::vector<std::unique_ptr<Thread>> threads;
+  const int kThreads = 4;
+  std::atomic<int> wrong(0);
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads.emplace_back(new Thread([&objects, &wrong, t, pool] {
+      for (size_t i = t; i < objects.size(); i += kThreads)
+      {
+        if (objects[i]->value != static_cast<int>(i))
+        {
+          ++wrong;
+        }
+        objects[i].reset();
+        pool->deallocate(pool->allocate(64), 64);
+      }
+    }));
+    threads.back()->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  BOOST_CHECK_EQUAL(wrong.load(), 0);
+  BOOST_CHECK_EQUAL(g_alive.load(), 0);
+  BOOST_CHECK_EQUAL(pool->stats().bytesInUse, 0u);
+}
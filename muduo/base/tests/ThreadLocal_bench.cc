@@ -0,0 +1,130 @@
+// Lookup cost of per-thread values: pthread_getspecific() as ThreadLocal
+// used to do, ThreadLocal, ThreadLocalSingleton, C++11 thread_local
+// and raw __thread.
+//
+// Usage: threadlocal_bench [threads] [lookups_per_thread]
+
+#include "muduo/base/Thread.h"
+#include "muduo/base/ThreadLocal.h"
+#include "muduo/base/ThreadLocalSingleton.h"
+#include "muduo/base/Timestamp.h"
+
+#include <memory>
+#include <vector>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+
+struct Cache
+{
+  Cache() : hits(0) {}
+  int64_t hits;
+};
+
+// the previous implementation of ThreadLocal
+template<typename T>
+class PthreadKey : noncopyable
+{
+ public:
+  PthreadKey() { pthread_key_create(&pkey_, &PthreadKey::destructor); }
+  ~PthreadKey() { pthread_key_delete(pkey_); }
+
+  T& value()
+  {
+    T* perThreadValue = static_cast<T*>(pthread_getspecific(pkey_));
+    if (!perThreadValue)
+    {
+      perThreadValue = new T();
+      pthread_setspecific(pkey_, perThreadValue);
+    }
+    return *perThreadValue;
+  }
+
+ private:
+  static void destructor(void* x) { delete static_cast<T*>(x); }
+
+  pthread_key_t pkey_;
+};
+
+PthreadKey<Cache> g_pthreadKey;
+ThreadLocal<Cache> g_threadLocal;
+// a few more, so g_threadLocal is not the first slot
+ThreadLocal<Cache> g_threadLocal2;
+ThreadLocal<Cache> g_threadLocal3;
+thread_local Cache t_cache;
+__thread int64_t t_hits;
+
+struct ViaPthreadKey
+{
+  static int64_t& get() { return g_pthreadKey.value().hits; }
+};
+
+struct ViaThreadLocal
+{
+  static int64_t& get() { return g_threadLocal3.value().hits; }
+};
+
+struct ViaThreadLocalSingleton
+{
+  static int64_t& get() { return ThreadLocalSingleton<Cache>::instance().hits; }
+};
+
+struct ViaCxx11ThreadLocal
+{
+  static int64_t& get() { return t_cache.hits; }
+};
+
+struct ViaRawThread
+{
+  static int64_t& get() { return t_hits; }
+};
+
+template<typename Via>
+__attribute__((noinline)) void lookup(int times)
+{
+  for (int i = 0; i < times; ++i)
+  {
+    ++Via::get();
+    asm volatile("" ::: "memory");  // a lookup per iteration
+  }
+}
+
+template<typename Via>
+void bench(const char* name, int numThreads, int times)
+{
+  std::vector<std::unique_ptr<Thread>> threads;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < numThreads; ++i)
+  {
+    threads.emplace_back(new Thread([times] {
+      lookup<Via>(times);
+      if (Via::get() != times)
+      {
+        abort();
+      }
+    }));
+    threads.back()->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  // per lookup of a thread, as if threads ran in parallel
+  printf("%-24s %6.2f ns/lookup\n", name, seconds * 1e9 / times);
+}
+
+int main(int argc, char* argv[])
+{
+  int numThreads = argc > 1 ? atoi(argv[1]) : 1;
+  int times = argc > 2 ? atoi(argv[2]) : 100 * 1000 * 1000;
+  printf("%d threads, %d lookups per thread\n", numThreads, times);
+  bench<ViaPthreadKey>("pthread_getspecific", numThreads, times);
+  bench<ViaThreadLocal>("ThreadLocal", numThreads, times);
+  bench<ViaThreadLocalSingleton>("ThreadLocalSingleton", numThreads, times);
+  bench<ViaCxx11ThreadLocal>("thread_local", numThreads, times);
+  bench<ViaRawThread>("__thread", numThreads, times);
+}
@@ -2,8 +2,14 @@
 #include "muduo/base/CountDownLatch.h"
 #include "muduo/base/CurrentThread.h"
 #include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <atomic>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>  // usleep
 
 void print()
@@ -41,24 +47,133 @@ void test(int maxSize)
   pool.stop();
 }
 
-/*
- * Wish we could do this in the future.
+void printInt(const std::unique_ptr<int>& x)
+{
+  printf("%d: %d\n", muduo::CurrentThread::tid(), *x);
+}
+
 void testMove()
 {
   muduo::ThreadPool pool;
   pool.start(2);
 
   std::unique_ptr<int> x(new int(42));
-  pool.run([y = std::move(x)]{ printf("%d: %d\n", muduo::CurrentThread::tid(), *y); });
+  // Task is move-only, so is the bind expression.
+  pool.run(std::bind(printInt, std::move(x)));
+  muduo::CountDownLatch latch(1);
+  pool.run(std::bind(&muduo::CountDownLatch::countDown, &latch));
+  latch.wait();
   pool.stop();
 }
-*/
 
-int main()
+// tasks waiting for room in the queue when the pool stops are dropped,
+// as are tasks run after stop().
+void testStop()
 {
+  muduo::ThreadPool pool("StopThreadPool");
+  pool.setMaxQueueSize(1);
+  pool.start(1);
+  muduo::CountDownLatch started(1);
+  muduo::CountDownLatch release(1);
+  pool.run([&] { started.countDown(); release.wait(); });
+  started.wait();
+  std::atomic<bool> ran(false);
+  pool.run([&] { ran = true; });
+
+  muduo::Thread blocked([&] { pool.run([&] { ran = true; }); });
+  blocked.start();
+  usleep(100*1000);
+  muduo::Thread stopper([&] { pool.stop(); });
+  stopper.start();
+  blocked.join();
+  release.countDown();
+  stopper.join();
+
+  pool.run([&] { ran = true; });
+  usleep(100*1000);
+  if (ran || pool.queueSize() != 1)
+  {
+    printf("testStop failed, ran=%d queueSize=%zu\n", ran.load(), pool.queueSize());
+    abort();
+  }
+}
+
+std::atomic<int64_t> g_done;
+
+void noop()
+{
+  g_done.fetch_add(1, std::memory_order_relaxed);
+}
+
+// each task spawns two until depth is 0, 2^(depth+1)-1 tasks in all.
+void spawn(muduo::ThreadPool* pool, int depth)
+{
+  if (depth > 0)
+  {
+    pool->run(std::bind(spawn, pool, depth - 1));
+    pool->run(std::bind(spawn, pool, depth - 1));
+  }
+  g_done.fetch_add(1, std::memory_order_relaxed);
+}
+
+void waitFor(int64_t n)
+{
+  while (g_done.load() < n)
+  {
+    usleep(100);
+  }
+}
+
+// tasks per second, of tasks posted by main thread,
+// and of tasks posted by tasks, which are stolen by idle workers.
+void bench(int numThreads)
+{
+  muduo::ThreadPool pool("BenchThreadPool");
+  pool.start(numThreads);
+
+  const int64_t kTasks = 1000 * 1000;
+  g_done = 0;
+  muduo::Timestamp start(muduo::Timestamp::now());
+  for (int64_t i = 0; i < kTasks; ++i)
+  {
+    pool.run(noop);
+  }
+  waitFor(kTasks);
+  double injected = timeDifference(muduo::Timestamp::now(), start);
+
+  const int kDepth = 20;
+  const int64_t kSpawned = (int64_t(1) << (kDepth + 1)) - 1;
+  g_done = 0;
+  start = muduo::Timestamp::now();
+  pool.run(std::bind(spawn, &pool, kDepth));
+  waitFor(kSpawned);
+  double spawned = timeDifference(muduo::Timestamp::now(), start);
+
+  printf("%3d threads %12.0f injected tasks/s %12.0f spawned tasks/s\n",
+         numThreads,
+         static_cast<double>(kTasks) / injected,
+         static_cast<double>(kSpawned) / spawned);
+  pool.stop();
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    int maxThreads = argc > 2 ? atoi(argv[2]) : static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    for (int n = 1; n < maxThreads; n *= 2)
+    {
+      bench(n);
+    }
+    bench(maxThreads);
+    return 0;
+  }
   test(0);
   test(1);
   test(5);
   test(10);
   test(50);
+  testMove();
+  testStop();
+  printf("Usage: %s bench [max_threads] for tasks per second\n", argv[0]);
 }
@@ -33,6 +33,7 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
   acceptSocket_.setReuseAddr(true);
   acceptSocket_.setReusePort(reuseport);
   acceptSocket_.bindAddress(listenAddr);
+  acceptChannel_.setName("Acceptor");
   acceptChannel_.setReadCallback(
       std::bind(&Acceptor::handleRead, this));
 }
@@ -52,6 +53,11 @@ void Acceptor::listen()
   acceptChannel_.enableReading();
 }
 
+InetAddress Acceptor::listenAddress() const
+{
+  return InetAddress(sockets::getLocalAddr(acceptSocket_.fd()));
+}
+
 void Acceptor::handleRead()
 {
   loop_->assertInLoopThread();
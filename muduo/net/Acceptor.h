@@ -41,6 +41,9 @@ class Acceptor : noncopyable
   bool listenning() const { return listenning_; }
   void listen();
 
+  /// the bound address, with the port picked by the kernel if it was 0
+  InetAddress listenAddress() const;
+
  private:
   void handleRead();
 
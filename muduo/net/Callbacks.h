@@ -12,6 +12,7 @@
 #define MUDUO_NET_CALLBACKS_H
 
 #include "muduo/base/Timestamp.h"
+#include "muduo/base/UniqueFunction.h"
 
 #include <functional>
 #include <memory>
@@ -60,7 +61,9 @@ namespace net
 class Buffer;
 class TcpConnection;
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
-typedef std::function<void()> TimerCallback;
+// Owned by one Timer, move-only, a bound member function is stored in place.
+typedef UniqueFunction<void()> TimerCallback;
+// TcpServer and TcpClient copy these to every TcpConnection.
 typedef std::function<void (const TcpConnectionPtr&)> ConnectionCallback;
 typedef std::function<void (const TcpConnectionPtr&)> CloseCallback;
 typedef std::function<void (const TcpConnectionPtr&)> WriteCompleteCallback;
@@ -71,6 +74,10 @@ typedef std::function<void (const TcpConnectionPtr&,
                             Buffer*,
                             Timestamp)> MessageCallback;
 
+// reads sockfd itself, instead of to the input buffer,
+// see TcpConnection::setSocketReadCallback()
+typedef std::function<ssize_t (const TcpConnectionPtr&, int sockfd)> SocketReadCallback;
+
 void defaultConnectionCallback(const TcpConnectionPtr& conn);
 void defaultMessageCallback(const TcpConnectionPtr& conn,
                             Buffer* buffer,
@@ -32,6 +32,7 @@ Channel::Channel(EventLoop* loop, int fd__)
     revents_(0), // 获取的结果事件
     index_(-1), // 索引
     logHup_(true), 
+    name_(NULL),
     tied_(false), // not tied
     eventHandling_(false), // 默认没有处理事件
     addedToLoop_(false) // 默认还没有加入到事件循环
@@ -13,6 +13,7 @@
 
 #include "muduo/base/noncopyable.h"
 #include "muduo/base/Timestamp.h"
+#include "muduo/base/UniqueFunction.h"
 
 #include <functional>
 #include <memory>
@@ -36,8 +37,8 @@ class EventLoop;
 class Channel : noncopyable
 {
  public:
-  typedef std::function<void()> EventCallback;
-  typedef std::function<void(Timestamp)> ReadEventCallback;
+  typedef UniqueFunction<void()> EventCallback;
+  typedef UniqueFunction<void(Timestamp)> ReadEventCallback;
 
 // 构造函数
   Channel(EventLoop* loop, int fd);
@@ -98,6 +99,10 @@ class Channel : noncopyable
 
   void doNotLogHup() { logHup_ = false; }
 
+  // for reporting slow events, must outlive the channel
+  void setName(const char* name) { name_ = name; }
+  const char* name() const { return name_; }
+
 // 返回channel绑定的EventLoop
   EventLoop* ownerLoop() { return loop_; }
   // 从EventLoop中删除自己
@@ -121,6 +126,7 @@ class Channel : noncopyable
   int        revents_; // it's the received event types of epoll or poll
   int        index_; // used by Poller.
   bool       logHup_;
+  const char* name_;
 
   std::weak_ptr<void> tie_; //弱指针引用对象
   bool tied_; // tie标志位
@@ -0,0 +1,497 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_COROUTINE_H
+#define MUDUO_NET_COROUTINE_H
+
+#if __cplusplus < 202002L
+#error "muduo/net/Coroutine.h requires -std=c++20, muduo itself is built with -std=c++11"
+#endif
+
+#include "muduo/base/StringPiece.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// C++20 coroutines on EventLoop, instead of callback state machines.
+///
+/// Header only, the library is still C++11. A coroutine runs in the thread
+/// of the EventLoop it waits on, and is resumed directly from the callbacks
+/// of TcpConnection or TimerQueue, no extra thread or queue is involved.
+///
+///   coro::Task<> session(TcpConnectionPtr conn)
+///   {
+///     coro::Stream stream(conn);
+///     while (Buffer* buf = co_await stream.read(4))
+///     {
+///       ...
+///       co_await stream.write(reply);
+///     }
+///   }
+///
+///   server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+///     if (conn->connected())
+///       coro::spawn(session(conn));
+///   });
+///
+namespace coro
+{
+
+template<typename T = void>
+class Task;
+
+namespace detail
+{
+
+struct PromiseBase
+{
+  struct FinalAwaiter
+  {
+    bool await_ready() const noexcept { return false; }
+
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+    {
+      std::coroutine_handle<> continuation = h.promise().continuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+  void rethrow()
+  {
+    if (exception)
+    {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+};
+
+template<typename T>
+struct Promise : PromiseBase
+{
+  Task<T> get_return_object() noexcept;
+
+  template<typename U>
+  void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+  T result()
+  {
+    rethrow();
+    return std::move(*value);
+  }
+
+  std::optional<T> value;
+};
+
+template<>
+struct Promise<void> : PromiseBase
+{
+  Task<void> get_return_object() noexcept;
+  void return_void() const noexcept {}
+  void result() { rethrow(); }
+};
+
+}  // namespace detail
+
+///
+/// Lazy coroutine, it starts when awaited, and resumes its awaiter when done.
+/// Exceptions are rethrown to the awaiter.
+///
+template<typename T>
+class Task : noncopyable
+{
+ public:
+  typedef detail::Promise<T> promise_type;
+
+  explicit Task(std::coroutine_handle<promise_type> h) noexcept
+    : handle_(h)
+  {
+  }
+
+  Task(Task&& rhs) noexcept
+    : handle_(std::exchange(rhs.handle_, nullptr))
+  {
+  }
+
+  Task& operator=(Task&& rhs) noexcept
+  {
+    if (this != &rhs)
+    {
+      if (handle_)
+      {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(rhs.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  ~Task()
+  {
+    if (handle_)
+    {
+      handle_.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+  {
+    handle_.promise().continuation = awaiter;
+    return handle_;
+  }
+
+  T await_resume() { return handle_.promise().result(); }
+
+ private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail
+{
+
+template<typename T>
+inline Task<T> Promise<T>::get_return_object() noexcept
+{
+  return Task<T>(std::coroutine_handle<Promise>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept
+{
+  return Task<void>(std::coroutine_handle<Promise>::from_promise(*this));
+}
+
+// frees itself when done
+struct Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+inline Detached runDetached(Task<void> task)
+{
+  co_await task;
+}
+
+}  // namespace detail
+
+/// Runs task until its first suspension, then leaves it to the event loop.
+/// An exception out of task calls std::terminate().
+inline void spawn(Task<void> task)
+{
+  detail::runDetached(std::move(task));
+}
+
+///
+/// co_await sleep(loop, seconds), in the loop thread.
+///
+class SleepAwaiter
+{
+ public:
+  SleepAwaiter(EventLoop* loop, double seconds)
+    : loop_(loop),
+      seconds_(seconds)
+  {
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h)
+  {
+    loop_->runAfter(seconds_, [h] { h.resume(); });
+  }
+
+  void await_resume() const noexcept {}
+
+ private:
+  EventLoop* loop_;
+  double seconds_;
+};
+
+inline SleepAwaiter sleep(EventLoop* loop, double seconds)
+{
+  return SleepAwaiter(loop, seconds);
+}
+
+///
+/// Awaitable reads and writes of a TcpConnection.
+///
+/// It takes over the message, write complete and connection callbacks of conn,
+/// create it in the loop thread of conn, at most one for a connection.
+/// One coroutine may read while another one writes.
+///
+class Stream
+{
+ public:
+  class ReadAwaiter;
+  class WriteAwaiter;
+
+  explicit Stream(const TcpConnectionPtr& conn)
+    : conn_(conn),
+      state_(std::make_shared<State>())
+  {
+    conn_->getLoop()->assertInLoopThread();
+    std::shared_ptr<State> state(state_);
+    conn_->setMessageCallback(
+        [state](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+          if (state->reader && buf->readableBytes() >= state->need)
+          {
+            std::exchange(state->reader, nullptr).resume();
+          }
+        });
+    // not in place, we may be called by the connection callback of conn
+    TcpConnectionPtr c(conn_);
+    conn_->getLoop()->queueInLoop([state, c] {
+      if (c->disconnected())
+      {
+        state->close();
+      }
+      else
+      {
+        c->setConnectionCallback([state](const TcpConnectionPtr& cc) {
+          if (cc->disconnected())
+          {
+            state->close();
+          }
+        });
+      }
+    });
+  }
+
+  const TcpConnectionPtr& connection() const { return conn_; }
+
+  /// Input buffer of at least n bytes,
+  /// or NULL if the connection is closed before that.
+  /// Retrieve what you have consumed from it.
+  ReadAwaiter read(size_t n = 1);
+
+  /// Sends data and waits until the output buffer is empty,
+  /// false if the connection is closed.
+  WriteAwaiter write(const StringPiece& data);
+  WriteAwaiter write(Buffer* buf);
+
+  void shutdown() { conn_->shutdown(); }
+
+ private:
+  struct State
+  {
+    void close()
+    {
+      closed = true;
+      if (reader)
+      {
+        std::exchange(reader, nullptr).resume();
+      }
+      if (writer)
+      {
+        std::exchange(writer, nullptr).resume();
+      }
+    }
+
+    std::coroutine_handle<> reader;
+    size_t need = 0;
+    std::coroutine_handle<> writer;
+    bool closed = false;
+  };
+
+  TcpConnectionPtr conn_;
+  std::shared_ptr<State> state_;
+};
+
+class Stream::ReadAwaiter
+{
+ public:
+  ReadAwaiter(Stream* stream, size_t n)
+    : stream_(stream),
+      need_(n)
+  {
+  }
+
+  bool await_ready() const noexcept
+  {
+    return stream_->state_->closed
+        || stream_->conn_->inputBuffer()->readableBytes() >= need_;
+  }
+
+  void await_suspend(std::coroutine_handle<> h) noexcept
+  {
+    stream_->state_->need = need_;
+    stream_->state_->reader = h;
+  }
+
+  Buffer* await_resume() const noexcept
+  {
+    Buffer* buf = stream_->conn_->inputBuffer();
+    return buf->readableBytes() >= need_ ? buf : NULL;
+  }
+
+ private:
+  Stream* stream_;
+  size_t need_;
+};
+
+class Stream::WriteAwaiter
+{
+ public:
+  WriteAwaiter(Stream* stream, const StringPiece& data, Buffer* buf)
+    : stream_(stream),
+      data_(data),
+      buf_(buf)
+  {
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> h)
+  {
+    const TcpConnectionPtr& conn = stream_->conn_;
+    if (!conn->connected())
+    {
+      return false;
+    }
+    if (buf_)
+    {
+      conn->send(buf_);
+    }
+    else
+    {
+      conn->send(data_);
+    }
+    if (conn->bytesToWrite() == 0)
+    {
+      return false;
+    }
+    // set only when waiting, TcpConnection queues a call after every send() if there is one
+    std::shared_ptr<State> state(stream_->state_);
+    state->writer = h;
+    conn->setWriteCompleteCallback([state](const TcpConnectionPtr& c) {
+      // it is a copy being called
+      c->setWriteCompleteCallback(WriteCompleteCallback());
+      if (state->writer)
+      {
+        std::exchange(state->writer, nullptr).resume();
+      }
+    });
+    return true;
+  }
+
+  bool await_resume() const noexcept
+  {
+    return !stream_->state_->closed && stream_->conn_->connected();
+  }
+
+ private:
+  Stream* stream_;
+  StringPiece data_;
+  Buffer* buf_;
+};
+
+inline Stream::ReadAwaiter Stream::read(size_t n)
+{
+  return ReadAwaiter(this, n);
+}
+
+inline Stream::WriteAwaiter Stream::write(const StringPiece& data)
+{
+  return WriteAwaiter(this, data, NULL);
+}
+
+inline Stream::WriteAwaiter Stream::write(Buffer* buf)
+{
+  return WriteAwaiter(this, StringPiece(), buf);
+}
+
+///
+/// co_await connect(&client), resumes in the loop thread of client
+/// with the new connection.
+///
+/// It takes over the connection and message callbacks of client,
+/// received data are kept in the input buffer for a Stream.
+///
+class ConnectAwaiter
+{
+ public:
+  explicit ConnectAwaiter(TcpClient* client)
+    : client_(client)
+  {
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h)
+  {
+    state_ = std::make_shared<State>();
+    state_->handle = h;
+    std::shared_ptr<State> state(state_);
+    EventLoop* loop = client_->getLoop();
+    client_->setMessageCallback([](const TcpConnectionPtr&, Buffer*, Timestamp) {});
+    client_->setConnectionCallback([state, loop](const TcpConnectionPtr& conn) {
+      if (conn->connected() && state->handle)
+      {
+        state->conn = conn;
+        // resumes out of the connection callback, which the Stream would replace
+        loop->queueInLoop([state] { std::exchange(state->handle, nullptr).resume(); });
+      }
+    });
+    client_->connect();
+  }
+
+  TcpConnectionPtr await_resume() const { return state_->conn; }
+
+ private:
+  struct State
+  {
+    std::coroutine_handle<> handle;
+    TcpConnectionPtr conn;
+  };
+
+  TcpClient* client_;
+  std::shared_ptr<State> state_;
+};
+
+inline ConnectAwaiter connect(TcpClient* client)
+{
+  return ConnectAwaiter(client);
+}
+
+}  // namespace coro
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_COROUTINE_H
@@ -9,9 +9,12 @@
 #include "muduo/net/EventLoop.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/Metrics.h"
 #include "muduo/base/Mutex.h"
+#include "muduo/base/SlabAllocator.h"
 #include "muduo/net/Channel.h"
 #include "muduo/net/Poller.h"
+#include "muduo/net/SlowEventLog.h"
 #include "muduo/net/SocketsOps.h"
 #include "muduo/net/TimerQueue.h"
 
@@ -58,6 +61,30 @@ class IgnoreSigPipe
 #pragma GCC diagnostic error "-Wold-style-cast"
 
 IgnoreSigPipe initObj;
+
+metrics::Counter g_iterations("muduo_eventloop_iterations_total",
+                              "Iterations of all event loops");
+metrics::Histogram& g_pollWait = *new metrics::Histogram(
+    "muduo_eventloop_poll_wait_us", "Microseconds blocked in poll() per iteration");
+metrics::Histogram& g_functorQueueDepth = *new metrics::Histogram(
+    "muduo_eventloop_functor_queue_depth", "Pending functors run in one batch");
+// only when EventLoop::setSlowThreshold() is on
+metrics::Histogram& g_handleEvent = *new metrics::Histogram(
+    "muduo_eventloop_handle_event_us", "Microseconds in Channel::handleEvent()");
+metrics::Histogram& g_pendingFunctors = *new metrics::Histogram(
+    "muduo_eventloop_pending_functors_us",
+    "Microseconds running one batch of pending functors");
+
+void reportSlowEvent(Timestamp start, int64_t microSeconds, string&& what)
+{
+  SlowEvent event;
+  event.start = start;
+  event.microSeconds = microSeconds;
+  event.tid = CurrentThread::tid();
+  event.threadName = CurrentThread::name();
+  event.what = std::move(what);
+  SlowEventLog::instance().append(std::move(event));
+}
 }  // namespace
 
 // 返回当前线程的EventLoop对象
@@ -73,11 +100,16 @@ EventLoop::EventLoop()
     eventHandling_(false), // 初始化eventHandling_
     callingPendingFunctors_(false), // 初始化callingPendingFunctors_
     iteration_(0), // 初始化迭代次数
+    numaNode_(-1),
+    numConnections_(0),
+    busyMicroSeconds_(0),
+    slowThresholdUs_(0),
     threadId_(CurrentThread::tid()), // 获取当前线程的ID
     poller_(Poller::newDefaultPoller(this)), // 初始化poller_
     timerQueue_(new TimerQueue(this)), // 初始化定时器队列，定时任务在EventLoop中执行
     wakeupFd_(createEventfd()), // 初始化wakeupFd_
     wakeupChannel_(new Channel(this, wakeupFd_)), // 初始化wakeupChannel_
+    allocator_(std::make_shared<SlabAllocator>()),
     currentActiveChannel_(NULL) // 初始化currentActiveChannel_
 {
   LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
@@ -93,6 +125,7 @@ EventLoop::EventLoop()
     t_loopInThisThread = this;
   }
   // 给wakeupChannel设置读事件回调为EventLoop::handleRead()
+  wakeupChannel_->setName("EventLoop::wakeup");
   wakeupChannel_->setReadCallback(
       std::bind(&EventLoop::handleRead, this));
   // we are always reading the wakeupfd
@@ -126,6 +159,7 @@ void EventLoop::loop()
   quit_ = false;  // FIXME: what if someone calls quit() before loop() ?
   LOG_TRACE << "EventLoop " << this << " start looping";
 
+  Timestamp iterationEnd(Timestamp::now());
   while (!quit_)
   {
     // 清空活动的channel集合
@@ -133,6 +167,9 @@ void EventLoop::loop()
     // 调用同步事件分派器，poll()函数会阻塞，直到有IO事件发生
     pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
     ++iteration_; // 执行过多少次poll()的计数
+    g_iterations.add();
+    g_pollWait.record(pollReturnTime_.microSecondsSinceEpoch()
+                      - iterationEnd.microSecondsSinceEpoch());
     if (Logger::logLevel() <= Logger::TRACE)
     {
       // 打印所有的活动channel信息，方便追踪和调试
@@ -140,19 +177,33 @@ void EventLoop::loop()
     }
     // TODO sort channel by priority
     eventHandling_ = true; // 表明正在进行事件分派
+    const int64_t slowThresholdUs = slowThresholdUs_.load(std::memory_order_relaxed);
     // 循环遍历所有活动channel，调用handleEvent()进行IO事件分派
     // 也就是回调用户注册的处理函数handleXXX()
     for (Channel* channel : activeChannels_)
     {
       currentActiveChannel_ = channel;
-      currentActiveChannel_->handleEvent(pollReturnTime_);
+      if (slowThresholdUs > 0)
+      {
+        handleEventProfiled(channel, slowThresholdUs);
+      }
+      else
+      {
+        currentActiveChannel_->handleEvent(pollReturnTime_);
+      }
     }
     currentActiveChannel_ = NULL;
     eventHandling_ = false;
     // 处理完IO事件分派后，对跨线程调用runInLoop()和queueInLoop()发来的函数对象进行处理
     // 通过跨线程调用，自始至终只让一个线程执行，避免多个线程同时操作共享数据结构导致的data race问题
     // 同时也实现了无锁编程
-    doPendingFunctors();
+    doPendingFunctors(slowThresholdUs);
+
+    iterationEnd = Timestamp::now();
+    int64_t busy = iterationEnd.microSecondsSinceEpoch()
+                   - pollReturnTime_.microSecondsSinceEpoch();
+    busyMicroSeconds_.store(busyMicroSeconds_.load(std::memory_order_relaxed) + busy,
+                            std::memory_order_relaxed);
   }
 
   // 如果quit_在别的位置被置为false，循环就会结束
@@ -160,6 +211,33 @@ void EventLoop::loop()
   looping_ = false;
 }
 
+// Channel is not destroyed in its handleEvent(), see Channel::~Channel().
+void EventLoop::handleEventProfiled(Channel* channel, int64_t slowThresholdUs)
+{
+  Timestamp start(Timestamp::now());
+  channel->handleEvent(pollReturnTime_);
+  int64_t elapsed = Timestamp::now().microSecondsSinceEpoch()
+                    - start.microSecondsSinceEpoch();
+  g_handleEvent.record(elapsed);
+  if (elapsed >= slowThresholdUs)
+  {
+    string what;
+    if (channel->name())
+    {
+      what = channel->name();
+      what += ' ';
+    }
+    what += channel->reventsToString();
+    reportSlowEvent(start, elapsed, std::move(what));
+  }
+}
+
+void EventLoop::setSlowThreshold(double seconds)
+{
+  int64_t us = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+  slowThresholdUs_.store(us > 0 ? us : 0, std::memory_order_relaxed);
+}
+
 // 结束事件循环
 void EventLoop::quit()
 {
@@ -196,7 +274,7 @@ void EventLoop::runInLoop(Functor cb)
 void EventLoop::queueInLoop(Functor cb)
 {
   {
-  MutexLockGuard lock(mutex_);
+  LockGuard<SpinThenParkMutex> lock(mutex_);
   pendingFunctors_.push_back(std::move(cb));
   }
 
@@ -209,7 +287,7 @@ void EventLoop::queueInLoop(Functor cb)
 // 返回现在到底有多少函数对象还在队列中没有得到执行
 size_t EventLoop::queueSize() const
 {
-  MutexLockGuard lock(mutex_);
+  LockGuard<SpinThenParkMutex> lock(mutex_);
   return pendingFunctors_.size();
 }
 
@@ -303,22 +381,43 @@ void EventLoop::handleRead()
 }
 
 // 执行跨线程调用传来的函数对象
-void EventLoop::doPendingFunctors()
+void EventLoop::doPendingFunctors(int64_t slowThresholdUs)
 {
-  std::vector<Functor> functors;
+  std::vector<Functor>& functors = runningFunctors_;
   callingPendingFunctors_ = true;
 
 // 将pendingFunctors_中的函数对象交换到局部变量functors中，避免长时间锁住共享数据
   {
-  MutexLockGuard lock(mutex_);
+  LockGuard<SpinThenParkMutex> lock(mutex_);
   functors.swap(pendingFunctors_);
   }
+  if (!functors.empty())
+  {
+    g_functorQueueDepth.record(static_cast<int64_t>(functors.size()));
+  }
 
 // 循环执行局部变量中的函数对象
+  Timestamp start;
+  if (slowThresholdUs > 0 && !functors.empty())
+  {
+    start = Timestamp::now();
+  }
   for (const Functor& functor : functors)
   {
     functor();
   }
+  if (start.valid())
+  {
+    int64_t elapsed = Timestamp::now().microSecondsSinceEpoch()
+                      - start.microSecondsSinceEpoch();
+    g_pendingFunctors.record(elapsed);
+    if (elapsed >= slowThresholdUs)
+    {
+      reportSlowEvent(start, elapsed,
+                      "pending functors x" + std::to_string(functors.size()));
+    }
+  }
+  functors.clear();
   callingPendingFunctors_ = false;
 }
 
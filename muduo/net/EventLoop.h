@@ -20,11 +20,15 @@
 #include "muduo/base/Mutex.h"
 #include "muduo/base/CurrentThread.h"
 #include "muduo/base/Timestamp.h"
+#include "muduo/base/UniqueFunction.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/TimerId.h"
 
 namespace muduo
 {
+
+class SlabAllocator;
+
 namespace net
 {
 
@@ -41,7 +45,8 @@ class EventLoop : noncopyable
 {
  public:
  // 跨线程调用时从其他线程塞进来在EventLoop所在IO线程中执行的函数对象
-  typedef std::function<void()> Functor;
+  // move-only, callables up to UniqueFunction::kInlineSize bytes are not allocated
+  typedef UniqueFunction<void()> Functor;
 // 构造函数
   EventLoop();
 // 析构函数
@@ -138,6 +143,30 @@ class EventLoop : noncopyable
   // 判断是否在进行事件的处理
   bool eventHandling() const { return eventHandling_; }
 
+  // NUMA node of the loop thread, if it is pinned by EventLoopThread, or -1
+  int numaNode() const { return numaNode_; }
+  void setNumaNode(int node) { numaNode_ = node; }
+
+  /// Load of this loop, for EventLoopThreadPool, thread safe.
+  /// Connections created on this loop and not destroyed yet.
+  int numConnections() const
+  { return numConnections_.load(std::memory_order_relaxed); }
+  /// Total time spent out of poll(), i.e. handling events and functors.
+  int64_t busyMicroSeconds() const
+  { return busyMicroSeconds_.load(std::memory_order_relaxed); }
+
+  /// Profiles every Channel::handleEvent() and batch of pending functors,
+  /// those took longer than seconds are kept in SlowEventLog, see /loop/slow of Inspector.
+  /// 0 turns it off, which is the default. Thread safe.
+  void setSlowThreshold(double seconds);
+
+  /// Pool for objects of connections on this loop, see TcpServer::newConnection().
+  const std::shared_ptr<SlabAllocator>& allocator() const { return allocator_; }
+
+  // by TcpConnection
+  void addConnections(int n)
+  { numConnections_.fetch_add(n, std::memory_order_relaxed); }
+
 // 设置上下文对象
   void setContext(const boost::any& context)
   { context_ = context; }
@@ -159,7 +188,8 @@ class EventLoop : noncopyable
   // 传递给channel的回调函数，用来读取写入到eventfd的一个字节，IO线程从poll阻塞中返回
   void handleRead();  // waked up
   // 事件循环在分派完IO事件，回调用户注册的函数后，开始执行跨线程调用发来的函数对象
-  void doPendingFunctors();
+  void doPendingFunctors(int64_t slowThresholdUs);
+  void handleEventProfiled(Channel* channel, int64_t slowThresholdUs);
 
   // 打印activeChannels中的所有对象
   void printActiveChannels() const; // DEBUG
@@ -176,6 +206,10 @@ class EventLoop : noncopyable
   bool callingPendingFunctors_; /* atomic */
   // 迭代次数
   int64_t iteration_;
+  int numaNode_;
+  std::atomic<int> numConnections_;
+  std::atomic<int64_t> busyMicroSeconds_;  // written by loop thread only
+  std::atomic<int64_t> slowThresholdUs_;
   // 线程标识
   const pid_t threadId_;
   // poll()调用返回时间
@@ -192,6 +226,7 @@ class EventLoop : noncopyable
   std::unique_ptr<Channel> wakeupChannel_;
   // 上下文对象
   boost::any context_;
+  std::shared_ptr<SlabAllocator> allocator_;
 
   // scratch variables
   // poll()函数返回的具有IO事件的channel集合
@@ -200,8 +235,10 @@ class EventLoop : noncopyable
   Channel* currentActiveChannel_;
 
   // 互斥量保护的函数对象集合
-  mutable MutexLock mutex_;
+  mutable SpinThenParkMutex mutex_;
   std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);
+  // swapped with pendingFunctors_ by doPendingFunctors(), keeps the capacity
+  std::vector<Functor> runningFunctors_;
 };
 
 }  // namespace net
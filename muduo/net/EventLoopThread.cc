@@ -8,11 +8,63 @@
 
 #include "muduo/net/EventLoopThread.h"
 
+#include "muduo/base/Logging.h"
+#include "muduo/base/SlabAllocator.h"
 #include "muduo/net/EventLoop.h"
 
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+// returns NUMA node of the thread, -1 on error
+int pinCurrentThread(const std::vector<int>& cpus, bool numaLocal)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+  {
+    CPU_SET(cpu, &set);
+  }
+  int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+  if (ret != 0)
+  {
+    errno = ret;
+    LOG_SYSERR << "pthread_setaffinity_np";
+    return -1;
+  }
+  // takes effect when the thread is scheduled next time
+  ::sched_yield();
+
+  unsigned cpu = 0, node = 0;
+  if (::syscall(SYS_getcpu, &cpu, &node, NULL) < 0)
+  {
+    LOG_SYSERR << "getcpu";
+    return -1;
+  }
+  if (numaLocal && node < 64)
+  {
+    // The default policy allocates on the node of the CPU which touches
+    // the page first, MPOL_PREFERRED keeps doing so if the thread is
+    // migrated, e.g. when cpus span nodes.
+    unsigned long nodemask = 1UL << node;
+    // kernel drops the last bit of maxnode
+    if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8 + 1) < 0)
+    {
+      LOG_SYSERR << "set_mempolicy";
+    }
+  }
+  return static_cast<int>(node);
+}
+
+}  // namespace
+
 EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
                                  const string& name)
   : loop_(NULL), // 线程创建时是没有事件循环的
@@ -20,7 +72,8 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
     thread_(std::bind(&EventLoopThread::threadFunc, this), name), // 初始化线程对象，传入要执行的函数
     mutex_(), // 互斥量构造
     cond_(mutex_), // 条件变量构造
-    callback_(cb) // 回调函数构造
+    callback_(cb), // 回调函数构造
+    numaLocal_(false)
 {
 }
 
@@ -59,9 +112,24 @@ EventLoop* EventLoopThread::startLoop()
   return loop;
 }
 
+void EventLoopThread::setCpuAffinity(const std::vector<int>& cpus, bool numaLocal)
+{
+  assert(!thread_.started());
+  cpus_ = cpus;
+  numaLocal_ = numaLocal;
+}
+
 void EventLoopThread::threadFunc()
 {
+  // before allocating anything of the loop
+  int node = cpus_.empty() ? -1 : pinCurrentThread(cpus_, numaLocal_);
   EventLoop loop;
+  if (numaLocal_)
+  {
+    loop.setNumaNode(node);
+    // connections are allocated in the acceptor thread, their first slab is here
+    loop.allocator()->reserve();
+  }
 // 线程在执行的时候，先回调一下初始化函数
   if (callback_)
   {
@@ -15,6 +15,8 @@
 #include "muduo/base/Mutex.h"
 #include "muduo/base/Thread.h"
 
+#include <vector>
+
 namespace muduo
 {
 namespace net
@@ -36,6 +38,11 @@ class EventLoopThread : noncopyable
 // 返回对应的EventLoop事件循环
   EventLoop* startLoop();
 
+  /// Pins the thread to cpus before the loop is created, must be called
+  /// before startLoop(). With numaLocal, the thread prefers memory of
+  /// its NUMA node, cpus should be on the same node then.
+  void setCpuAffinity(const std::vector<int>& cpus, bool numaLocal);
+
  private:
  // 线程中执行的函数
   void threadFunc();
@@ -46,6 +53,8 @@ class EventLoopThread : noncopyable
   MutexLock mutex_; // 互斥量，保护loop_的
   Condition cond_ GUARDED_BY(mutex_); // 条件变量
   ThreadInitCallback callback_; // 回调函数
+  std::vector<int> cpus_;
+  bool numaLocal_;
 };
 
 }  // namespace net
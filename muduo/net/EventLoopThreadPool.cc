@@ -11,6 +11,7 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThread.h"
 
+#include <stdint.h>
 #include <stdio.h>
 
 using namespace muduo;
@@ -22,7 +23,11 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const string& name
     name_(nameArg), // 初始化名称
     started_(false), // 线程还没启动
     numThreads_(0), // 0个其他事件循环线程
-    next_(0) 
+    next_(0),
+    placement_(kRoundRobin),
+    random_(reinterpret_cast<uintptr_t>(this) | 1),
+    lastBusySample_(0),
+    numaLocal_(false)
 {
 }
 
@@ -47,6 +52,21 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
     snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
     // 创建EventLoopThread
     EventLoopThread* t = new EventLoopThread(cb, buf);
+    if (!cpuSets_.empty())
+    {
+      const CpuSet& cpus = cpuSets_[i % cpuSets_.size()];
+      t->setCpuAffinity(cpus, numaLocal_);
+      for (int cpu : cpus)
+      {
+        assert(cpu >= 0);
+        if (implicit_cast<size_t>(cpu) >= loopsOfCpu_.size())
+        {
+          loopsOfCpu_.resize(cpu + 1);
+          nextOfCpu_.resize(cpu + 1);
+        }
+        loopsOfCpu_[cpu].push_back(i);
+      }
+    }
     // 新创建的EventLoopThread放到threads_中保存
     threads_.push_back(std::unique_ptr<EventLoopThread>(t));
     // 同时也保存一下对应的事件循环对象
@@ -69,8 +89,27 @@ EventLoop* EventLoopThreadPool::getNextLoop()
   // 先给loop赋初值为baseLoop
   EventLoop* loop = baseLoop_;
 
+  if (loops_.size() > 1 && (placementCallback_ || placement_ != kRoundRobin))
+  {
+    if (placementCallback_)
+    {
+      loop = placementCallback_(loops_);
+    }
+    else if (placement_ == kLeastConnections)
+    {
+      loop = leastConnections();
+    }
+    else if (placement_ == kLeastBusy)
+    {
+      loop = leastBusy();
+    }
+    else
+    {
+      loop = powerOfTwoChoices();
+    }
+  }
   // loops不为空
-  if (!loops_.empty())
+  else if (!loops_.empty())
   {
     // round-robin
     // 取下一个loop
@@ -86,6 +125,70 @@ EventLoop* EventLoopThreadPool::getNextLoop()
   return loop;
 }
 
+// ties are broken by round-robin, or a burst goes to one loop
+EventLoop* EventLoopThreadPool::leastConnections()
+{
+  size_t n = loops_.size();
+  size_t best = next_;
+  for (size_t i = 1; i < n; ++i)
+  {
+    size_t j = (next_ + i) % n;
+    if (loops_[j]->numConnections() < loops_[best]->numConnections())
+    {
+      best = j;
+    }
+  }
+  next_ = static_cast<int>((best + 1) % n);
+  return loops_[best];
+}
+
+EventLoop* EventLoopThreadPool::leastBusy()
+{
+  size_t n = loops_.size();
+  int64_t now = Timestamp::now().microSecondsSinceEpoch() / 1000;
+  if (now - lastBusySample_ >= kBusySampleInterval)
+  {
+    busySampled_.resize(n);
+    recentBusy_.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      int64_t busy = loops_[i]->busyMicroSeconds();
+      recentBusy_[i] = busy - busySampled_[i];
+      busySampled_[i] = busy;
+    }
+    lastBusySample_ = now;
+  }
+  // connections assigned since the last sample don't show up in busy time yet
+  size_t best = next_;
+  for (size_t i = 1; i < n; ++i)
+  {
+    size_t j = (next_ + i) % n;
+    if (recentBusy_[j] < recentBusy_[best]
+        || (recentBusy_[j] == recentBusy_[best]
+            && loops_[j]->numConnections() < loops_[best]->numConnections()))
+    {
+      best = j;
+    }
+  }
+  next_ = static_cast<int>((best + 1) % n);
+  return loops_[best];
+}
+
+// Mitzenmacher, "The Power of Two Choices in Randomized Load Balancing"
+EventLoop* EventLoopThreadPool::powerOfTwoChoices()
+{
+  // xorshift64
+  random_ ^= random_ << 13;
+  random_ ^= random_ >> 7;
+  random_ ^= random_ << 17;
+  size_t n = loops_.size();
+  size_t first = static_cast<size_t>(random_ % n);
+  size_t second = static_cast<size_t>((first + 1 + (random_ >> 32) % (n - 1)) % n);
+  EventLoop* a = loops_[first];
+  EventLoop* b = loops_[second];
+  return b->numConnections() < a->numConnections() ? b : a;
+}
+
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
   // 这个函数也必须在baseLoop中执行，baseLoop就是主心骨
@@ -100,6 +203,22 @@ EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
   return loop;
 }
 
+EventLoop* EventLoopThreadPool::getLoopForCpu(int cpu)
+{
+  baseLoop_->assertInLoopThread();
+  assert(started_);
+  if (cpu < 0 || implicit_cast<size_t>(cpu) >= loopsOfCpu_.size()
+      || loopsOfCpu_[cpu].empty())
+  {
+    return NULL;
+  }
+  const std::vector<int>& loops = loopsOfCpu_[cpu];
+  int& next = nextOfCpu_[cpu];
+  EventLoop* loop = loops_[loops[next]];
+  next = (next + 1) % static_cast<int>(loops.size());
+  return loop;
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
 {
   // 就没哪个函数不是在baseLoop线程中执行的
@@ -33,23 +33,55 @@ class EventLoopThreadPool : noncopyable
  public:
  // 线程初始化时回调的函数
   typedef std::function<void(EventLoop*)> ThreadInitCallback;
+  typedef std::vector<int> CpuSet;
+  /// Picks one of the loops for a new connection, in baseLoop thread.
+  typedef std::function<EventLoop*(const std::vector<EventLoop*>&)> PlacementCallback;
+
+  enum Placement
+  {
+    kRoundRobin,
+    kLeastConnections,
+    kLeastBusy,  // least time out of poll() in last kBusySampleInterval
+    kPowerOfTwoChoices,  // fewer connections of two random loops
+  };
+
+  static const int kBusySampleInterval = 100;  // ms
 // 构造函数，其中传入baseLoop是用来accept新连接的，其他的loop用来处理IO事件
   EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg);
   // 析构函数
   ~EventLoopThreadPool();
 // 设置线程的数量
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+
+  /// Pins loop i to cpuSets[i % cpuSets.size()], must be called before start().
+  /// With numaLocal, each loop allocates memory, including buffers of its
+  /// connections, on its own NUMA node. Baseloop is not pinned.
+  void setCpuAffinity(const std::vector<CpuSet>& cpuSets, bool numaLocal = false)
+  {
+    cpuSets_ = cpuSets;
+    numaLocal_ = numaLocal;
+  }
   // 启动线程，启动时传入回调
   void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
+  /// How getNextLoop() picks a loop, round-robin by default.
+  /// Loops publish their load through atomics, see EventLoop::numConnections().
+  void setPlacement(Placement placement)
+  { placement_ = placement; }
+  void setPlacementCallback(const PlacementCallback& cb)
+  { placementCallback_ = cb; }
+
   // valid after calling start()
-  /// round-robin
-  // 以round-robin策略分配事件循环，这里可以改进一下，以不同策略分配loop
+  // 按placement_分配事件循环，默认round-robin
   EventLoop* getNextLoop();
 
   /// with the same hash code, it will always return the same EventLoop
 // 用hash值来散列分配loop
   EventLoop* getLoopForHash(size_t hashCode);
+
+  /// The loop pinned to cpu, NULL if none, e.g. for SO_INCOMING_CPU.
+  /// If cpu is in several sets, loops of them are taken in turn.
+  EventLoop* getLoopForCpu(int cpu);
 // 获取所有的事件循环
   std::vector<EventLoop*> getAllLoops();
 
@@ -61,14 +93,30 @@ class EventLoopThreadPool : noncopyable
   { return name_; }
 
  private:
+  EventLoop* leastConnections();
+  EventLoop* leastBusy();
+  EventLoop* powerOfTwoChoices();
+
 // 基础事件循环
   EventLoop* baseLoop_;
   string name_; // 名称
   bool started_; // 线程池是否已启动
   int numThreads_; // 线程数量
   int next_; // 下一个的索引
+  Placement placement_;
+  PlacementCallback placementCallback_;
+  uint64_t random_;  // of kPowerOfTwoChoices
+  int64_t lastBusySample_;  // ms
+  // busyMicroSeconds() of loops at last sample, and the increase since the one before
+  std::vector<int64_t> busySampled_;
+  std::vector<int64_t> recentBusy_;
   std::vector<std::unique_ptr<EventLoopThread>> threads_; // 事件循环线程集合
   std::vector<EventLoop*> loops_; // 事件循环集合
+  std::vector<CpuSet> cpuSets_;
+  bool numaLocal_;
+  // indices of loops pinned to each CPU, and the next one to use
+  std::vector<std::vector<int>> loopsOfCpu_;
+  std::vector<int> nextOfCpu_;
 };
 
 }  // namespace net
@@ -0,0 +1,74 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/SlowEventLog.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+SlowEventLog& SlowEventLog::instance()
+{
+  static SlowEventLog log;
+  return log;
+}
+
+void SlowEventLog::append(SlowEvent&& event)
+{
+  MutexLockGuard lock(mutex_);
+  if (events_.size() < kCapacity)
+  {
+    events_.push_back(std::move(event));
+  }
+  else
+  {
+    events_[static_cast<size_t>(total_) % kCapacity] = std::move(event);
+  }
+  ++total_;
+}
+
+std::vector<SlowEvent> SlowEventLog::recent() const
+{
+  std::vector<SlowEvent> result;
+  MutexLockGuard lock(mutex_);
+  result.reserve(events_.size());
+  size_t first = events_.size() < kCapacity ? 0 : static_cast<size_t>(total_) % kCapacity;
+  for (size_t i = 0; i < events_.size(); ++i)
+  {
+    result.push_back(events_[(first + i) % events_.size()]);
+  }
+  return result;
+}
+
+int64_t SlowEventLog::total() const
+{
+  MutexLockGuard lock(mutex_);
+  return total_;
+}
+
+string SlowEventLog::toString() const
+{
+  std::vector<SlowEvent> events(recent());
+  char buf[256];
+  snprintf(buf, sizeof buf, "%lld slow events, last %zd shown\n",
+           static_cast<long long>(total()), events.size());
+  string result(buf);
+  for (const SlowEvent& event : events)
+  {
+    snprintf(buf, sizeof buf, "%s %8lldus %d %-16s ",
+             event.start.toFormattedString().c_str(),
+             static_cast<long long>(event.microSeconds),
+             event.tid,
+             event.threadName.c_str());
+    result += buf;
+    result += event.what;
+    result += '\n';
+  }
+  return result;
+}
@@ -0,0 +1,70 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_SLOWEVENTLOG_H
+#define MUDUO_NET_SLOWEVENTLOG_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+
+#include <vector>
+
+#include <sys/types.h>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Event handlers and functors which blocked an EventLoop for longer than
+/// its slow threshold, see EventLoop::setSlowThreshold().
+///
+struct SlowEvent
+{
+  Timestamp start;
+  int64_t microSeconds;
+  pid_t tid;
+  string threadName;
+  string what;  // channel name and revents, or number of functors
+};
+
+///
+/// Ring buffer of the most recent SlowEvents of all loops,
+/// served by Inspector at /loop/slow.
+///
+class SlowEventLog : noncopyable
+{
+ public:
+  static const size_t kCapacity = 256;
+
+  static SlowEventLog& instance();
+
+  void append(SlowEvent&& event);
+
+  // oldest first
+  std::vector<SlowEvent> recent() const;
+  int64_t total() const;
+
+  string toString() const;
+
+ private:
+  SlowEventLog() = default;
+
+  mutable MutexLock mutex_;
+  std::vector<SlowEvent> events_ GUARDED_BY(mutex_);
+  int64_t total_ GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SLOWEVENTLOG_H
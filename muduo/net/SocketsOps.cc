@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>  // snprintf
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/uio.h>  // readv
 #include <unistd.h>
@@ -176,6 +177,19 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
   return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::sendfile(int sockfd, int fd, int64_t* offset, size_t count)
+{
+  off_t off = static_cast<off_t>(*offset);
+  ssize_t n = ::sendfile(sockfd, fd, &off, count);
+  *offset = off;
+  return n;
+}
+
+ssize_t sockets::splice(int fdIn, int fdOut, size_t count)
+{
+  return ::splice(fdIn, NULL, fdOut, NULL, count, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}
+
 void sockets::close(int sockfd)
 {
   if (::close(sockfd) < 0)
@@ -257,6 +271,22 @@ int sockets::getSocketError(int sockfd)
   }
 }
 
+int sockets::getIncomingCpu(int sockfd)
+{
+#ifdef SO_INCOMING_CPU
+  int cpu = -1;
+  socklen_t optlen = static_cast<socklen_t>(sizeof cpu);
+  if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) < 0)
+  {
+    return -1;
+  }
+  return cpu;
+#else
+  (void)sockfd;
+  return -1;
+#endif
+}
+
 struct sockaddr_in6 sockets::getLocalAddr(int sockfd)
 {
   struct sockaddr_in6 localaddr;
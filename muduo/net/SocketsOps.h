@@ -32,6 +32,10 @@ int  accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void *buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, size_t count);
+// from a regular file at *offset, which is advanced
+ssize_t sendfile(int sockfd, int fd, int64_t* offset, size_t count);
+// moves data between a pipe and a socket, without blocking on either
+ssize_t splice(int fdIn, int fdOut, size_t count);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
@@ -46,6 +50,8 @@ void fromIpPort(const char* ip, uint16_t port,
                 struct sockaddr_in6* addr);
 
 int getSocketError(int sockfd);
+// CPU which handled the last packet of sockfd, SO_INCOMING_CPU, -1 if unknown
+int getIncomingCpu(int sockfd);
 
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in* addr);
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in6* addr);
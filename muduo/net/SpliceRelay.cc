@@ -0,0 +1,163 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/SpliceRelay.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t SpliceRelay::kDefaultPipeSize;
+
+SpliceRelay::SpliceRelay(const TcpConnectionPtr& first,
+                         const TcpConnectionPtr& second,
+                         size_t pipeSize)
+  : pipeSize_(pipeSize)
+{
+  assert(first->getLoop() == second->getLoop());
+  for (int i = 0; i < 2; ++i)
+  {
+    Direction& d = directions_[i];
+    d.from = i == 0 ? first : second;
+    d.to = i == 0 ? second : first;
+    d.capacity = 0;
+    d.eof = false;
+    d.bytes = 0;
+  }
+}
+
+SpliceRelay::Pipe::~Pipe()
+{
+  if (fds[0] >= 0)
+  {
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+}
+
+void SpliceRelay::start()
+{
+  directions_[0].from->getLoop()->assertInLoopThread();
+  for (Direction& d : directions_)
+  {
+    d.pipe = std::make_shared<Pipe>();
+    if (::pipe2(d.pipe->fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+      LOG_SYSERR << "SpliceRelay::start";
+      d.from->forceClose();
+      d.to->forceClose();
+      return;
+    }
+    // fails beyond /proc/sys/fs/pipe-max-size, the pipe keeps its size then
+    ::fcntl(d.pipe->fds[1], F_SETPIPE_SZ, static_cast<int>(pipeSize_));
+    int size = ::fcntl(d.pipe->fds[1], F_GETPIPE_SZ);
+    d.capacity = size > 0 ? static_cast<size_t>(size) : 4096;
+  }
+
+  std::weak_ptr<SpliceRelay> wkRelay(shared_from_this());
+  for (int i = 0; i < 2; ++i)
+  {
+    Direction& d = directions_[i];
+    d.from->setSocketReadCallback(std::bind(&SpliceRelay::relayWeak, wkRelay, i, _2));
+    if (d.from->inputBuffer()->readableBytes() > 0)
+    {
+      d.to->send(d.from->inputBuffer());
+    }
+    d.from->startRead();
+  }
+}
+
+ssize_t SpliceRelay::relayWeak(const std::weak_ptr<SpliceRelay>& wkRelay,
+                               int which, int sockfd)
+{
+  SpliceRelayPtr relay = wkRelay.lock();
+  if (relay)
+  {
+    return relay->relay(which, sockfd);
+  }
+  // stops reading
+  return 0;
+}
+
+ssize_t SpliceRelay::relay(int which, int sockfd)
+{
+  Direction& d = directions_[which];
+  // the pipe holds at most what the other side has to write
+  size_t queued = d.to->bytesToWrite();
+  if (queued >= d.capacity)
+  {
+    pause(which);
+    errno = EAGAIN;
+    return -1;
+  }
+
+  ssize_t n = sockets::splice(sockfd, d.pipe->fds[1], d.capacity - queued);
+  if (n > 0)
+  {
+    d.bytes += n;
+    d.to->sendPipeInLoop(d.pipe->fds[0], static_cast<size_t>(n), d.pipe);
+  }
+  else if (n == 0)
+  {
+    LOG_DEBUG << d.from->name() << " half-closed after " << d.bytes << " bytes";
+    d.eof = true;
+    d.to->shutdown();
+    if (directions_[1 - which].eof)
+    {
+      closeAfterWriting(d.from);
+      closeAfterWriting(d.to);
+    }
+  }
+  else if (errno == EAGAIN && queued > 0)
+  {
+    // pages of the pipe are partly filled by small segments
+    pause(which);
+  }
+  return n;
+}
+
+void SpliceRelay::pause(int which)
+{
+  Direction& d = directions_[which];
+  d.from->stopRead();
+  d.to->setWriteCompleteCallback(
+      std::bind(&SpliceRelay::resumeWeak,
+                std::weak_ptr<SpliceRelay>(shared_from_this()), which, _1));
+}
+
+void SpliceRelay::resumeWeak(const std::weak_ptr<SpliceRelay>& wkRelay,
+                             int which,
+                             const TcpConnectionPtr& conn)
+{
+  // it is a copy being called
+  conn->setWriteCompleteCallback(WriteCompleteCallback());
+  SpliceRelayPtr relay = wkRelay.lock();
+  if (relay && !relay->directions_[which].eof)
+  {
+    relay->directions_[which].from->startRead();
+  }
+}
+
+void SpliceRelay::closeAfterWriting(const TcpConnectionPtr& conn)
+{
+  if (conn->bytesToWrite() == 0)
+  {
+    conn->forceClose();
+  }
+  else
+  {
+    conn->setWriteCompleteCallback(std::bind(&TcpConnection::forceClose, _1));
+  }
+}
@@ -0,0 +1,96 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SPLICERELAY_H
+#define MUDUO_NET_SPLICERELAY_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/TcpConnection.h"
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Relays bytes between two connections in the kernel, for proxies and tunnels.
+///
+/// Each direction has a pipe, the readable socket is splice(2)d into it,
+/// and the pipe is sent to the other connection by
+/// TcpConnection::sendPipeInLoop(), so the data are never copied to user
+/// space, and a hop costs no allocation or extra syscall.
+///
+/// A direction stops reading when the other side has a pipe full of bytes
+/// to write, and resumes on its write complete.  End of file of one side
+/// shuts down the other one after its pending bytes, the other direction
+/// goes on, both connections are closed when both sides have finished.
+///
+/// Both connections must be connected and of the same loop, start() in it.
+/// It takes over the socket read and write complete callbacks of both,
+/// data already in their input buffers are sent first.
+/// When one connection is closed by its peer, the owner closes the other,
+/// as it does for a relay of Buffers.
+///
+class SpliceRelay : noncopyable,
+                    public std::enable_shared_from_this<SpliceRelay>
+{
+ public:
+  static const size_t kDefaultPipeSize = 1024 * 1024;
+
+  SpliceRelay(const TcpConnectionPtr& first,
+              const TcpConnectionPtr& second,
+              size_t pipeSize = kDefaultPipeSize);
+
+  void start();
+
+  /// bytes spliced from first to second, and from second to first
+  int64_t firstToSecond() const { return directions_[0].bytes; }
+  int64_t secondToFirst() const { return directions_[1].bytes; }
+
+ private:
+  // closed when the relay and the bytes queued of it are gone
+  struct Pipe : noncopyable
+  {
+    Pipe() { fds[0] = fds[1] = -1; }
+    ~Pipe();
+
+    int fds[2];
+  };
+
+  struct Direction
+  {
+    TcpConnectionPtr from;
+    TcpConnectionPtr to;
+    std::shared_ptr<Pipe> pipe;
+    size_t capacity;
+    bool eof;
+    int64_t bytes;
+  };
+
+  ssize_t relay(int which, int sockfd);
+  void pause(int which);
+  static void closeAfterWriting(const TcpConnectionPtr& conn);
+
+  static ssize_t relayWeak(const std::weak_ptr<SpliceRelay>& wkRelay,
+                           int which, int sockfd);
+  static void resumeWeak(const std::weak_ptr<SpliceRelay>& wkRelay,
+                         int which,
+                         const TcpConnectionPtr& conn);
+
+  const size_t pipeSize_;
+  Direction directions_[2];
+};
+
+typedef std::shared_ptr<SpliceRelay> SpliceRelayPtr;
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SPLICERELAY_H
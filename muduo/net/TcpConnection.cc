@@ -9,6 +9,7 @@
 #include "muduo/net/TcpConnection.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/Metrics.h"
 #include "muduo/base/WeakCallback.h"
 #include "muduo/net/Channel.h"
 #include "muduo/net/EventLoop.h"
@@ -16,10 +17,27 @@
 #include "muduo/net/SocketsOps.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+metrics::Gauge g_connections("muduo_tcp_connections",
+                             "TcpConnection objects alive");
+metrics::Counter g_bytesReceived("muduo_tcp_bytes_received_total",
+                                 "Bytes read from all TcpConnections");
+metrics::Counter g_bytesSent("muduo_tcp_bytes_sent_total",
+                             "Bytes written to all TcpConnections");
+metrics::Counter g_highWaterMarks("muduo_tcp_high_water_mark_total",
+                                  "Times an output buffer crossed its high water mark");
+
+}  // namespace
+
 void muduo::net::defaultConnectionCallback(const TcpConnectionPtr& conn)
 {
   LOG_TRACE << conn->localAddress().toIpPort() << " -> "
@@ -44,12 +62,15 @@ TcpConnection::TcpConnection(EventLoop* loop,
     name_(nameArg),
     state_(kConnecting),
     reading_(true),
-    socket_(new Socket(sockfd)),
-    channel_(new Channel(loop, sockfd)),
+    pool_(loop->allocator()),
+    socket_(makePooled<Socket>(get_pointer(pool_), sockfd)),
+    channel_(makePooled<Channel>(get_pointer(pool_), loop, sockfd)),
     localAddr_(localAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024)
+    highWaterMark_(64*1024*1024),
+    fileBytes_(0)
 {
+  channel_->setName(name_.c_str());
   channel_->setReadCallback(
       std::bind(&TcpConnection::handleRead, this, _1));
   channel_->setWriteCallback(
@@ -61,6 +82,9 @@ TcpConnection::TcpConnection(EventLoop* loop,
   LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
             << " fd=" << sockfd;
   socket_->setKeepAlive(true);
+  // counted when assigned, so a burst of accepts sees it at once
+  loop_->addConnections(1);
+  g_connections.add(1);
 }
 
 TcpConnection::~TcpConnection()
@@ -69,6 +93,16 @@ TcpConnection::~TcpConnection()
             << " fd=" << channel_->fd()
             << " state=" << stateToString();
   assert(state_ == kDisconnected);
+  // here, as connectDestroyed() may never run, e.g. if the loop quits first
+  loop_->addConnections(-1);
+  g_connections.add(-1);
+  for (const FileSegment& seg : fileSegments_)
+  {
+    if (!seg.owner)
+    {
+      ::close(seg.fd);
+    }
+  }
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const
@@ -148,11 +182,12 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     return;
   }
   // if no thing in output queue, try writing directly
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && fileSegments_.empty())
   {
     nwrote = sockets::write(channel_->fd(), data, len);
     if (nwrote >= 0)
     {
+      g_bytesSent.add(nwrote);
       remaining = len - nwrote;
       if (remaining == 0 && writeCompleteCallback_)
       {
@@ -176,14 +211,29 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
   assert(remaining <= len);
   if (!faultError && remaining > 0)
   {
-    size_t oldLen = outputBuffer_.readableBytes();
+    size_t oldLen = bytesToWrite();
     if (oldLen + remaining >= highWaterMark_
         && oldLen < highWaterMark_
         && highWaterMarkCallback_)
     {
+      g_highWaterMarks.add();
       loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
     }
-    outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
+    if (fileSegments_.empty())
+    {
+      outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
+    }
+    else
+    {
+      // after the files
+      std::unique_ptr<Buffer>& followedBy = fileSegments_.back().followedBy;
+      if (!followedBy)
+      {
+        followedBy.reset(new Buffer);
+      }
+      followedBy->append(static_cast<const char*>(data)+nwrote, remaining);
+      fileBytes_ += remaining;
+    }
     if (!channel_->isWriting())
     {
       channel_->enableWriting();
@@ -191,6 +241,204 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
   }
 }
 
+void TcpConnection::sendFile(int fd, int64_t offset, size_t len)
+{
+  if (state_ == kConnected && len > 0)
+  {
+    int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupfd < 0)
+    {
+      LOG_SYSERR << "TcpConnection::sendFile";
+      return;
+    }
+    if (loop_->isInLoopThread())
+    {
+      sendFileInLoop(dupfd, offset, len);
+    }
+    else
+    {
+      loop_->runInLoop(
+          std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), dupfd, offset, len));
+    }
+  }
+}
+
+void TcpConnection::sendFileInLoop(int fd, int64_t offset, size_t len)
+{
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up sending file";
+    ::close(fd);
+    return;
+  }
+  struct stat st;
+  bool isPipe = ::fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+  size_t oldLen = bytesToWrite();
+  fileSegments_.push_back(FileSegment());
+  FileSegment& seg = fileSegments_.back();
+  seg.fd = fd;
+  seg.isPipe = isPipe;
+  seg.offset = offset;
+  seg.remaining = len;
+  fileBytes_ += len;
+  sendQueuedFileInLoop(oldLen);
+}
+
+void TcpConnection::sendPipeInLoop(int fd, size_t len, const std::shared_ptr<void>& owner)
+{
+  loop_->assertInLoopThread();
+  assert(owner);
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up sending pipe";
+    return;
+  }
+  size_t oldLen = bytesToWrite();
+  bool tried = false;
+  if (!channel_->isWriting() && oldLen == 0)
+  {
+    // if no thing in output queue, try writing directly,
+    // so nothing is queued while the peer keeps up
+    ssize_t n = sockets::splice(fd, channel_->fd(), len);
+    if (n > 0)
+    {
+      g_bytesSent.add(n);
+      len -= static_cast<size_t>(n);
+      if (len == 0)
+      {
+        if (writeCompleteCallback_)
+        {
+          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        return;
+      }
+      tried = true;
+    }
+    else
+    {
+      // errors are handled by the retry below
+      tried = n < 0 && errno == EWOULDBLOCK;
+    }
+  }
+  if (!fileSegments_.empty()
+      && fileSegments_.back().fd == fd
+      && fileSegments_.back().owner == owner
+      && !fileSegments_.back().followedBy)
+  {
+    // the same pipe, nothing queued after it
+    fileSegments_.back().remaining += len;
+  }
+  else
+  {
+    fileSegments_.push_back(FileSegment());
+    FileSegment& seg = fileSegments_.back();
+    seg.fd = fd;
+    seg.isPipe = true;
+    seg.offset = 0;
+    seg.remaining = len;
+    seg.owner = owner;
+  }
+  fileBytes_ += len;
+  if (tried)
+  {
+    startWritingInLoop(oldLen);
+  }
+  else
+  {
+    sendQueuedFileInLoop(oldLen);
+  }
+}
+
+// After a segment is queued, oldLen is bytesToWrite() before.
+void TcpConnection::sendQueuedFileInLoop(size_t oldLen)
+{
+  // if no thing in output queue, try writing directly
+  if (!channel_->isWriting() && oldLen == 0)
+  {
+    if (!writeFileSegment())
+    {
+      int savedErrno = errno;
+      if (savedErrno != EWOULDBLOCK)
+      {
+        LOG_SYSERR << "TcpConnection::sendQueuedFileInLoop";
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+          // faultError, as in sendInLoop()
+          return;
+        }
+        // of the file, the rest of it can never be sent
+        forceCloseInLoop();
+        return;
+      }
+    }
+    else if (bytesToWrite() == 0)
+    {
+      if (writeCompleteCallback_)
+      {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+      return;
+    }
+  }
+  startWritingInLoop(oldLen);
+}
+
+// Waits for the socket to be writable, for what is queued after oldLen bytes.
+void TcpConnection::startWritingInLoop(size_t oldLen)
+{
+  size_t newLen = bytesToWrite();
+  if (newLen >= highWaterMark_
+      && oldLen < highWaterMark_
+      && highWaterMarkCallback_)
+  {
+    g_highWaterMarks.add();
+    loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+  }
+  if (newLen > 0 && !channel_->isWriting())
+  {
+    channel_->enableWriting();
+  }
+}
+
+// Writes the first of fileSegments_, when outputBuffer_ is empty.
+// False on error, with errno, which is EIO if the file ends early.
+bool TcpConnection::writeFileSegment()
+{
+  assert(outputBuffer_.readableBytes() == 0);
+  FileSegment& seg = fileSegments_.front();
+  ssize_t n = seg.isPipe ? sockets::splice(seg.fd, channel_->fd(), seg.remaining)
+                         : sockets::sendfile(channel_->fd(), seg.fd, &seg.offset, seg.remaining);
+  if (n < 0)
+  {
+    return false;
+  }
+  if (n == 0)
+  {
+    LOG_ERROR << "TcpConnection::writeFileSegment [" << name_ << "] - "
+              << seg.remaining << " bytes short of file";
+    errno = EIO;
+    return false;
+  }
+  g_bytesSent.add(n);
+  seg.remaining -= n;
+  fileBytes_ -= n;
+  if (seg.remaining == 0)
+  {
+    if (!seg.owner)
+    {
+      ::close(seg.fd);
+    }
+    if (seg.followedBy)
+    {
+      fileBytes_ -= seg.followedBy->readableBytes();
+      outputBuffer_.swap(*seg.followedBy);
+    }
+    fileSegments_.pop_front();
+  }
+  return true;
+}
+
 void TcpConnection::shutdown()
 {
   // FIXME: use compare and swap
@@ -325,6 +573,15 @@ void TcpConnection::connectEstablished()
   loop_->assertInLoopThread();
   assert(state_ == kConnecting);
   setState(kConnected);
+  if (loop_->numaNode() >= 0)
+  {
+    // buffers were allocated in the acceptor thread,
+    // reallocate them here, so they are on the NUMA node of this loop.
+    inputBuffer_.shrink(0);
+    outputBuffer_.shrink(0);
+    // and so is this, the next slab is touched here before it is needed there
+    loop_->allocator()->reserve();
+  }
   channel_->tie(shared_from_this());
   channel_->enableReading();
 
@@ -347,10 +604,30 @@ void TcpConnection::connectDestroyed()
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
   loop_->assertInLoopThread();
+  if (socketReadCallback_)
+  {
+    ssize_t n = socketReadCallback_(shared_from_this(), channel_->fd());
+    if (n > 0)
+    {
+      g_bytesReceived.add(n);
+    }
+    else if (n == 0)
+    {
+      // half-closed, the callback closes us
+      stopReadInLoop();
+    }
+    else if (errno != EAGAIN)
+    {
+      LOG_SYSERR << "TcpConnection::handleRead";
+      handleError();
+    }
+    return;
+  }
   int savedErrno = 0;
   ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
   if (n > 0)
   {
+    g_bytesReceived.add(n);
     messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
   }
   else if (n == 0)
@@ -370,13 +647,32 @@ void TcpConnection::handleWrite()
   loop_->assertInLoopThread();
   if (channel_->isWriting())
   {
-    ssize_t n = sockets::write(channel_->fd(),
-                               outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());
+    ssize_t n = 0;
+    if (outputBuffer_.readableBytes() > 0)
+    {
+      n = sockets::write(channel_->fd(),
+                         outputBuffer_.peek(),
+                         outputBuffer_.readableBytes());
+      if (n > 0)
+      {
+        g_bytesSent.add(n);
+        outputBuffer_.retrieve(n);
+      }
+    }
+    else if (!fileSegments_.empty())
+    {
+      n = writeFileSegment() ? 1 : -1;
+      if (n < 0 && errno != EWOULDBLOCK && errno != EPIPE && errno != ECONNRESET)
+      {
+        LOG_SYSERR << "TcpConnection::handleWrite";
+        // of the file, the rest of it can never be sent
+        handleClose();
+        return;
+      }
+    }
     if (n > 0)
     {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0)
+      if (bytesToWrite() == 0)
       {
         channel_->disableWriting();
         if (writeCompleteCallback_)
@@ -12,12 +12,14 @@
 #define MUDUO_NET_TCPCONNECTION_H
 
 #include "muduo/base/noncopyable.h"
+#include "muduo/base/SlabAllocator.h"
 #include "muduo/base/StringPiece.h"
 #include "muduo/base/Types.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Buffer.h"
 #include "muduo/net/InetAddress.h"
 
+#include <deque>
 #include <memory>
 
 #include <boost/any.hpp>
@@ -67,6 +69,18 @@ class TcpConnection : noncopyable,
   void send(const StringPiece& message);
   // void send(Buffer&& message); // C++11
   void send(Buffer* message);  // this one will swap data
+  /// Sends len bytes of fd from offset after what have been sent, by sendfile(2),
+  /// the data don't go through user space.
+  /// fd is dup()ed, you may close yours when it returns.
+  /// If fd is a pipe, offset is ignored and len bytes must be in it,
+  /// they are moved by splice(2).
+  /// High water mark and write complete callbacks count these bytes too.
+  /// The connection is closed if fd ends before len bytes, or can't be read.
+  void sendFile(int fd, int64_t offset, size_t len);
+  /// Internal use only, for SpliceRelay, in loop thread.
+  /// Like sendFile() of len bytes in pipe fd, which is not dup()ed but kept
+  /// open by owner until they are sent, consecutive ones share a segment.
+  void sendPipeInLoop(int fd, size_t len, const std::shared_ptr<void>& owner);
   void shutdown(); // NOT thread safe, no simultaneous calling
   // void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
   void forceClose();
@@ -98,6 +112,16 @@ class TcpConnection : noncopyable,
   void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
   { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
 
+  /// Advanced interface, see SpliceRelay.
+  /// If set, cb reads the socket when it is readable, nothing is read to
+  /// inputBuffer() and the message callback is not called.
+  /// cb returns bytes read, or -1 with errno, EAGAIN if it read nothing.
+  /// When it returns 0 for end of file, reading stops and the connection
+  /// stays up for writing, cb shall shutdown() or forceClose() it later.
+  /// In loop thread.
+  void setSocketReadCallback(const SocketReadCallback& cb)
+  { socketReadCallback_ = cb; }
+
   /// Advanced interface
   Buffer* inputBuffer()
   { return &inputBuffer_; }
@@ -105,6 +129,11 @@ class TcpConnection : noncopyable,
   Buffer* outputBuffer()
   { return &outputBuffer_; }
 
+  /// Bytes not written to the socket yet, of outputBuffer() and sendFile().
+  /// In loop thread.
+  size_t bytesToWrite() const
+  { return outputBuffer_.readableBytes() + fileBytes_; }
+
   /// Internal use only.
   void setCloseCallback(const CloseCallback& cb)
   { closeCallback_ = cb; }
@@ -123,6 +152,10 @@ class TcpConnection : noncopyable,
   // void sendInLoop(string&& message);
   void sendInLoop(const StringPiece& message);
   void sendInLoop(const void* message, size_t len);
+  void sendFileInLoop(int fd, int64_t offset, size_t len);
+  void sendQueuedFileInLoop(size_t oldLen);
+  void startWritingInLoop(size_t oldLen);
+  bool writeFileSegment();
   void shutdownInLoop();
   // void shutdownAndForceCloseInLoop(double seconds);
   void forceCloseInLoop();
@@ -135,19 +168,35 @@ class TcpConnection : noncopyable,
   const string name_;
   StateE state_;  // FIXME: use atomic variable
   bool reading_;
+  // outlives socket_ and channel_
+  std::shared_ptr<SlabAllocator> pool_;
   // we don't expose those classes to client.
-  std::unique_ptr<Socket> socket_;
-  std::unique_ptr<Channel> channel_;
+  PooledPtr<Socket> socket_;
+  PooledPtr<Channel> channel_;
   const InetAddress localAddr_;
   const InetAddress peerAddr_;
   ConnectionCallback connectionCallback_;
   MessageCallback messageCallback_;
+  SocketReadCallback socketReadCallback_;
   WriteCompleteCallback writeCompleteCallback_;
   HighWaterMarkCallback highWaterMarkCallback_;
   CloseCallback closeCallback_;
   size_t highWaterMark_;
   Buffer inputBuffer_;
   Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+  // queued by sendFile(), after outputBuffer_
+  struct FileSegment
+  {
+    int fd;  // dup()ed, closed when done, unless owner is set
+    bool isPipe;
+    int64_t offset;
+    size_t remaining;
+    std::shared_ptr<void> owner;  // keeps fd open, of sendPipeInLoop()
+    // sent after this segment, becomes outputBuffer_, allocated on first send()
+    std::unique_ptr<Buffer> followedBy;
+  };
+  std::deque<FileSegment> fileSegments_;
+  size_t fileBytes_;  // of fileSegments_, including followedBy
   boost::any context_;
   // FIXME: creationTime_, lastReceiveTime_
   //        bytesReceived_, bytesSent_
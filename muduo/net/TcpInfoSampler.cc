@@ -0,0 +1,191 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/TcpInfoSampler.h"
+
+#include "muduo/base/Metrics.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <algorithm>
+
+#include <netinet/tcp.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+metrics::Histogram& g_rtt = *new metrics::Histogram(
+    "muduo_tcp_rtt_us", "Smoothed RTT of sampled connections");
+metrics::Histogram& g_cwnd = *new metrics::Histogram(
+    "muduo_tcp_cwnd_segments", "Congestion window of sampled connections");
+metrics::Histogram& g_unacked = *new metrics::Histogram(
+    "muduo_tcp_unacked_segments", "Segments in flight of sampled connections");
+metrics::Histogram& g_outputBytes = *new metrics::Histogram(
+    "muduo_tcp_output_buffer_bytes", "Output buffer of sampled connections");
+metrics::Counter g_slowPeers("muduo_tcp_slow_peers_total", "Samples found a slow peer");
+
+MutexLock g_samplersMutex;
+std::vector<const TcpInfoSampler*> g_samplers GUARDED_BY(g_samplersMutex);
+
+template<typename T>
+void appendPercentiles(string* out, const char* name, std::vector<T>* values)
+{
+  char buf[256];
+  if (values->empty())
+  {
+    return;
+  }
+  size_t n = values->size();
+  std::sort(values->begin(), values->end());
+  snprintf(buf, sizeof buf, "  %-14s p50=%llu p90=%llu p99=%llu max=%llu\n", name,
+           static_cast<unsigned long long>((*values)[n * 50 / 100]),
+           static_cast<unsigned long long>((*values)[n * 90 / 100]),
+           static_cast<unsigned long long>((*values)[n * 99 / 100]),
+           static_cast<unsigned long long>(values->back()));
+  *out += buf;
+}
+
+}  // namespace
+
+TcpInfoSampler::TcpInfoSampler(const string& name,
+                               size_t slowPeerBytes,
+                               const SlowPeerCallback& cb)
+  : name_(name),
+    slowPeerBytes_(slowPeerBytes),
+    slowPeerCallback_(cb)
+{
+  MutexLockGuard lock(g_samplersMutex);
+  g_samplers.push_back(this);
+}
+
+TcpInfoSampler::~TcpInfoSampler()
+{
+  MutexLockGuard lock(g_samplersMutex);
+  g_samplers.erase(std::remove(g_samplers.begin(), g_samplers.end(), this), g_samplers.end());
+}
+
+void TcpInfoSampler::sample(EventLoop* loop, const std::vector<TcpConnectionPtr>& conns)
+{
+  loop->assertInLoopThread();
+  LoopState state;
+  {
+  MutexLockGuard lock(mutex_);
+  state.lastOutputBytes.swap(loops_[loop].lastOutputBytes);
+  }
+
+  std::map<string, size_t> lastOutputBytes;
+  std::vector<std::pair<TcpConnectionPtr, TcpInfoSample>> slowPeers;
+  state.samples.reserve(conns.size());
+  for (const TcpConnectionPtr& conn : conns)
+  {
+    struct tcp_info tcpi;
+    if (!conn->connected() || !conn->getTcpInfo(&tcpi))
+    {
+      continue;
+    }
+    TcpInfoSample s;
+    s.rttUs = tcpi.tcpi_rtt;
+    s.rttVarUs = tcpi.tcpi_rttvar;
+    s.cwnd = tcpi.tcpi_snd_cwnd;
+    s.unacked = tcpi.tcpi_unacked;
+    s.retransmits = tcpi.tcpi_total_retrans;
+    s.outputBytes = conn->bytesToWrite();
+    state.samples.push_back(s);
+    g_rtt.record(s.rttUs);
+    g_cwnd.record(s.cwnd);
+    g_unacked.record(s.unacked);
+    g_outputBytes.record(static_cast<int64_t>(s.outputBytes));
+
+    lastOutputBytes[conn->name()] = s.outputBytes;
+    if (slowPeerBytes_ > 0 && s.outputBytes >= slowPeerBytes_)
+    {
+      auto it = state.lastOutputBytes.find(conn->name());
+      if (it != state.lastOutputBytes.end() && s.outputBytes >= it->second)
+      {
+        slowPeers.push_back(std::make_pair(conn, s));
+      }
+    }
+  }
+
+  for (const auto& peer : slowPeers)
+  {
+    SlowPeer slow = { peer.first->name(), peer.first->peerAddress().toIpPort(), peer.second };
+    state.slowPeers.push_back(std::move(slow));
+  }
+  g_slowPeers.add(static_cast<int64_t>(slowPeers.size()));
+  state.lastOutputBytes.swap(lastOutputBytes);
+  {
+  MutexLockGuard lock(mutex_);
+  loops_[loop] = std::move(state);
+  }
+
+  // may shed or close them
+  if (slowPeerCallback_)
+  {
+    for (const auto& peer : slowPeers)
+    {
+      slowPeerCallback_(peer.first, peer.second);
+    }
+  }
+}
+
+string TcpInfoSampler::report() const
+{
+  std::vector<uint32_t> rtt, cwnd, unacked, retransmits;
+  std::vector<size_t> outputBytes;
+  std::vector<SlowPeer> slowPeers;
+  {
+  MutexLockGuard lock(mutex_);
+  for (const auto& loop : loops_)
+  {
+    for (const TcpInfoSample& s : loop.second.samples)
+    {
+      rtt.push_back(s.rttUs);
+      cwnd.push_back(s.cwnd);
+      unacked.push_back(s.unacked);
+      retransmits.push_back(s.retransmits);
+      outputBytes.push_back(s.outputBytes);
+    }
+    slowPeers.insert(slowPeers.end(),
+                     loop.second.slowPeers.begin(), loop.second.slowPeers.end());
+  }
+  }
+
+  char buf[256];
+  snprintf(buf, sizeof buf, "%s: %zu connections sampled, %zu slow peers\n",
+           name_.c_str(), rtt.size(), slowPeers.size());
+  string result(buf);
+  appendPercentiles(&result, "rtt_us", &rtt);
+  appendPercentiles(&result, "cwnd", &cwnd);
+  appendPercentiles(&result, "unacked", &unacked);
+  appendPercentiles(&result, "retransmits", &retransmits);
+  appendPercentiles(&result, "output_bytes", &outputBytes);
+  for (const SlowPeer& peer : slowPeers)
+  {
+    snprintf(buf, sizeof buf, "  slow %s %s rtt=%uus cwnd=%u unacked=%u output=%zu\n",
+             peer.name.c_str(), peer.peer.c_str(), peer.sample.rttUs,
+             peer.sample.cwnd, peer.sample.unacked, peer.sample.outputBytes);
+    result += buf;
+  }
+  return result;
+}
+
+string TcpInfoSampler::reportAll()
+{
+  string result;
+  MutexLockGuard lock(g_samplersMutex);
+  for (const TcpInfoSampler* sampler : g_samplers)
+  {
+    result += sampler->report();
+  }
+  return result;
+}
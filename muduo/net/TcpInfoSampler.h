@@ -0,0 +1,90 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_NET_TCPINFOSAMPLER_H
+#define MUDUO_NET_TCPINFOSAMPLER_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/net/Callbacks.h"
+
+#include <map>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+///
+/// TCP_INFO and output buffer of a connection, taken in its loop.
+///
+struct TcpInfoSample
+{
+  uint32_t rttUs;
+  uint32_t rttVarUs;
+  uint32_t cwnd;         // segments
+  uint32_t unacked;      // segments in flight
+  uint32_t retransmits;  // in the lifetime of the connection
+  size_t outputBytes;    // TcpConnection::bytesToWrite()
+};
+
+///
+/// Samples connections of a TcpServer, see TcpServer::setTcpInfoSampling().
+///
+/// A peer is slow when its output buffer holds at least slowPeerBytes and
+/// has not shrunk since the last sample, i.e. it does not keep up with us.
+/// Percentiles of the last round and slow peers of all servers are served
+/// by Inspector at /tcp/info.
+///
+class TcpInfoSampler : noncopyable
+{
+ public:
+  typedef std::function<void (const TcpConnectionPtr&,
+                              const TcpInfoSample&)> SlowPeerCallback;
+
+  TcpInfoSampler(const string& name, size_t slowPeerBytes, const SlowPeerCallback& cb);
+  ~TcpInfoSampler();
+
+  /// Samples conns of loop in a batch, must be called in loop.
+  void sample(EventLoop* loop, const std::vector<TcpConnectionPtr>& conns);
+
+  string report() const;
+
+  /// all TcpInfoSamplers in the process
+  static string reportAll();
+
+ private:
+  struct SlowPeer
+  {
+    string name;
+    string peer;
+    TcpInfoSample sample;
+  };
+
+  struct LoopState
+  {
+    std::vector<TcpInfoSample> samples;
+    std::vector<SlowPeer> slowPeers;
+    // by name, a new connection may reuse the address of a destroyed one
+    std::map<string, size_t> lastOutputBytes;
+  };
+
+  const string name_;
+  const size_t slowPeerBytes_;
+  const SlowPeerCallback slowPeerCallback_;
+
+  mutable MutexLock mutex_;
+  std::map<EventLoop*, LoopState> loops_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TCPINFOSAMPLER_H
@@ -9,6 +9,7 @@
 #include "muduo/net/TcpServer.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/Metrics.h"
 #include "muduo/net/Acceptor.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThreadPool.h"
@@ -30,7 +31,9 @@ TcpServer::TcpServer(EventLoop* loop,
     threadPool_(new EventLoopThreadPool(loop, name_)), // 初始化线程池
     connectionCallback_(defaultConnectionCallback), // 设置连接回调
     messageCallback_(defaultMessageCallback), // 设置消息回调
-    nextConnId_(1) // 用整数来管理连接，方便知道连接建立了多少次
+    incomingCpuSteering_(false),
+    nextConnId_(1), // 用整数来管理连接，方便知道连接建立了多少次
+    tcpInfoInterval_(0)
 {
   // acceptor在readable的时候会回调newConnection函数
   acceptor_->setNewConnectionCallback(
@@ -42,6 +45,10 @@ TcpServer::~TcpServer()
   // 在IO线程中发生析构
   loop_->assertInLoopThread();
   LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
+  if (tcpInfoSampler_)
+  {
+    loop_->cancel(tcpInfoTimer_);
+  }
 // 遍历所有的连接，然后在conn所在的线程中执行connectDestroyed，防止data race
   for (auto& item : connections_)
   {
@@ -52,6 +59,11 @@ TcpServer::~TcpServer()
   }
 }
 
+InetAddress TcpServer::listenAddress() const
+{
+  return acceptor_->listenAddress();
+}
+
 // 设置线程数量
 void TcpServer::setThreadNum(int numThreads)
 {
@@ -70,14 +82,30 @@ void TcpServer::start()
     // 在loop中监听网络连接
     loop_->runInLoop(
         std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+    if (tcpInfoSampler_)
+    {
+      tcpInfoTimer_ = loop_->runEvery(tcpInfoInterval_,
+                                      std::bind(&TcpServer::sampleTcpInfo, this));
+    }
   }
 }
 
 // 这个函数在Acceptor中获得新连接的文件描述符和地址后被回调到
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
+  static metrics::Counter accepted("muduo_tcp_connections_accepted_total",
+                                   "Connections accepted by all TcpServers");
   loop_->assertInLoopThread(); // 所以它是在loop_中执行的
-  EventLoop* ioLoop = threadPool_->getNextLoop(); // 给新来的分配个好去处
+  accepted.add();
+  EventLoop* ioLoop = NULL;
+  if (incomingCpuSteering_)
+  {
+    ioLoop = threadPool_->getLoopForCpu(sockets::getIncomingCpu(sockfd));
+  }
+  if (ioLoop == NULL)
+  {
+    ioLoop = threadPool_->getNextLoop(); // 给新来的分配个好去处
+  }
   char buf[64];
   // 以服务名，IP，端口号，ID的方式命名
   snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
@@ -89,13 +117,15 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
            << "] from " << peerAddr.toIpPort();
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
   // FIXME poll with zero timeout to double confirm the new connection
-  // FIXME use make_shared if necessary
   // 创建代表新连接的对象，传入一个ioLoop来负责处理这个连接的IO事件
-  TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                          connName, // 这个是用来命名的
-                                          sockfd, // 连接对应的套接字描述符
-                                          localAddr, // 本端地址
-                                          peerAddr)); // 对端地址
+  // 连接和它的控制块一起分配在ioLoop的内存池中
+  TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(
+      PoolAllocator<TcpConnection>(ioLoop->allocator()),
+      ioLoop,
+      connName, // 这个是用来命名的
+      sockfd, // 连接对应的套接字描述符
+      localAddr, // 本端地址
+      peerAddr); // 对端地址
   // 连接管理
   connections_[connName] = conn;
   // 设置连接回调
@@ -134,3 +164,30 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
       std::bind(&TcpConnection::connectDestroyed, conn));
 }
 
+
+void TcpServer::setTcpInfoSampling(double interval,
+                                   size_t slowPeerBytes,
+                                   const SlowPeerCallback& cb)
+{
+  assert(interval > 0);
+  tcpInfoInterval_ = interval;
+  tcpInfoSampler_.reset(new TcpInfoSampler(name_, slowPeerBytes, cb));
+}
+
+// getsockopt(TCP_INFO) and outputBuffer_ belong to the loop of a connection,
+// send each loop its connections in one functor.
+void TcpServer::sampleTcpInfo()
+{
+  loop_->assertInLoopThread();
+  std::map<EventLoop*, std::vector<TcpConnectionPtr>> connsOfLoop;
+  for (const auto& item : connections_)
+  {
+    connsOfLoop[item.second->getLoop()].push_back(item.second);
+  }
+  for (auto& item : connsOfLoop)
+  {
+    EventLoop* ioLoop = item.first;
+    ioLoop->runInLoop(std::bind(&TcpInfoSampler::sample, tcpInfoSampler_,
+                                ioLoop, std::move(item.second)));
+  }
+}
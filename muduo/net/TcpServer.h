@@ -14,6 +14,8 @@
 #include "muduo/base/Atomic.h"
 #include "muduo/base/Types.h"
 #include "muduo/net/TcpConnection.h"
+#include "muduo/net/TcpInfoSampler.h"
+#include "muduo/net/TimerId.h"
 
 #include <map>
 
@@ -36,6 +38,7 @@ class TcpServer : noncopyable
  public:
  // 事件循环启动时回调的函数
   typedef std::function<void(EventLoop*)> ThreadInitCallback;
+  typedef TcpInfoSampler::SlowPeerCallback SlowPeerCallback;
   // 端口重用选项
   enum Option
   {
@@ -51,6 +54,8 @@ class TcpServer : noncopyable
   ~TcpServer();  // force out-line dtor, for std::unique_ptr members.
 
   const string& ipPort() const { return ipPort_; }
+  /// Unlike ipPort(), has the real port if listenAddr had port 0.
+  InetAddress listenAddress() const;
   const string& name() const { return name_; }
   EventLoop* getLoop() const { return loop_; }
 
@@ -63,7 +68,8 @@ class TcpServer : noncopyable
   ///   this is the default value.
   /// - 1 means all I/O in another thread.
   /// - N means a thread pool with N threads, new connections
-  ///   are assigned on a round-robin basis.
+  ///   are assigned on a round-robin basis, or by
+  ///   threadPool()->setPlacement().
   // 设置IO线程池中线程数量
   void setThreadNum(int numThreads);
   void setThreadInitCallback(const ThreadInitCallback& cb)
@@ -73,6 +79,23 @@ class TcpServer : noncopyable
   std::shared_ptr<EventLoopThreadPool> threadPool()
   { return threadPool_; }
 
+  /// Assigns a new connection to the loop pinned to the CPU which handled its
+  /// packets (SO_INCOMING_CPU), round-robin if there is none.
+  /// Pin loops with threadPool()->setCpuAffinity() to the CPUs of NIC RX queues,
+  /// a connection is then served on the CPU of its RX queue.
+  /// Must be called before @c start
+  void setIncomingCpuSteering(bool on)
+  { incomingCpuSteering_ = on; }
+
+  /// Samples TCP_INFO and output buffer of all connections every interval
+  /// seconds, in a batch per loop. A peer which keeps slowPeerBytes or more
+  /// in its output buffer is passed to cb, in its loop, to shed or close it.
+  /// 0 slowPeerBytes disables slow peer detection. See /tcp/info of Inspector.
+  /// Must be called before @c start
+  void setTcpInfoSampling(double interval,
+                          size_t slowPeerBytes,
+                          const SlowPeerCallback& cb = SlowPeerCallback());
+
   /// Starts the server if it's not listenning.
   ///
   /// It's harmless to call it multiple times.
@@ -108,6 +131,8 @@ class TcpServer : noncopyable
   /// Not thread safe, but in loop
   // 在IO线程中删除连接
   void removeConnectionInLoop(const TcpConnectionPtr& conn);
+  /// Not thread safe, but in loop
+  void sampleTcpInfo();
 
 // 连接管理
   typedef std::map<string, TcpConnectionPtr> ConnectionMap;
@@ -122,9 +147,13 @@ class TcpServer : noncopyable
   WriteCompleteCallback writeCompleteCallback_;
   ThreadInitCallback threadInitCallback_;
   AtomicInt32 started_;
+  bool incomingCpuSteering_;
   // always in loop thread
   int nextConnId_;
   ConnectionMap connections_;
+  double tcpInfoInterval_;
+  std::shared_ptr<TcpInfoSampler> tcpInfoSampler_;  // shared with loops sampling
+  TimerId tcpInfoTimer_;
 };
 
 }  // namespace net
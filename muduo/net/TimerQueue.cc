@@ -13,6 +13,7 @@
 #include "muduo/net/TimerQueue.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/Metrics.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/Timer.h"
 #include "muduo/net/TimerId.h"
@@ -56,6 +57,11 @@ struct timespec howMuchTimeFromNow(Timestamp when)
   return ts;
 }
 
+metrics::Gauge g_timers("muduo_timers", "Timers pending in all TimerQueues");
+metrics::Counter g_timersFired("muduo_timers_fired_total", "Timer callbacks run");
+metrics::Histogram& g_timerLateness = *new metrics::Histogram(
+    "muduo_timer_lateness_us", "Microseconds a timer ran after its expiration");
+
 // 读timerfd
 void readTimerfd(int timerfd, Timestamp now)
 {
@@ -102,6 +108,7 @@ TimerQueue::TimerQueue(EventLoop* loop)
     callingExpiredTimers_(false) // 标志位
 {
   // 设置触发定时器时分派IO事件要执行的函数
+  timerfdChannel_.setName("TimerQueue");
   timerfdChannel_.setReadCallback(
       std::bind(&TimerQueue::handleRead, this));
   // we are always reading the timerfd, we disarm it with timerfd_settime.
@@ -124,6 +131,7 @@ TimerQueue::~TimerQueue()
   {
     delete timer.second;
   }
+  g_timers.add(-static_cast<int64_t>(timers_.size()));
 }
 
 // 添加定时任务
@@ -176,6 +184,7 @@ void TimerQueue::cancelInLoop(TimerId timerId)
     assert(n == 1); (void)n;
     delete it->first; // FIXME: no delete please
     activeTimers_.erase(it);
+    g_timers.add(-1);
   }
   else if (callingExpiredTimers_) // 否则如果正在调用到期的定时任务，就先把timer塞到cancelingTimers里面
   {
@@ -200,8 +209,11 @@ void TimerQueue::handleRead()
   // 挨个调用定时任务中的回调
   for (const Entry& it : expired)
   {
+    g_timerLateness.record(now.microSecondsSinceEpoch()
+                           - it.first.microSecondsSinceEpoch());
     it.second->run();
   }
+  g_timersFired.add(static_cast<int64_t>(expired.size()));
   // 处理完毕，改回去
   callingExpiredTimers_ = false;
   // 重置定时任务，主要是把周期性的任务再更新下放回队列
@@ -219,6 +231,7 @@ std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
   assert(end == timers_.end() || now < end->first);
   std::copy(timers_.begin(), end, back_inserter(expired));
   timers_.erase(timers_.begin(), end);
+  g_timers.add(-static_cast<int64_t>(expired.size()));
   // 然后再从activeTimers中删掉，始终保持timers_.size() == activeTimers_.size()的断言不变
   for (const Entry& it : expired)
   {
@@ -288,6 +301,7 @@ bool TimerQueue::insert(Timer* timer)
       = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
     assert(result.second); (void)result;
   }
+  g_timers.add(1);
 // 断言必须仍然保持
   assert(timers_.size() == activeTimers_.size());
   return earliestChanged;
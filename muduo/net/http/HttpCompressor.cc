@@ -0,0 +1,252 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/HttpCompressor.h"
+
+#include "muduo/base/Logging.h"
+
+#include <algorithm>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <strings.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// windowBits of deflateInit2(), add 16 for gzip header and trailer.
+const int kWindowBits = 15;
+const int kMemLevel = 8;
+
+StringPiece trim(const char* begin, const char* end)
+{
+  while (begin < end && isspace(*begin))
+    ++begin;
+  while (begin < end && isspace(end[-1]))
+    --end;
+  return StringPiece(begin, static_cast<int>(end - begin));
+}
+
+// "gzip;q=0.5" => q is 0.5, return 1.0 if q is absent.
+double qvalue(StringPiece params)
+{
+  double q = 1.0;
+  const char* p = params.data();
+  const char* end = params.end();
+  while (p < end)
+  {
+    const char* semicolon = std::find(p, end, ';');
+    StringPiece param = trim(p, semicolon);
+    if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+    {
+      string value(param.data() + 2, param.size() - 2);
+      q = strtod(value.c_str(), NULL);
+    }
+    p = semicolon == end ? end : semicolon + 1;
+  }
+  return q;
+}
+
+bool equalsIgnoreCase(StringPiece lhs, const char* rhs)
+{
+  size_t len = strlen(rhs);
+  return static_cast<size_t>(lhs.size()) == len
+    && ::strncasecmp(lhs.data(), rhs, len) == 0;
+}
+
+}  // namespace
+
+HttpCompressor::HttpCompressor(int level)
+  : level_(level)
+{
+  for (int i = 0; i < kNumEncodings; ++i)
+  {
+    initialized_[i] = false;
+    memZero(&streams_[i], sizeof streams_[i]);
+  }
+}
+
+HttpCompressor::~HttpCompressor()
+{
+  for (int i = 0; i < kNumEncodings; ++i)
+  {
+    if (initialized_[i])
+    {
+      ::deflateEnd(&streams_[i]);
+    }
+  }
+}
+
+bool HttpCompressor::compress(Encoding encoding, StringPiece input, string* output)
+{
+  assert(encoding == kGzip || encoding == kDeflate);
+  const int idx = encoding - 1;
+  z_stream* zs = &streams_[idx];
+  if (initialized_[idx])
+  {
+    ::deflateReset(zs);
+  }
+  else
+  {
+    int windowBits = encoding == kGzip ? kWindowBits + 16 : kWindowBits;
+    int err = deflateInit2(zs, level_, Z_DEFLATED, windowBits, kMemLevel, Z_DEFAULT_STRATEGY);
+    if (err != Z_OK)
+    {
+      LOG_ERROR << "HttpCompressor::compress - deflateInit2 " << err;
+      return false;
+    }
+    initialized_[idx] = true;
+  }
+
+  // deflateBound() is large enough to finish in one call
+  output->resize(::deflateBound(zs, static_cast<uLong>(input.size())));
+  void* in = const_cast<char*>(input.data());
+  zs->next_in = static_cast<Bytef*>(in);
+  zs->avail_in = static_cast<uInt>(input.size());
+  zs->next_out = reinterpret_cast<Bytef*>(&*output->begin());
+  zs->avail_out = static_cast<uInt>(output->size());
+  int err = ::deflate(zs, Z_FINISH);
+  zs->next_in = NULL;
+  zs->next_out = NULL;
+  if (err != Z_STREAM_END)
+  {
+    LOG_ERROR << "HttpCompressor::compress - deflate " << err;
+    output->clear();
+    return false;
+  }
+  output->resize(zs->total_out);
+  return true;
+}
+
+HttpCompressor::Encoding HttpCompressor::negotiate(const string& acceptEncoding)
+{
+  // -1.0 means not listed
+  double gzipQ = -1.0;
+  double deflateQ = -1.0;
+  double anyQ = 0.0;
+  const char* p = acceptEncoding.data();
+  const char* end = p + acceptEncoding.size();
+  while (p < end)
+  {
+    const char* comma = std::find(p, end, ',');
+    const char* semicolon = std::find(p, comma, ';');
+    StringPiece coding = trim(p, semicolon);
+    double q = qvalue(StringPiece(semicolon, static_cast<int>(comma - semicolon)));
+    if (equalsIgnoreCase(coding, "gzip") || equalsIgnoreCase(coding, "x-gzip"))
+    {
+      gzipQ = q;
+    }
+    else if (equalsIgnoreCase(coding, "deflate"))
+    {
+      deflateQ = q;
+    }
+    else if (coding == "*")
+    {
+      anyQ = q;
+    }
+    p = comma == end ? end : comma + 1;
+  }
+
+  if (gzipQ < 0.0)
+  {
+    gzipQ = anyQ;
+  }
+  if (deflateQ < 0.0)
+  {
+    deflateQ = anyQ;
+  }
+
+  if (gzipQ > 0.0 && gzipQ >= deflateQ)
+  {
+    return kGzip;
+  }
+  else if (deflateQ > 0.0)
+  {
+    return kDeflate;
+  }
+  return kIdentity;
+}
+
+const char* HttpCompressor::encodingToString(Encoding encoding)
+{
+  switch (encoding)
+  {
+    case kGzip:
+      return "gzip";
+    case kDeflate:
+      return "deflate";
+    default:
+      return "identity";
+  }
+}
+
+HttpCompressionCache::BodyPtr HttpCompressionCache::get(const string& key,
+                                                        HttpCompressor::Encoding encoding,
+                                                        const HttpStaticBody& body)
+{
+  BodyPtr result;
+  MutexLockGuard lock(mutex_);
+  std::map<string, Entry>::iterator it = entries_.find(key);
+  if (it != entries_.end()
+      && it->second.generation == body.generation())
+  {
+    lru_.splice(lru_.end(), lru_, it->second.lru);
+    result = encoding == HttpCompressor::kGzip ? it->second.gzip : it->second.deflate;
+  }
+  return result;
+}
+
+void HttpCompressionCache::put(const string& key,
+                               HttpCompressor::Encoding encoding,
+                               const HttpStaticBody& body,
+                               const BodyPtr& compressed)
+{
+  MutexLockGuard lock(mutex_);
+  std::map<string, Entry>::iterator it = entries_.find(key);
+  if (it == entries_.end())
+  {
+    if (entries_.size() >= maxEntries_ && !lru_.empty())
+    {
+      entries_.erase(lru_.front());
+      lru_.pop_front();
+    }
+    it = entries_.insert(std::make_pair(key, Entry())).first;
+    it->second.generation = 0;
+    it->second.lru = lru_.insert(lru_.end(), key);
+  }
+  else
+  {
+    lru_.splice(lru_.end(), lru_, it->second.lru);
+  }
+
+  Entry& entry = it->second;
+  if (entry.generation != body.generation())
+  {
+    entry.generation = body.generation();
+    entry.gzip.reset();
+    entry.deflate.reset();
+  }
+  if (encoding == HttpCompressor::kGzip)
+  {
+    entry.gzip = compressed;
+  }
+  else
+  {
+    entry.deflate = compressed;
+  }
+}
+
+size_t HttpCompressionCache::size() const
+{
+  MutexLockGuard lock(mutex_);
+  return entries_.size();
+}
@@ -0,0 +1,110 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_HTTP_HTTPCOMPRESSOR_H
+#define MUDUO_NET_HTTP_HTTPCOMPRESSOR_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <list>
+#include <map>
+#include <memory>
+
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#include <zlib.h>
+
+namespace muduo
+{
+namespace net
+{
+
+/// Compresses HTTP response bodies with gzip or deflate.
+///
+/// The z_streams are initialized once and deflateReset() for every body,
+/// so keep one instance per I/O thread. Not thread safe.
+class HttpCompressor : noncopyable
+{
+ public:
+  enum Encoding
+  {
+    kIdentity,
+    kGzip,
+    kDeflate,
+  };
+
+  explicit HttpCompressor(int level = Z_DEFAULT_COMPRESSION);
+  ~HttpCompressor();
+
+  // output is replaced with compressed data, return false if any error
+  bool compress(Encoding encoding, StringPiece input, string* output);
+
+  // pick an encoding from the value of Accept-Encoding header,
+  // prefers gzip over deflate, honors q=0.
+  static Encoding negotiate(const string& acceptEncoding);
+  static const char* encodingToString(Encoding encoding);
+
+ private:
+  static const int kNumEncodings = kDeflate;
+
+  const int level_;
+  bool initialized_[kNumEncodings];
+  z_stream streams_[kNumEncodings];
+};
+
+/// Compressed bodies of static responses, shared by all I/O threads.
+///
+/// An entry is checked against the generation of the static body,
+/// so a stale entry is simply replaced.  When full, the least recently
+/// used entry is evicted.
+class HttpCompressionCache : noncopyable
+{
+ public:
+  typedef std::shared_ptr<const string> BodyPtr;
+
+  explicit HttpCompressionCache(size_t maxEntries = 1024)
+    : maxEntries_(maxEntries)
+  {
+  }
+
+  // return NULL if not cached
+  BodyPtr get(const string& key,
+              HttpCompressor::Encoding encoding,
+              const HttpStaticBody& body);
+
+  void put(const string& key,
+           HttpCompressor::Encoding encoding,
+           const HttpStaticBody& body,
+           const BodyPtr& compressed);
+
+  size_t size() const;
+
+ private:
+  struct Entry
+  {
+    uint64_t generation;
+    BodyPtr gzip;
+    BodyPtr deflate;
+    std::list<string>::iterator lru;
+  };
+
+  const size_t maxEntries_;
+  mutable MutexLock mutex_;
+  std::map<string, Entry> entries_ GUARDED_BY(mutex_);
+  // keys, the least recently used first
+  std::list<string> lru_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPCOMPRESSOR_H
@@ -10,11 +10,24 @@
 #include "muduo/net/http/HttpResponse.h"
 #include "muduo/net/Buffer.h"
 
+#include <atomic>
+
 #include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+std::atomic<uint64_t> g_generation(0);
+}
+
+HttpStaticBody::HttpStaticBody(const string& data)
+  : data_(data),
+    generation_(++g_generation)
+{
+}
+
 void HttpResponse::appendToBuffer(Buffer* output) const
 {
   char buf[32];
@@ -29,7 +42,7 @@ void HttpResponse::appendToBuffer(Buffer* output) const
   }
   else
   {
-    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
+    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body().size());
     output->append(buf);
     output->append("Connection: Keep-Alive\r\n");
   }
@@ -43,5 +56,5 @@ void HttpResponse::appendToBuffer(Buffer* output) const
   }
 
   output->append("\r\n");
-  output->append(body_);
+  output->append(body());
 }
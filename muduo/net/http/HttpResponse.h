@@ -12,9 +12,13 @@
 #define MUDUO_NET_HTTP_HTTPRESPONSE_H
 
 #include "muduo/base/copyable.h"
+#include "muduo/base/noncopyable.h"
 #include "muduo/base/Types.h"
 
 #include <map>
+#include <memory>
+
+#include <stdint.h>
 
 namespace muduo
 {
@@ -22,6 +26,25 @@ namespace net
 {
 
 class Buffer;
+
+/// A body that seldom changes, shared by the responses of a path.
+/// Each one has a distinct generation, HttpServer checks cached compressed
+/// forms by it.  Make a new one to change the content.
+class HttpStaticBody : noncopyable
+{
+ public:
+  explicit HttpStaticBody(const string& data);
+
+  const string& data() const { return data_; }
+  uint64_t generation() const { return generation_; }
+
+ private:
+  const string data_;
+  const uint64_t generation_;
+};
+
+typedef std::shared_ptr<const HttpStaticBody> HttpStaticBodyPtr;
+
 class HttpResponse : public muduo::copyable
 {
  public:
@@ -32,6 +55,7 @@ class HttpResponse : public muduo::copyable
     k301MovedPermanently = 301,
     k400BadRequest = 400,
     k404NotFound = 404,
+    k405MethodNotAllowed = 405,
   };
 
   explicit HttpResponse(bool close)
@@ -59,8 +83,44 @@ class HttpResponse : public muduo::copyable
   void addHeader(const string& key, const string& value)
   { headers_[key] = value; }
 
+  string getHeader(const string& key) const
+  {
+    string result;
+    std::map<string, string>::const_iterator it = headers_.find(key);
+    if (it != headers_.end())
+    {
+      result = it->second;
+    }
+    return result;
+  }
+
   void setBody(const string& body)
-  { body_ = body; }
+  { body_ = body; sharedBody_.reset(); staticBody_.reset(); }
+
+  void setBody(string&& body)
+  { body_ = std::move(body); sharedBody_.reset(); staticBody_.reset(); }
+
+  /// Shares body instead of copying it.
+  void setBody(const std::shared_ptr<const string>& body)
+  { body_.clear(); sharedBody_ = body; staticBody_.reset(); }
+
+  /// Shares body, and tells HttpServer that it seldom changes,
+  /// so its compressed form can be cached by the request path.
+  void setStaticBody(const HttpStaticBodyPtr& body)
+  {
+    body_.clear();
+    sharedBody_ = std::shared_ptr<const string>(body, &body->data());
+    staticBody_ = body;
+  }
+
+  const string& body() const
+  { return sharedBody_ ? *sharedBody_ : body_; }
+
+  bool isStaticBody() const
+  { return static_cast<bool>(staticBody_); }
+
+  const HttpStaticBodyPtr& staticBody() const
+  { return staticBody_; }
 
   void appendToBuffer(Buffer* output) const;
 
@@ -71,6 +131,8 @@ class HttpResponse : public muduo::copyable
   string statusMessage_;
   bool closeConnection_;
   string body_;
+  std::shared_ptr<const string> sharedBody_;  // instead of body_
+  HttpStaticBodyPtr staticBody_;
 };
 
 }  // namespace net
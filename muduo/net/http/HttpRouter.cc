@@ -0,0 +1,270 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/HttpRouter.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const int kNumMethods = HttpRequest::kDelete + 1;
+
+// by HttpRequest::Method
+const char* const kMethodNames[kNumMethods] =
+{
+  "", "GET", "POST", "HEAD", "PUT", "DELETE"
+};
+
+}  // namespace
+
+struct HttpRouter::Node : noncopyable
+{
+  typedef std::unique_ptr<Node> NodePtr;
+
+  explicit Node(const string& seg)
+    : segment(seg)
+  {
+  }
+
+  static bool less(const NodePtr& node, StringPiece seg)
+  {
+    return StringPiece(node->segment) < seg;
+  }
+
+  // for the Allow header, HEAD if there is GET
+  string allowedMethods() const
+  {
+    string result;
+    for (int i = HttpRequest::kGet; i < kNumMethods; ++i)
+    {
+      if (hasHandler(static_cast<HttpRequest::Method>(i)))
+      {
+        if (!result.empty())
+          result += ", ";
+        result += kMethodNames[i];
+      }
+    }
+    return result;
+  }
+
+  bool hasHandler(HttpRequest::Method method) const
+  {
+    if (method == HttpRequest::kInvalid)
+    {
+      for (int i = 0; i < kNumMethods; ++i)
+      {
+        if (handlers[i])
+          return true;
+      }
+      return false;
+    }
+    return handlers[method] || (method == HttpRequest::kHead && handlers[HttpRequest::kGet]);
+  }
+
+  const Handler& handler(HttpRequest::Method method) const
+  {
+    if (method == HttpRequest::kHead && !handlers[method])
+    {
+      return handlers[HttpRequest::kGet];
+    }
+    return handlers[method];
+  }
+
+  // literal segment, or name of parameter and wildcard
+  string segment;
+  // sorted by segment, for binary search
+  std::vector<std::unique_ptr<Node>> children;
+  std::unique_ptr<Node> param;
+  std::unique_ptr<Node> wildcard;
+  Handler handlers[kNumMethods];
+};
+
+HttpRouter::HttpRouter()
+  : root_(new Node("")),
+    numRoutes_(0)
+{
+}
+
+HttpRouter::~HttpRouter()
+{
+}
+
+void HttpRouter::add(HttpRequest::Method method,
+                     const string& pattern,
+                     const Handler& handler)
+{
+  if (!isValidPattern(pattern.c_str())
+      || pattern.find('\0') != string::npos
+      || method == HttpRequest::kInvalid)
+  {
+    LOG_FATAL << "HttpRouter::add - invalid route " << pattern;
+  }
+
+  int numParams = 0;
+  Node* node = root_.get();
+  // "/" is the root, others are split into segments, trailing slash is an empty one.
+  if (pattern.size() > 1)
+  {
+    const char* p = pattern.c_str() + 1;
+    const char* end = pattern.c_str() + pattern.size();
+    while (true)
+    {
+      const char* slash = std::find(p, end, '/');
+      StringPiece segment(p, static_cast<int>(slash - p));
+      if (!segment.empty() && (segment[0] == ':' || segment[0] == '*'))
+      {
+        if (++numParams > HttpRouteParams::kMaxParams)
+        {
+          LOG_FATAL << "HttpRouter::add - too many parameters " << pattern;
+        }
+        string name(segment.data() + 1, segment.size() - 1);
+        Node::NodePtr& child = segment[0] == ':' ? node->param : node->wildcard;
+        if (!child)
+        {
+          child.reset(new Node(name));
+        }
+        else if (child->segment != name)
+        {
+          LOG_FATAL << "HttpRouter::add - conflicting parameter name " << pattern;
+        }
+        node = child.get();
+      }
+      else
+      {
+        std::vector<Node::NodePtr>::iterator it =
+          std::lower_bound(node->children.begin(), node->children.end(), segment, Node::less);
+        if (it == node->children.end() || StringPiece((*it)->segment) != segment)
+        {
+          it = node->children.insert(it, Node::NodePtr(new Node(segment.as_string())));
+        }
+        node = it->get();
+      }
+
+      if (slash == end)
+      {
+        break;
+      }
+      p = slash + 1;
+    }
+  }
+
+  if (!node->handlers[method])
+  {
+    ++numRoutes_;
+  }
+  node->handlers[method] = handler;
+}
+
+void HttpRouter::any(const string& pattern, const Handler& handler)
+{
+  for (int method = HttpRequest::kGet; method < kNumMethods; ++method)
+  {
+    add(static_cast<HttpRequest::Method>(method), pattern, handler);
+  }
+}
+
+const HttpRouter::Node* HttpRouter::match(const Node* node,
+                                          const char* begin,
+                                          const char* end,
+                                          HttpRequest::Method method,
+                                          HttpRouteParams* params) const
+{
+  if (begin == NULL)
+  {
+    return node->hasHandler(method) ? node : NULL;
+  }
+
+  const char* slash = std::find(begin, end, '/');
+  StringPiece segment(begin, static_cast<int>(slash - begin));
+  // NULL for no more segments
+  const char* next = slash == end ? NULL : slash + 1;
+
+  std::vector<Node::NodePtr>::const_iterator it =
+    std::lower_bound(node->children.begin(), node->children.end(), segment, Node::less);
+  if (it != node->children.end() && StringPiece((*it)->segment) == segment)
+  {
+    const Node* found = match(it->get(), next, end, method, params);
+    if (found)
+      return found;
+  }
+
+  if (node->param && !segment.empty())
+  {
+    params->push(node->param->segment, segment);
+    const Node* found = match(node->param.get(), next, end, method, params);
+    if (found)
+      return found;
+    params->pop();
+  }
+
+  if (node->wildcard && node->wildcard->hasHandler(method))
+  {
+    params->push(node->wildcard->segment, StringPiece(begin, static_cast<int>(end - begin)));
+    return node->wildcard.get();
+  }
+  return NULL;
+}
+
+const HttpRouter::Handler* HttpRouter::find(HttpRequest::Method method,
+                                            StringPiece path,
+                                            HttpRouteParams* params) const
+{
+  const Node* node = matchPath(method, path, params);
+  return node ? &node->handler(method) : NULL;
+}
+
+const HttpRouter::Node* HttpRouter::matchPath(HttpRequest::Method method,
+                                              StringPiece path,
+                                              HttpRouteParams* params) const
+{
+  if (path.empty() || path[0] != '/')
+  {
+    return NULL;
+  }
+  const char* begin = path.size() == 1 ? NULL : path.data() + 1;
+  return match(root_.get(), begin, path.end(), method, params);
+}
+
+void HttpRouter::dispatch(const HttpRequest& req, HttpResponse* resp) const
+{
+  HttpRouteParams params;
+  const Handler* handler = find(req.method(), req.path(), &params);
+  const Node* node = NULL;
+  if (handler)
+  {
+    (*handler)(req, params, resp);
+  }
+  else if (req.method() != HttpRequest::kInvalid
+           && (node = matchPath(HttpRequest::kInvalid, req.path(), &params)) != NULL)
+  {
+    resp->setStatusCode(HttpResponse::k405MethodNotAllowed);
+    resp->setStatusMessage("Method Not Allowed");
+    // RFC 7231 section 6.5.5
+    resp->addHeader("Allow", node->allowedMethods());
+    resp->setCloseConnection(true);
+  }
+  else if (notFoundHandler_)
+  {
+    notFoundHandler_(req, params, resp);
+  }
+  else
+  {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+  }
+}
@@ -0,0 +1,187 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPROUTER_H
+#define MUDUO_NET_HTTP_HTTPROUTER_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/net/http/HttpRequest.h"
+
+#include <functional>
+#include <memory>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpResponse;
+
+namespace detail
+{
+
+// helper of HttpRouter::isValidPattern(), c++11 constexpr must be one expression.
+constexpr bool isValidRouteFrom(const char* p, char prev, bool wildcard)
+{
+  return *p == '\0' ? (prev != ':' && prev != '*')
+    : *p == '/' ? (!wildcard && prev != '/' && prev != ':' && prev != '*'
+                   && isValidRouteFrom(p + 1, '/', false))
+    : (*p == ':' || *p == '*') ? (prev == '/' && isValidRouteFrom(p + 1, *p, *p == '*'))
+    : isValidRouteFrom(p + 1, *p, wildcard);
+}
+
+}  // namespace detail
+
+/// Path parameters captured by HttpRouter, eg. id of "/users/:id".
+///
+/// Both name and value refer to memory owned by the router and the request,
+/// so no allocation during dispatching, don't keep it after the handler returns.
+class HttpRouteParams : noncopyable
+{
+ public:
+  static const int kMaxParams = 8;
+
+  HttpRouteParams()
+    : size_(0)
+  {
+  }
+
+  int size() const { return size_; }
+  StringPiece name(int i) const { return names_[i]; }
+  StringPiece value(int i) const { return values_[i]; }
+
+  // return empty if not found
+  StringPiece get(StringPiece name) const
+  {
+    for (int i = 0; i < size_; ++i)
+    {
+      if (names_[i] == name)
+      {
+        return values_[i];
+      }
+    }
+    return StringPiece();
+  }
+
+ private:
+  friend class HttpRouter;
+
+  void push(StringPiece name, StringPiece value)
+  {
+    assert(size_ < kMaxParams);
+    names_[size_] = name;
+    values_[size_] = value;
+    ++size_;
+  }
+
+  void pop()
+  {
+    assert(size_ > 0);
+    --size_;
+  }
+
+  StringPiece names_[kMaxParams];
+  StringPiece values_[kMaxParams];
+  int size_;
+};
+
+/// Dispatches HTTP requests by method and path.
+///
+/// Routes are stored in a trie of path segments, a segment could be
+/// - literal, "users"
+/// - parameter, ":id", matches exactly one segment
+/// - wildcard, "*path", matches the rest of path, must be the last one
+/// Literal wins over parameter, which wins over wildcard, if the rest of
+/// the path doesn't match under a literal, the parameter is tried, and so on.
+/// A trie node stands for one prefix, so it is tried at most once for a path.
+/// Dispatching costs O(path length) when literals and parameters don't
+/// overlap, the worst case is O(number of nodes), not exponential.
+///
+/// Routes must be added before HttpServer::start(), dispatch() is thread safe.
+///
+/// @code
+/// HttpRouter router;
+/// router.get("/users/:id", onGetUser);
+/// server.setHttpCallback(std::bind(&HttpRouter::dispatch, &router, _1, _2));
+/// @endcode
+class HttpRouter : noncopyable
+{
+ public:
+  typedef std::function<void (const HttpRequest&,
+                              const HttpRouteParams&,
+                              HttpResponse*)> Handler;
+
+  HttpRouter();
+  ~HttpRouter();  // force out-line dtor, for std::unique_ptr members.
+
+  /// Checks a route pattern, usable in static_assert() for literal routes.
+  static constexpr bool isValidPattern(const char* pattern)
+  {
+    return pattern[0] == '/' && detail::isValidRouteFrom(pattern + 1, '/', false);
+  }
+
+  /// Aborts if pattern is invalid, or has more than HttpRouteParams::kMaxParams
+  /// parameters. Replaces previous handler of the same method and pattern.
+  void add(HttpRequest::Method method, const string& pattern, const Handler& handler);
+
+  void get(const string& pattern, const Handler& handler)
+  { add(HttpRequest::kGet, pattern, handler); }
+
+  void post(const string& pattern, const Handler& handler)
+  { add(HttpRequest::kPost, pattern, handler); }
+
+  void put(const string& pattern, const Handler& handler)
+  { add(HttpRequest::kPut, pattern, handler); }
+
+  void del(const string& pattern, const Handler& handler)
+  { add(HttpRequest::kDelete, pattern, handler); }
+
+  /// for all methods
+  void any(const string& pattern, const Handler& handler);
+
+  /// Called when no route matches the path, default replies 404.
+  void setNotFoundHandler(const Handler& handler)
+  { notFoundHandler_ = handler; }
+
+  /// Finds handler of req, replies 405 with an Allow header if path matches
+  /// but method doesn't.
+  /// HEAD falls back to GET handler.
+  void dispatch(const HttpRequest& req, HttpResponse* resp) const;
+
+  /// return NULL if not found, params are filled on success.
+  const Handler* find(HttpRequest::Method method,
+                      StringPiece path,
+                      HttpRouteParams* params) const;
+
+  size_t size() const { return numRoutes_; }
+
+ private:
+  struct Node;
+
+  // kInvalid matches any method
+  const Node* matchPath(HttpRequest::Method method,
+                        StringPiece path,
+                        HttpRouteParams* params) const;
+  const Node* match(const Node* node,
+                    const char* begin,
+                    const char* end,
+                    HttpRequest::Method method,
+                    HttpRouteParams* params) const;
+
+  std::unique_ptr<Node> root_;
+  Handler notFoundHandler_;
+  size_t numRoutes_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPROUTER_H
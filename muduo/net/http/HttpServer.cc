@@ -10,6 +10,7 @@
 #include "muduo/net/http/HttpServer.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/net/http/HttpCompressor.h"
 #include "muduo/net/http/HttpContext.h"
 #include "muduo/net/http/HttpRequest.h"
 #include "muduo/net/http/HttpResponse.h"
@@ -31,6 +32,15 @@ void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
   resp->setCloseConnection(true);
 }
 
+// compressing images or archives is a waste of CPU
+bool isCompressible(const string& contentType)
+{
+  return contentType.compare(0, 5, "text/") == 0
+    || contentType.find("json") != string::npos
+    || contentType.find("javascript") != string::npos
+    || contentType.find("xml") != string::npos;
+}
+
 }  // namespace detail
 }  // namespace net
 }  // namespace muduo
@@ -40,7 +50,9 @@ HttpServer::HttpServer(EventLoop* loop,
                        const string& name,
                        TcpServer::Option option)
   : server_(loop, listenAddr, name, option),
-    httpCallback_(detail::defaultHttpCallback)
+    httpCallback_(detail::defaultHttpCallback),
+    compression_(false),
+    minCompressSize_(0)
 {
   server_.setConnectionCallback(
       std::bind(&HttpServer::onConnection, this, _1));
@@ -48,6 +60,20 @@ HttpServer::HttpServer(EventLoop* loop,
       std::bind(&HttpServer::onMessage, this, _1, _2, _3));
 }
 
+HttpServer::~HttpServer()
+{
+}
+
+void HttpServer::enableCompression(size_t minBodySize)
+{
+  compression_ = true;
+  minCompressSize_ = minBodySize;
+  if (!compressionCache_)
+  {
+    compressionCache_.reset(new HttpCompressionCache);
+  }
+}
+
 void HttpServer::start()
 {
   LOG_WARN << "HttpServer[" << server_.name()
@@ -89,6 +115,10 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
   HttpResponse response(close);
   httpCallback_(req, &response);
+  if (compression_)
+  {
+    compressResponse(req, &response);
+  }
   Buffer buf;
   response.appendToBuffer(&buf);
   conn->send(&buf);
@@ -98,3 +128,55 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
   }
 }
 
+
+void HttpServer::compressResponse(const HttpRequest& req, HttpResponse* resp)
+{
+  const string& body = resp->body();
+  if (body.size() < minCompressSize_
+      || !detail::isCompressible(resp->getHeader("Content-Type"))
+      || !resp->getHeader("Content-Encoding").empty())
+  {
+    return;
+  }
+
+  // the body depends on Accept-Encoding from now on
+  resp->addHeader("Vary", "Accept-Encoding");
+  HttpCompressor::Encoding encoding =
+    HttpCompressor::negotiate(req.getHeader("Accept-Encoding"));
+  if (encoding == HttpCompressor::kIdentity)
+  {
+    return;
+  }
+
+  if (resp->isStaticBody())
+  {
+    const HttpStaticBody& staticBody = *resp->staticBody();
+    HttpCompressionCache::BodyPtr cached =
+      compressionCache_->get(req.path(), encoding, staticBody);
+    if (!cached)
+    {
+      std::shared_ptr<string> compressed(new string);
+      if (!compressors_.value().compress(encoding, body, compressed.get()))
+      {
+        return;
+      }
+      compressionCache_->put(req.path(), encoding, staticBody, compressed);
+      cached = compressed;
+    }
+    if (cached->size() < body.size())
+    {
+      resp->setBody(cached);
+      resp->addHeader("Content-Encoding", HttpCompressor::encodingToString(encoding));
+    }
+  }
+  else
+  {
+    string compressed;
+    if (compressors_.value().compress(encoding, body, &compressed)
+        && compressed.size() < body.size())
+    {
+      resp->setBody(std::move(compressed));
+      resp->addHeader("Content-Encoding", HttpCompressor::encodingToString(encoding));
+    }
+  }
+}
@@ -11,6 +11,7 @@
 #ifndef MUDUO_NET_HTTP_HTTPSERVER_H
 #define MUDUO_NET_HTTP_HTTPSERVER_H
 
+#include "muduo/base/ThreadLocal.h"
 #include "muduo/net/TcpServer.h"
 
 namespace muduo
@@ -18,6 +19,8 @@ namespace muduo
 namespace net
 {
 
+class HttpCompressionCache;
+class HttpCompressor;
 class HttpRequest;
 class HttpResponse;
 
@@ -35,6 +38,7 @@ class HttpServer : noncopyable
              const InetAddress& listenAddr,
              const string& name,
              TcpServer::Option option = TcpServer::kNoReusePort);
+  ~HttpServer();  // force out-line dtor, for std::unique_ptr members.
 
   EventLoop* getLoop() const { return server_.getLoop(); }
 
@@ -49,6 +53,13 @@ class HttpServer : noncopyable
     server_.setThreadNum(numThreads);
   }
 
+  /// Compresses response body with gzip or deflate, if the client accepts it,
+  /// the body is textual and not shorter than @c minBodySize.
+  /// Each I/O thread reuses its own z_streams, bodies set by
+  /// HttpResponse::setStaticBody() are compressed only once.
+  /// Not thread safe, must be called before start().
+  void enableCompression(size_t minBodySize = 1024);
+
   void start();
 
  private:
@@ -57,9 +68,14 @@ class HttpServer : noncopyable
                  Buffer* buf,
                  Timestamp receiveTime);
   void onRequest(const TcpConnectionPtr&, const HttpRequest&);
+  void compressResponse(const HttpRequest&, HttpResponse*);
 
   TcpServer server_;
   HttpCallback httpCallback_;
+  bool compression_;
+  size_t minCompressSize_;
+  ThreadLocal<HttpCompressor> compressors_;
+  std::unique_ptr<HttpCompressionCache> compressionCache_;
 };
 
 }  // namespace net
@@ -0,0 +1,123 @@
+#include "muduo/net/http/HttpCompressor.h"
+
+//#define BOOST_TEST_MODULE HttpCompressorTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::string;
+using muduo::net::HttpCompressionCache;
+using muduo::net::HttpCompressor;
+using muduo::net::HttpResponse;
+using muduo::net::HttpStaticBody;
+using muduo::net::HttpStaticBodyPtr;
+
+namespace
+{
+
+string inflate(const string& compressed, int windowBits)
+{
+  z_stream zs;
+  memset(&zs, 0, sizeof zs);
+  BOOST_REQUIRE_EQUAL(inflateInit2(&zs, windowBits), Z_OK);
+  string output(65536, '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  zs.avail_in = static_cast<uInt>(compressed.size());
+  zs.next_out = reinterpret_cast<Bytef*>(&*output.begin());
+  zs.avail_out = static_cast<uInt>(output.size());
+  BOOST_CHECK_EQUAL(::inflate(&zs, Z_FINISH), Z_STREAM_END);
+  output.resize(zs.total_out);
+  inflateEnd(&zs);
+  return output;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testNegotiate)
+{
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate(""), HttpCompressor::kIdentity);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("identity"), HttpCompressor::kIdentity);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("gzip, deflate, br"), HttpCompressor::kGzip);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("deflate"), HttpCompressor::kDeflate);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("GZIP"), HttpCompressor::kGzip);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("gzip;q=0, deflate"), HttpCompressor::kDeflate);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("gzip;q=0.5, deflate;q=0.8"), HttpCompressor::kDeflate);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("gzip; q=0 , deflate ;q=0"), HttpCompressor::kIdentity);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("*"), HttpCompressor::kGzip);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("*;q=0"), HttpCompressor::kIdentity);
+}
+
+BOOST_AUTO_TEST_CASE(testCompressReuse)
+{
+  HttpCompressor compressor;
+  string body;
+  for (int i = 0; i < 1000; ++i)
+  {
+    body += "{\"id\": 12345, \"name\": \"muduo\"},";
+  }
+
+  for (int i = 0; i < 3; ++i)
+  {
+    string gzip;
+    BOOST_CHECK(compressor.compress(HttpCompressor::kGzip, body, &gzip));
+    BOOST_CHECK(gzip.size() < body.size());
+    BOOST_CHECK_EQUAL(gzip[0], '\x1f');
+    BOOST_CHECK(inflate(gzip, 15 + 16) == body);
+
+    string deflate;
+    BOOST_CHECK(compressor.compress(HttpCompressor::kDeflate, body, &deflate));
+    BOOST_CHECK(inflate(deflate, 15) == body);
+  }
+
+  string empty;
+  BOOST_CHECK(compressor.compress(HttpCompressor::kGzip, "", &empty));
+  BOOST_CHECK(inflate(empty, 15 + 16).empty());
+}
+
+BOOST_AUTO_TEST_CASE(testCompressionCache)
+{
+  HttpCompressionCache cache(2);
+  HttpStaticBody body(string(4096, 'x'));
+  BOOST_CHECK(!cache.get("/a", HttpCompressor::kGzip, body));
+
+  HttpCompressionCache::BodyPtr gzip(new string("gzipped"));
+  cache.put("/a", HttpCompressor::kGzip, body, gzip);
+  BOOST_CHECK(cache.get("/a", HttpCompressor::kGzip, body) == gzip);
+  BOOST_CHECK(!cache.get("/a", HttpCompressor::kDeflate, body));
+
+  // body changed, entry is stale
+  HttpStaticBody body2(string(4096, 'y'));
+  BOOST_CHECK(!cache.get("/a", HttpCompressor::kGzip, body2));
+
+  // another object, even of the same content
+  HttpStaticBody same(string(4096, 'x'));
+  BOOST_CHECK(!cache.get("/a", HttpCompressor::kGzip, same));
+
+  // full, evicts the least recently used
+  cache.put("/b", HttpCompressor::kGzip, body, gzip);
+  BOOST_CHECK(cache.get("/a", HttpCompressor::kGzip, body) == gzip);
+  cache.put("/c", HttpCompressor::kGzip, body, gzip);
+  BOOST_CHECK_EQUAL(cache.size(), 2);
+  BOOST_CHECK(cache.get("/a", HttpCompressor::kGzip, body) == gzip);
+  BOOST_CHECK(!cache.get("/b", HttpCompressor::kGzip, body));
+  BOOST_CHECK(cache.get("/c", HttpCompressor::kGzip, body) == gzip);
+}
+
+BOOST_AUTO_TEST_CASE(testSharedBody)
+{
+  HttpStaticBodyPtr body(new HttpStaticBody("static"));
+  HttpResponse resp(false);
+  resp.setStaticBody(body);
+  BOOST_CHECK(resp.isStaticBody());
+  BOOST_CHECK_EQUAL(&resp.body(), &body->data());
+
+  std::shared_ptr<const string> compressed(new string("compressed"));
+  resp.setBody(compressed);
+  BOOST_CHECK_EQUAL(&resp.body(), compressed.get());
+  BOOST_CHECK(!resp.isStaticBody());
+
+  resp.setStaticBody(body);
+  resp.setBody("copied");
+  BOOST_CHECK_EQUAL(resp.body(), "copied");
+  BOOST_CHECK(!resp.isStaticBody());
+}
@@ -0,0 +1,155 @@
+#include "muduo/net/http/HttpRouter.h"
+#include "muduo/net/http/HttpResponse.h"
+
+//#define BOOST_TEST_MODULE HttpRouterTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+
+using muduo::string;
+using muduo::StringPiece;
+using muduo::net::HttpRequest;
+using muduo::net::HttpResponse;
+using muduo::net::HttpRouteParams;
+using muduo::net::HttpRouter;
+
+static_assert(HttpRouter::isValidPattern("/"), "root");
+static_assert(HttpRouter::isValidPattern("/users/:id/posts/*rest"), "params");
+static_assert(!HttpRouter::isValidPattern("users"), "relative");
+static_assert(!HttpRouter::isValidPattern("/users//posts"), "empty segment");
+static_assert(!HttpRouter::isValidPattern("/users/:"), "unnamed param");
+static_assert(!HttpRouter::isValidPattern("/users/x:id"), "param in middle");
+static_assert(!HttpRouter::isValidPattern("/files/*path/more"), "wildcard not last");
+
+namespace
+{
+
+string matched;
+
+HttpRouter::Handler record(const string& name)
+{
+  return [name](const HttpRequest&, const HttpRouteParams&, HttpResponse*)
+  {
+    matched = name;
+  };
+}
+
+string route(const HttpRouter& router, HttpRequest::Method method, const char* path)
+{
+  HttpRouteParams params;
+  const HttpRouter::Handler* handler = router.find(method, path, &params);
+  if (!handler)
+    return "none";
+  string result = "ok";
+  for (int i = 0; i < params.size(); ++i)
+  {
+    result += " " + params.name(i).as_string() + "=" + params.value(i).as_string();
+  }
+  return result;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testStaticRoutes)
+{
+  HttpRouter router;
+  router.get("/", record("root"));
+  router.get("/hello", record("hello"));
+  router.get("/hello/", record("hello/"));
+  router.get("/hello/world", record("world"));
+  BOOST_CHECK_EQUAL(router.size(), 4);
+
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/hello"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/hello/"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/hello/world"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/hello/world/"), "none");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/hell"), "none");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, ""), "none");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kPost, "/hello"), "none");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kHead, "/hello"), "ok");
+}
+
+BOOST_AUTO_TEST_CASE(testParams)
+{
+  HttpRouter router;
+  router.get("/users/new", record("new"));
+  router.get("/users/:id", record("user"));
+  router.post("/users/:id/posts/:post", record("post"));
+  router.get("/static/*path", record("static"));
+
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/users/new"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/users/42"), "ok id=42");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/users/"), "none");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kPost, "/users/new/posts/7"), "ok id=new post=7");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/static/css/main.css"), "ok path=css/main.css");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/static/"), "ok path=");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/static"), "none");
+}
+
+BOOST_AUTO_TEST_CASE(testFallback)
+{
+  HttpRouter router;
+  router.get("/a/b/c", record("literal"));
+  router.get("/:x/b/d", record("param"));
+  router.get("/:x/:y/e", record("params"));
+  router.get("/*rest", record("wildcard"));
+
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/a/b/c"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/a/b/d"), "ok x=a");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/a/b/e"), "ok x=a y=b");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/a/b/f"), "ok rest=a/b/f");
+}
+
+BOOST_AUTO_TEST_CASE(testAny)
+{
+  HttpRouter router;
+  router.any("/all", record("all"));
+  BOOST_CHECK_EQUAL(router.size(), 5);
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/all"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kPost, "/all"), "ok");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kDelete, "/all"), "ok");
+}
+
+BOOST_AUTO_TEST_CASE(testDispatch)
+{
+  HttpRouter router;
+  router.get("/users/:id", record("get"));
+  router.del("/users/:id", record("delete"));
+
+  HttpRequest req;
+  const char get[] = "GET";
+  const char path[] = "/users/1";
+  req.setMethod(get, get + 3);
+  req.setPath(path, path + sizeof(path) - 1);
+  HttpResponse resp(false);
+  router.dispatch(req, &resp);
+  BOOST_CHECK_EQUAL(matched, "get");
+
+  HttpRequest post;
+  const char postStr[] = "POST";
+  post.setMethod(postStr, postStr + 4);
+  post.setPath(path, path + sizeof(path) - 1);
+  HttpResponse resp405(false);
+  router.dispatch(post, &resp405);
+  BOOST_CHECK(resp405.closeConnection());
+  BOOST_CHECK_EQUAL(resp405.getHeader("Allow"), "GET, HEAD, DELETE");
+  BOOST_CHECK_EQUAL(matched, "get");
+}
+
+BOOST_AUTO_TEST_CASE(testManyRoutes)
+{
+  HttpRouter router;
+  char buf[64];
+  for (int i = 0; i < 500; ++i)
+  {
+    snprintf(buf, sizeof buf, "/api/v1/resource%d/:id", i);
+    router.get(buf, record(buf));
+  }
+  BOOST_CHECK_EQUAL(router.size(), 500);
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/api/v1/resource0/a"), "ok id=a");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/api/v1/resource499/b"), "ok id=b");
+  BOOST_CHECK_EQUAL(route(router, HttpRequest::kGet, "/api/v1/resource500/c"), "none");
+}
@@ -1,6 +1,7 @@
 #include "muduo/net/http/HttpServer.h"
 #include "muduo/net/http/HttpRequest.h"
 #include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/http/HttpRouter.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/base/Logging.h"
 
@@ -13,7 +14,7 @@ using namespace muduo::net;
 extern char favicon[555];
 bool benchmark = false;
 
-void onRequest(const HttpRequest& req, HttpResponse* resp)
+void printHeaders(const HttpRequest& req)
 {
   std::cout << "Headers " << req.methodString() << " " << req.path() << std::endl;
   if (!benchmark)
@@ -24,39 +25,39 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
       std::cout << header.first << ": " << header.second << std::endl;
     }
   }
+}
 
-  if (req.path() == "/")
-  {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("text/html");
-    resp->addHeader("Server", "Muduo");
-    string now = Timestamp::now().toFormattedString();
-    resp->setBody("<html><head><title>This is title</title></head>"
-        "<body><h1>Hello</h1>Now is " + now +
-        "</body></html>");
-  }
-  else if (req.path() == "/favicon.ico")
-  {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("image/png");
-    resp->setBody(string(favicon, sizeof favicon));
-  }
-  else if (req.path() == "/hello")
-  {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("text/plain");
-    resp->addHeader("Server", "Muduo");
-    resp->setBody("hello, world!\n");
-  }
-  else
-  {
-    resp->setStatusCode(HttpResponse::k404NotFound);
-    resp->setStatusMessage("Not Found");
-    resp->setCloseConnection(true);
-  }
+void onIndex(const HttpRequest& req, const HttpRouteParams&, HttpResponse* resp)
+{
+  printHeaders(req);
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("text/html");
+  resp->addHeader("Server", "Muduo");
+  string now = Timestamp::now().toFormattedString();
+  resp->setBody("<html><head><title>This is title</title></head>"
+      "<body><h1>Hello</h1>Now is " + now +
+      "</body></html>");
+}
+
+void onFavicon(const HttpRequest& req, const HttpRouteParams&, HttpResponse* resp)
+{
+  printHeaders(req);
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("image/png");
+  resp->setBody(string(favicon, sizeof favicon));
+}
+
+void onHello(const HttpRequest& req, const HttpRouteParams& params, HttpResponse* resp)
+{
+  printHeaders(req);
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("text/plain");
+  resp->addHeader("Server", "Muduo");
+  StringPiece name = params.get("name");
+  resp->setBody("hello, " + (name.empty() ? string("world") : name.as_string()) + "!\n");
 }
 
 int main(int argc, char* argv[])
@@ -68,9 +69,16 @@ int main(int argc, char* argv[])
     Logger::setLogLevel(Logger::WARN);
     numThreads = atoi(argv[1]);
   }
+  // serves every method, as it did before the router
+  HttpRouter router;
+  router.any("/", onIndex);
+  router.any("/favicon.ico", onFavicon);
+  router.any("/hello", onHello);
+  router.any("/hello/:name", onHello);
+
   EventLoop loop;
   HttpServer server(&loop, InetAddress(8000), "dummy");
-  server.setHttpCallback(onRequest);
+  server.setHttpCallback(std::bind(&HttpRouter::dispatch, &router, _1, _2));
   server.setThreadNum(numThreads);
   server.start();
   loop.loop();
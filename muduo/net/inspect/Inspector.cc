@@ -14,7 +14,9 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/http/HttpRequest.h"
 #include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/inspect/MetricsInspector.h"
 #include "muduo/net/inspect/ProcessInspector.h"
+#include "muduo/net/inspect/ProfilerInspector.h"
 #include "muduo/net/inspect/PerformanceInspector.h"
 #include "muduo/net/inspect/SystemInspector.h"
 
@@ -63,14 +65,18 @@ Inspector::Inspector(EventLoop* loop,
                      const InetAddress& httpAddr,
                      const string& name)
     : server_(loop, httpAddr, "Inspector:"+name),
+      metricsInspector_(new MetricsInspector),
       processInspector_(new ProcessInspector),
+      profilerInspector_(new ProfilerInspector),
       systemInspector_(new SystemInspector)
 {
   assert(CurrentThread::isMainThread());
   assert(g_globalInspector == 0);
   g_globalInspector = this;
   server_.setHttpCallback(std::bind(&Inspector::onRequest, this, _1, _2));
+  metricsInspector_->registerCommands(this);
   processInspector_->registerCommands(this);
+  profilerInspector_->registerCommands(this);
   systemInspector_->registerCommands(this);
 #ifdef HAVE_TCMALLOC
   performanceInspector_.reset(new PerformanceInspector);
@@ -22,7 +22,9 @@ namespace muduo
 namespace net
 {
 
+class MetricsInspector;
 class ProcessInspector;
+class ProfilerInspector;
 class PerformanceInspector;
 class SystemInspector;
 
@@ -53,7 +55,9 @@ class Inspector : noncopyable
   void onRequest(const HttpRequest& req, HttpResponse* resp);
 
   HttpServer server_;
+  std::unique_ptr<MetricsInspector> metricsInspector_;
   std::unique_ptr<ProcessInspector> processInspector_;
+  std::unique_ptr<ProfilerInspector> profilerInspector_;
   std::unique_ptr<PerformanceInspector> performanceInspector_;
   std::unique_ptr<SystemInspector> systemInspector_;
   MutexLock mutex_;
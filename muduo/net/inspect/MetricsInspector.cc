@@ -0,0 +1,47 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/inspect/MetricsInspector.h"
+#include "muduo/base/Metrics.h"
+#include "muduo/net/SlowEventLog.h"
+#include "muduo/net/TcpInfoSampler.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+void MetricsInspector::registerCommands(Inspector* ins)
+{
+  ins->add("metrics", "text", MetricsInspector::text, "print metrics of muduo and the program");
+  ins->add("metrics", "prometheus", MetricsInspector::prometheus,
+           "metrics in Prometheus text exposition format");
+  ins->add("loop", "slow", MetricsInspector::slowEvents,
+           "recent callbacks over EventLoop::setSlowThreshold()");
+  ins->add("tcp", "info", MetricsInspector::tcpInfo,
+           "TCP_INFO percentiles and slow peers, see TcpServer::setTcpInfoSampling()");
+}
+
+string MetricsInspector::text(HttpRequest::Method, const Inspector::ArgList&)
+{
+  return metrics::Registry::instance().toText();
+}
+
+string MetricsInspector::prometheus(HttpRequest::Method, const Inspector::ArgList&)
+{
+  return metrics::Registry::instance().toPrometheus();
+}
+
+string MetricsInspector::slowEvents(HttpRequest::Method, const Inspector::ArgList&)
+{
+  return SlowEventLog::instance().toString();
+}
+
+string MetricsInspector::tcpInfo(HttpRequest::Method, const Inspector::ArgList&)
+{
+  return TcpInfoSampler::reportAll();
+}
@@ -0,0 +1,36 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_INSPECT_METRICSINSPECTOR_H
+#define MUDUO_NET_INSPECT_METRICSINSPECTOR_H
+
+#include "muduo/net/inspect/Inspector.h"
+
+namespace muduo
+{
+namespace net
+{
+
+// metrics::Registry, SlowEventLog and TcpInfoSamplers of the process
+class MetricsInspector : noncopyable
+{
+ public:
+  void registerCommands(Inspector* ins);
+
+  static string text(HttpRequest::Method, const Inspector::ArgList&);
+  static string prometheus(HttpRequest::Method, const Inspector::ArgList&);
+  static string slowEvents(HttpRequest::Method, const Inspector::ArgList&);
+  static string tcpInfo(HttpRequest::Method, const Inspector::ArgList&);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_INSPECT_METRICSINSPECTOR_H
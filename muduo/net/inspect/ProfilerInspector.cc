@@ -0,0 +1,70 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/inspect/ProfilerInspector.h"
+#include "muduo/base/SamplingProfiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+string status()
+{
+  SamplingProfiler& profiler = SamplingProfiler::instance();
+  char buf[256];
+  snprintf(buf, sizeof buf, "%s, %lld samples, %lld dropped\n",
+           profiler.started() ? "started" : "stopped",
+           static_cast<long long>(profiler.samples()),
+           static_cast<long long>(profiler.dropped()));
+  return buf;
+}
+
+}  // namespace
+
+void ProfilerInspector::registerCommands(Inspector* ins)
+{
+  ins->add("profiler", "start", ProfilerInspector::start,
+           "start sampling CPU, /profiler/start/<hz>, 99 by default");
+  ins->add("profiler", "stop", ProfilerInspector::stop, "stop sampling CPU");
+  ins->add("profiler", "collapsed", ProfilerInspector::collapsed,
+           "stacks sampled so far, input of flamegraph.pl");
+  ins->add("profiler", "reset", ProfilerInspector::reset, "clear stacks sampled so far");
+}
+
+string ProfilerInspector::start(HttpRequest::Method, const Inspector::ArgList& args)
+{
+  int hz = args.empty() ? 99 : atoi(args[0].c_str());
+  if (!SamplingProfiler::instance().start(hz))
+  {
+    return "not started, " + status();
+  }
+  return status();
+}
+
+string ProfilerInspector::stop(HttpRequest::Method, const Inspector::ArgList&)
+{
+  SamplingProfiler::instance().stop();
+  return status();
+}
+
+string ProfilerInspector::collapsed(HttpRequest::Method, const Inspector::ArgList&)
+{
+  return SamplingProfiler::instance().collapsed();
+}
+
+string ProfilerInspector::reset(HttpRequest::Method, const Inspector::ArgList&)
+{
+  SamplingProfiler::instance().reset();
+  return status();
+}
@@ -134,6 +134,11 @@ void EPollPoller::updateChannel(Channel* channel)
     {
       assert(channels_.find(fd) != channels_.end());
       assert(channels_[fd] == channel);
+      if (channel->isNoneEvent())
+      {
+        // e.g. disableAll() after disableReading(), it would get EPOLLHUP
+        return;
+      }
     }
 
     channel->set_index(kAdded);
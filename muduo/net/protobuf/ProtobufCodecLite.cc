@@ -14,9 +14,19 @@
 #include "muduo/net/TcpConnection.h"
 #include "muduo/net/protorpc/google-inl.h"
 
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/message.h>
+#include <google/protobuf/wire_format_lite.h>
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+#include <google/protobuf/arena.h>
+#endif
 #include <zlib.h>
 
+#include <endian.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -28,6 +38,156 @@ namespace
     return 0;
   }
   int __attribute__ ((unused)) dummy = ProtobufVersionCheck();
+
+  const int kChecksumTypeShift = 28;
+  const uint32_t kLengthMask = (1u << kChecksumTypeShift) - 1;
+  static_assert(ProtobufCodecLite::kMaxMessageLen <= static_cast<int>(kLengthMask),
+                "size field must have spare bits for checksum type");
+
+  uint32_t load32(const char* p)
+  {
+    uint32_t le32 = 0;
+    ::memcpy(&le32, p, sizeof le32);
+    return le32toh(le32);
+  }
+
+  uint32_t rotl32(uint32_t x, int r)
+  {
+    return (x << r) | (x >> (32 - r));
+  }
+
+  // Castagnoli polynomial, reflected
+  const uint32_t kCrc32cPoly = 0x82f63b78;
+
+  struct Crc32cTable
+  {
+    Crc32cTable()
+    {
+      for (uint32_t i = 0; i < 256; ++i)
+      {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; ++j)
+        {
+          crc = (crc >> 1) ^ (-(crc & 1) & kCrc32cPoly);
+        }
+        table[i] = crc;
+      }
+    }
+
+    uint32_t table[256];
+  };
+
+  uint32_t crc32cSoftware(uint32_t crc, const char* buf, size_t len)
+  {
+    static const Crc32cTable t;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buf);
+    for (size_t i = 0; i < len; ++i)
+    {
+      crc = t.table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+  }
+
+#if defined(__x86_64__)
+  __attribute__ ((target("sse4.2")))
+  uint32_t crc32cHardware(uint32_t crc, const char* buf, size_t len)
+  {
+    uint64_t crc64 = crc;
+    while (len >= sizeof(uint64_t))
+    {
+      uint64_t x = 0;
+      ::memcpy(&x, buf, sizeof x);
+      crc64 = _mm_crc32_u64(crc64, x);
+      buf += sizeof x;
+      len -= sizeof x;
+    }
+    uint32_t crc32 = static_cast<uint32_t>(crc64);
+    while (len > 0)
+    {
+      crc32 = _mm_crc32_u8(crc32, static_cast<unsigned char>(*buf));
+      ++buf;
+      --len;
+    }
+    return crc32;
+  }
+
+  bool hasSse42()
+  {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+  }
+#endif
+
+  uint32_t crc32c(const char* buf, size_t len)
+  {
+    uint32_t crc = ~0u;
+#if defined(__x86_64__)
+    static const bool sse42 = hasSse42();
+    if (sse42)
+      crc = crc32cHardware(crc, buf, len);
+    else
+#endif
+    crc = crc32cSoftware(crc, buf, len);
+    return ~crc;
+  }
+
+  // XXH32 with seed 0, see https://github.com/Cyan4973/xxHash
+  const uint32_t kPrime32_1 = 2654435761u;
+  const uint32_t kPrime32_2 = 2246822519u;
+  const uint32_t kPrime32_3 = 3266489917u;
+  const uint32_t kPrime32_4 = 668265263u;
+  const uint32_t kPrime32_5 = 374761393u;
+
+  uint32_t xxh32Round(uint32_t acc, uint32_t input)
+  {
+    return rotl32(acc + input * kPrime32_2, 13) * kPrime32_1;
+  }
+
+  uint32_t xxhash32(const char* buf, size_t len)
+  {
+    const char* p = buf;
+    const char* const end = buf + len;
+    uint32_t h = 0;
+    if (len >= 16)
+    {
+      uint32_t v1 = kPrime32_1 + kPrime32_2;
+      uint32_t v2 = kPrime32_2;
+      uint32_t v3 = 0;
+      uint32_t v4 = 0 - kPrime32_1;
+      do
+      {
+        v1 = xxh32Round(v1, load32(p));
+        v2 = xxh32Round(v2, load32(p + 4));
+        v3 = xxh32Round(v3, load32(p + 8));
+        v4 = xxh32Round(v4, load32(p + 12));
+        p += 16;
+      } while (end - p >= 16);
+      h = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+    }
+    else
+    {
+      h = kPrime32_5;
+    }
+
+    h += static_cast<uint32_t>(len);
+    while (end - p >= 4)
+    {
+      h = rotl32(h + load32(p) * kPrime32_3, 17) * kPrime32_4;
+      p += 4;
+    }
+    while (p < end)
+    {
+      h = rotl32(h + static_cast<unsigned char>(*p) * kPrime32_5, 11) * kPrime32_1;
+      ++p;
+    }
+
+    h ^= h >> 15;
+    h *= kPrime32_2;
+    h ^= h >> 13;
+    h *= kPrime32_3;
+    h ^= h >> 16;
+    return h;
+  }
 }
 
 void ProtobufCodecLite::send(const TcpConnectionPtr& conn,
@@ -39,6 +199,16 @@ void ProtobufCodecLite::send(const TcpConnectionPtr& conn,
   conn->send(&buf);
 }
 
+void ProtobufCodecLite::send(const TcpConnectionPtr& conn,
+                             const ::google::protobuf::Message& message,
+                             int fieldNumber,
+                             const ::google::protobuf::Message& nested)
+{
+  muduo::net::Buffer buf;
+  fillEmptyBuffer(&buf, message, fieldNumber, nested);
+  conn->send(&buf);
+}
+
 void ProtobufCodecLite::fillEmptyBuffer(muduo::net::Buffer* buf,
                                         const google::protobuf::Message& message)
 {
@@ -47,11 +217,47 @@ void ProtobufCodecLite::fillEmptyBuffer(muduo::net::Buffer* buf,
   buf->append(tag_);
 
   int byte_size = serializeToBuffer(message, buf);
+  assert(buf->readableBytes() == tag_.size() + byte_size); (void) byte_size;
+  finishFrame(buf);
+}
+
+void ProtobufCodecLite::fillEmptyBuffer(muduo::net::Buffer* buf,
+                                        const google::protobuf::Message& message,
+                                        int fieldNumber,
+                                        const google::protobuf::Message& nested)
+{
+  using google::protobuf::internal::WireFormatLite;
+  using google::protobuf::io::CodedOutputStream;
+  assert(buf->readableBytes() == 0);
+  buf->append(tag_);
+  serializeToBuffer(message, buf);
+
+  // concatenated fields are merged by parser, see "Merging" of protobuf encoding.
+  GOOGLE_DCHECK(nested.IsInitialized()) << InitializationErrorMessage("serialize", nested);
+  const int byte_size = static_cast<int>(nested.ByteSizeLong());
+  const uint32_t tag = WireFormatLite::MakeTag(fieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  buf->ensureWritableBytes(CodedOutputStream::VarintSize32(tag)
+                           + CodedOutputStream::VarintSize32(static_cast<uint32_t>(byte_size))
+                           + byte_size + kChecksumLen);
+  uint8_t* start = reinterpret_cast<uint8_t*>(buf->beginWrite());
+  uint8_t* p = CodedOutputStream::WriteTagToArray(tag, start);
+  p = CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(byte_size), p);
+  uint8_t* end = nested.SerializeWithCachedSizesToArray(p);
+  if (end - p != byte_size)
+  {
+    ByteSizeConsistencyError(byte_size, static_cast<int>(nested.ByteSizeLong()), static_cast<int>(end - p));
+  }
+  buf->hasWritten(end - start);
+  finishFrame(buf);
+}
 
-  int32_t checkSum = checksum(buf->peek(), static_cast<int>(buf->readableBytes()));
+void ProtobufCodecLite::finishFrame(muduo::net::Buffer* buf) const
+{
+  int32_t checkSum = checksum(checksumType_, buf->peek(), static_cast<int>(buf->readableBytes()));
   buf->appendInt32(checkSum);
-  assert(buf->readableBytes() == tag_.size() + byte_size + kChecksumLen); (void) byte_size;
-  int32_t len = sockets::hostToNetwork32(static_cast<int32_t>(buf->readableBytes()));
+  uint32_t sizeField = static_cast<uint32_t>(buf->readableBytes())
+                       | static_cast<uint32_t>(checksumType_) << kChecksumTypeShift;
+  int32_t len = sockets::hostToNetwork32(static_cast<int32_t>(sizeField));
   buf->prepend(&len, sizeof len);
 }
 
@@ -59,14 +265,24 @@ void ProtobufCodecLite::onMessage(const TcpConnectionPtr& conn,
                                   Buffer* buf,
                                   Timestamp receiveTime)
 {
+  // shared by messages of this call, if useArena_
+  std::shared_ptr<google::protobuf::Arena> arena;
+  MessagePtr message;
   while (buf->readableBytes() >= static_cast<uint32_t>(kMinMessageLen+kHeaderLen))
   {
-    const int32_t len = buf->peekInt32();
+    const uint32_t sizeField = static_cast<uint32_t>(buf->peekInt32());
+    const int32_t len = static_cast<int32_t>(sizeField & kLengthMask);
+    const uint32_t type = sizeField >> kChecksumTypeShift;
     if (len > kMaxMessageLen || len < kMinMessageLen)
     {
       errorCallback_(conn, buf, receiveTime, kInvalidLength);
       break;
     }
+    else if (type >= kNumChecksumTypes || (type == kNoChecksum && !acceptNoChecksum_))
+    {
+      errorCallback_(conn, buf, receiveTime, kUnknownChecksumType);
+      break;
+    }
     else if (buf->readableBytes() >= implicit_cast<size_t>(kHeaderLen+len))
     {
       if (rawCb_ && !rawCb_(conn, StringPiece(buf->peek(), kHeaderLen+len), receiveTime))
@@ -74,9 +290,15 @@ void ProtobufCodecLite::onMessage(const TcpConnectionPtr& conn,
         buf->retrieve(kHeaderLen+len);
         continue;
       }
-      MessagePtr message(prototype_->New());
+      // nobody else holds the previous message, arena itself counts one
+      const long unshared = arena ? 2 : 1;
+      if (!(reuseMessage_ && message && message.use_count() == unshared))
+      {
+        message = newMessage(&arena);
+      }
       // FIXME: can we move deserialization & callback to other thread?
-      ErrorCode errorCode = parse(buf->peek()+kHeaderLen, len, message.get());
+      ErrorCode errorCode = parse(buf->peek()+kHeaderLen, len,
+                                  static_cast<ChecksumType>(type), message.get());
       if (errorCode == kNoError)
       {
         // FIXME: try { } catch (...) { }
@@ -96,6 +318,22 @@ void ProtobufCodecLite::onMessage(const TcpConnectionPtr& conn,
   }
 }
 
+MessagePtr ProtobufCodecLite::newMessage(std::shared_ptr<google::protobuf::Arena>* arena) const
+{
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+  if (useArena_)
+  {
+    if (!*arena)
+    {
+      arena->reset(new google::protobuf::Arena);
+    }
+    // aliasing constructor, the arena lives as long as any message on it.
+    return MessagePtr(*arena, prototype_->New(arena->get()));
+  }
+#endif
+  return MessagePtr(prototype_->New());
+}
+
 bool ProtobufCodecLite::parseFromBuffer(StringPiece buf, google::protobuf::Message* message)
 {
   return message->ParseFromArray(buf.data(), buf.size());
@@ -111,14 +349,14 @@ int ProtobufCodecLite::serializeToBuffer(const google::protobuf::Message& messag
   // code copied from MessageLite::SerializeToArray() and MessageLite::SerializePartialToArray().
   GOOGLE_DCHECK(message.IsInitialized()) << InitializationErrorMessage("serialize", message);
 
-  int byte_size = message.ByteSize();
+  int byte_size = static_cast<int>(message.ByteSizeLong());
   buf->ensureWritableBytes(byte_size + kChecksumLen);
 
   uint8_t* start = reinterpret_cast<uint8_t*>(buf->beginWrite());
   uint8_t* end = message.SerializeWithCachedSizesToArray(start);
   if (end - start != byte_size)
   {
-    ByteSizeConsistencyError(byte_size, message.ByteSize(), static_cast<int>(end - start));
+    ByteSizeConsistencyError(byte_size, static_cast<int>(message.ByteSizeLong()), static_cast<int>(end - start));
   }
   buf->hasWritten(byte_size);
   return byte_size;
@@ -132,6 +370,7 @@ namespace
   const string kInvalidNameLenStr = "InvalidNameLen";
   const string kUnknownMessageTypeStr = "UnknownMessageType";
   const string kParseErrorStr = "ParseError";
+  const string kUnknownChecksumTypeStr = "UnknownChecksumType";
   const string kUnknownErrorStr = "UnknownError";
 }
 
@@ -151,6 +390,8 @@ const string& ProtobufCodecLite::errorCodeToString(ErrorCode errorCode)
      return kUnknownMessageTypeStr;
    case kParseError:
      return kParseErrorStr;
+   case kUnknownChecksumType:
+     return kUnknownChecksumTypeStr;
    default:
      return kUnknownErrorStr;
   }
@@ -175,27 +416,57 @@ int32_t ProtobufCodecLite::asInt32(const char* buf)
   return sockets::networkToHost32(be32);
 }
 
-int32_t ProtobufCodecLite::checksum(const void* buf, int len)
+int32_t ProtobufCodecLite::checksum(ChecksumType type, const void* buf, int len)
 {
-  return static_cast<int32_t>(
-      ::adler32(1, static_cast<const Bytef*>(buf), len));
+  switch (type)
+  {
+   case kAdler32:
+     return static_cast<int32_t>(
+         ::adler32(1, static_cast<const Bytef*>(buf), len));
+   case kCrc32c:
+     return static_cast<int32_t>(
+         crc32c(static_cast<const char*>(buf), static_cast<size_t>(len)));
+   case kXxHash32:
+     return static_cast<int32_t>(
+         xxhash32(static_cast<const char*>(buf), static_cast<size_t>(len)));
+   default:
+     return 0;
+  }
 }
 
-bool ProtobufCodecLite::validateChecksum(const char* buf, int len)
+bool ProtobufCodecLite::validateChecksum(ChecksumType type, const char* buf, int len)
 {
   // check sum
   int32_t expectedCheckSum = asInt32(buf + len - kChecksumLen);
-  int32_t checkSum = checksum(buf, len - kChecksumLen);
+  int32_t checkSum = checksum(type, buf, len - kChecksumLen);
   return checkSum == expectedCheckSum;
 }
 
+const char* ProtobufCodecLite::checksumTypeToString(ChecksumType type)
+{
+  switch (type)
+  {
+   case kAdler32:
+     return "adler32";
+   case kCrc32c:
+     return "crc32c";
+   case kXxHash32:
+     return "xxhash32";
+   case kNoChecksum:
+     return "none";
+   default:
+     return "unknown";
+  }
+}
+
 ProtobufCodecLite::ErrorCode ProtobufCodecLite::parse(const char* buf,
                                                       int len,
+                                                      ChecksumType type,
                                                       ::google::protobuf::Message* message)
 {
   ErrorCode error = kNoError;
 
-  if (validateChecksum(buf, len))
+  if (validateChecksum(type, buf, len))
   {
     if (memcmp(buf, tag_.data(), tag_.size()) == 0)
     {
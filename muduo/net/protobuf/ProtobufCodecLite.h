@@ -26,6 +26,7 @@ namespace google
 {
 namespace protobuf
 {
+class Arena;
 class Message;
 }
 }
@@ -41,10 +42,15 @@ typedef std::shared_ptr<google::protobuf::Message> MessagePtr;
 //
 // Field     Length  Content
 //
-// size      4-byte  M+N+4
+// size      4-byte  M+N+4, highest 4 bits are the checksum type
 // tag       M-byte  could be "RPC0", etc.
 // payload   N-byte
-// checksum  4-byte  adler32 of tag+payload
+// checksum  4-byte  of tag+payload
+//
+// M+N+4 never exceeds kMaxMessageLen, so the highest 4 bits of size are
+// zero in frames from old versions, which means adler32. Frames with other
+// checksum types are rejected as kInvalidLength by old versions, so upgrade
+// both ends before choosing another one with setChecksumType().
 //
 // This is an internal class, you should use ProtobufCodecT instead.
 class ProtobufCodecLite : noncopyable
@@ -62,6 +68,17 @@ class ProtobufCodecLite : noncopyable
     kInvalidNameLen,
     kUnknownMessageType,
     kParseError,
+    kUnknownChecksumType,
+  };
+
+  // stored in highest 4 bits of size field
+  enum ChecksumType
+  {
+    kAdler32 = 0,
+    kCrc32c = 1,  // SSE4.2 crc32 instruction if available
+    kXxHash32 = 2,
+    kNoChecksum = 3,  // all zeros, for trusted links only
+    kNumChecksumTypes
   };
 
   // return false to stop parsing protobuf message
@@ -88,6 +105,10 @@ class ProtobufCodecLite : noncopyable
       messageCallback_(messageCb),
       rawCb_(rawCb),
       errorCallback_(errorCb),
+      useArena_(false),
+      reuseMessage_(false),
+      checksumType_(kAdler32),
+      acceptNoChecksum_(false),
       kMinMessageLen(tagArg.size() + kChecksumLen)
   {
   }
@@ -96,9 +117,39 @@ class ProtobufCodecLite : noncopyable
 
   const string& tag() const { return tag_; }
 
+  /// Allocates messages decoded in one onMessage() call on a protobuf Arena,
+  /// which is freed along with the last of those messages.
+  /// Not thread safe, must be called before receiving any message.
+  void setUseArena(bool on) { useArena_ = on; }
+
+  /// Reuses the message object for the next frame of one onMessage() call,
+  /// if messageCallback doesn't keep any reference to it.
+  /// Not thread safe, must be called before receiving any message.
+  void setReuseMessage(bool on) { reuseMessage_ = on; }
+
+  /// Checksum of outgoing frames, default kAdler32.
+  /// Incoming frames are verified by the type in their own header,
+  /// so each direction of a connection can choose its own.
+  /// Not thread safe, must be called before sending any message.
+  void setChecksumType(ChecksumType type) { checksumType_ = type; }
+  ChecksumType checksumType() const { return checksumType_; }
+
+  /// Accepts incoming frames of kNoChecksum, default false.
+  /// Not thread safe, must be called before receiving any message.
+  void setAcceptNoChecksum(bool on) { acceptNoChecksum_ = on; }
+
   void send(const TcpConnectionPtr& conn,
             const ::google::protobuf::Message& message);
 
+  /// Sends message with nested as its length-delimited field of fieldNumber,
+  /// same as setting a bytes field to nested.SerializeAsString(),
+  /// but serializes nested only once, without the temporary string.
+  /// The field must not be set in message.
+  void send(const TcpConnectionPtr& conn,
+            const ::google::protobuf::Message& message,
+            int fieldNumber,
+            const ::google::protobuf::Message& nested);
+
   void onMessage(const TcpConnectionPtr& conn,
                  Buffer* buf,
                  Timestamp receiveTime);
@@ -109,11 +160,25 @@ class ProtobufCodecLite : noncopyable
   static const string& errorCodeToString(ErrorCode errorCode);
 
   // public for unit tests
-  ErrorCode parse(const char* buf, int len, ::google::protobuf::Message* message);
+  ErrorCode parse(const char* buf, int len, ::google::protobuf::Message* message)
+  { return parse(buf, len, kAdler32, message); }
+  ErrorCode parse(const char* buf, int len, ChecksumType type,
+                  ::google::protobuf::Message* message);
   void fillEmptyBuffer(muduo::net::Buffer* buf, const google::protobuf::Message& message);
-
-  static int32_t checksum(const void* buf, int len);
-  static bool validateChecksum(const char* buf, int len);
+  void fillEmptyBuffer(muduo::net::Buffer* buf,
+                       const google::protobuf::Message& message,
+                       int fieldNumber,
+                       const google::protobuf::Message& nested);
+
+  // adler32
+  static int32_t checksum(const void* buf, int len)
+  { return checksum(kAdler32, buf, len); }
+  static bool validateChecksum(const char* buf, int len)
+  { return validateChecksum(kAdler32, buf, len); }
+
+  static int32_t checksum(ChecksumType type, const void* buf, int len);
+  static bool validateChecksum(ChecksumType type, const char* buf, int len);
+  static const char* checksumTypeToString(ChecksumType type);
   static int32_t asInt32(const char* buf);
   static void defaultErrorCallback(const TcpConnectionPtr&,
                                    Buffer*,
@@ -121,11 +186,18 @@ class ProtobufCodecLite : noncopyable
                                    ErrorCode);
 
  private:
+  MessagePtr newMessage(std::shared_ptr<::google::protobuf::Arena>* arena) const;
+  void finishFrame(muduo::net::Buffer* buf) const;
+
   const ::google::protobuf::Message* prototype_;
   const string tag_;
   ProtobufMessageCallback messageCallback_;
   RawMessageCallback rawCb_;
   ErrorCallback errorCallback_;
+  bool useArena_;
+  bool reuseMessage_;
+  ChecksumType checksumType_;
+  bool acceptNoChecksum_;
   const int kMinMessageLen;
 };
 
@@ -155,6 +227,11 @@ class ProtobufCodecLiteT
 
   const string& tag() const { return codec_.tag(); }
 
+  void setUseArena(bool on) { codec_.setUseArena(on); }
+  void setReuseMessage(bool on) { codec_.setReuseMessage(on); }
+  void setChecksumType(ProtobufCodecLite::ChecksumType type) { codec_.setChecksumType(type); }
+  void setAcceptNoChecksum(bool on) { codec_.setAcceptNoChecksum(on); }
+
   void send(const TcpConnectionPtr& conn,
             const MSG& message)
   {
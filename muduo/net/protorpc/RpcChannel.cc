@@ -9,37 +9,203 @@
 #include "muduo/net/protorpc/RpcChannel.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/base/ThreadPool.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
 #include "muduo/net/protorpc/rpc.pb.h"
 
 #include <google/protobuf/descriptor.h>
 
+#include <unordered_map>
+#include <vector>
+
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+ErrorCode findMethod(const RpcMessage& message,
+                     const std::map<std::string, google::protobuf::Service*>* services,
+                     const RpcChannel::MethodTable* methods,
+                     google::protobuf::Service** service,
+                     const google::protobuf::MethodDescriptor** method,
+                     const RpcChannel::MethodEntry** entry)
+{
+  if (message.has_method_id() && methods)
+  {
+    const RpcChannel::MethodEntry* found = methods->find(message.method_id());
+    if (found)
+    {
+      *service = found->service;
+      *method = found->method;
+      *entry = found;
+      return NO_ERROR;
+    }
+    else if (!message.has_service())
+    {
+      return NO_METHOD;
+    }
+  }
+
+  if (!services)
+  {
+    return NO_SERVICE;
+  }
+  std::map<std::string, google::protobuf::Service*>::const_iterator it = services->find(message.service());
+  if (it == services->end())
+  {
+    return NO_SERVICE;
+  }
+  assert(it->second != NULL);
+  *service = it->second;
+  *method = it->second->GetDescriptor()->FindMethodByName(message.method());
+  if (*method == NULL)
+  {
+    return NO_METHOD;
+  }
+  if (methods)
+  {
+    // for execution policy
+    const RpcChannel::MethodEntry* found = methods->find(RpcChannel::methodId(*method));
+    if (found && found->method == *method)
+    {
+      *entry = found;
+    }
+  }
+  return NO_ERROR;
+}
+
+}  // namespace
+
+// Outstanding calls, sharded by id to spread lock contention
+// of many threads calling on one channel.
+class RpcChannel::CallTable : noncopyable
+{
+ public:
+  static const int kNumShards = 16;
+
+  void insert(int64_t id, const OutstandingCall& out)
+  {
+    Shard& s = shard(id);
+    MutexLockGuard lock(s.mutex);
+    s.calls[id] = out;
+  }
+
+  void setTimer(int64_t id, EventLoop* loop, TimerId timer)
+  {
+    Shard& s = shard(id);
+    MutexLockGuard lock(s.mutex);
+    std::unordered_map<int64_t, OutstandingCall>::iterator it = s.calls.find(id);
+    if (it != s.calls.end())
+    {
+      it->second.loop = loop;
+      it->second.timer = timer;
+    }
+  }
+
+  // return false if not found
+  bool take(int64_t id, OutstandingCall* out)
+  {
+    Shard& s = shard(id);
+    MutexLockGuard lock(s.mutex);
+    std::unordered_map<int64_t, OutstandingCall>::iterator it = s.calls.find(id);
+    if (it == s.calls.end())
+    {
+      return false;
+    }
+    *out = it->second;
+    s.calls.erase(it);
+    return true;
+  }
+
+  void takeAll(std::vector<OutstandingCall>* outs)
+  {
+    for (Shard& s : shards_)
+    {
+      MutexLockGuard lock(s.mutex);
+      for (const auto& call : s.calls)
+      {
+        outs->push_back(call.second);
+      }
+      s.calls.clear();
+    }
+  }
+
+  size_t size() const
+  {
+    size_t n = 0;
+    for (const Shard& s : shards_)
+    {
+      MutexLockGuard lock(s.mutex);
+      n += s.calls.size();
+    }
+    return n;
+  }
+
+ private:
+  struct Shard
+  {
+    mutable MutexLock mutex;
+    std::unordered_map<int64_t, OutstandingCall> calls GUARDED_BY(mutex);
+  };
+
+  Shard& shard(int64_t id)
+  {
+    return shards_[static_cast<uint64_t>(id) % kNumShards];
+  }
+
+  Shard shards_[kNumShards];
+};
+
 RpcChannel::RpcChannel()
-  : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
-    services_(NULL)
+  : codec_(std::make_shared<RpcEnvelopeCodec>(
+        std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3))),
+    callTimeout_(0.0),
+    calls_(new CallTable),
+    services_(NULL),
+    methods_(NULL),
+    streams_(NULL),
+    streamHighWaterMark_(4 * 1024 * 1024),
+    streamCallbacksInstalled_(false),
+    streamsBlocked_(false)
 {
   LOG_INFO << "RpcChannel::ctor - " << this;
+  // onRpcMessage() never keeps the message
+  codec_->setReuseMessage(true);
 }
 
 RpcChannel::RpcChannel(const TcpConnectionPtr& conn)
-  : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
+  : codec_(std::make_shared<RpcEnvelopeCodec>(
+        std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3))),
     conn_(conn),
-    services_(NULL)
+    callTimeout_(0.0),
+    calls_(new CallTable),
+    services_(NULL),
+    methods_(NULL),
+    streams_(NULL),
+    streamHighWaterMark_(4 * 1024 * 1024),
+    streamCallbacksInstalled_(false),
+    streamsBlocked_(false)
 {
   LOG_INFO << "RpcChannel::ctor - " << this;
+  // onRpcMessage() never keeps the message
+  codec_->setReuseMessage(true);
 }
 
 RpcChannel::~RpcChannel()
 {
   LOG_INFO << "RpcChannel::dtor - " << this;
-  for (const auto& outstanding : outstandings_)
+  // pending timers hold weak pointers of calls_, no need to cancel them.
+  std::vector<OutstandingCall> outs;
+  calls_->takeAll(&outs);
+  for (const OutstandingCall& out : outs)
   {
-    OutstandingCall out = outstanding.second;
     delete out.response;
     delete out.done;
   }
+  closeAllStreams("CANCELED");
 }
 
   // Call the given method of the remote service.  The signature of this
@@ -52,133 +218,446 @@ void RpcChannel::CallMethod(const ::google::protobuf::MethodDescriptor* method,
                             const ::google::protobuf::Message* request,
                             ::google::protobuf::Message* response,
                             ::google::protobuf::Closure* done)
+{
+  call(method, controller, request, response, done, callTimeout_);
+}
+
+uint32_t RpcChannel::methodId(const ::google::protobuf::MethodDescriptor* method)
+{
+  const std::string& name = method->full_name();
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < name.size(); ++i)
+  {
+    hash ^= static_cast<unsigned char>(name[i]);
+    hash *= 16777619u;
+  }
+  return hash ? hash : 1;
+}
+
+int64_t RpcChannel::call(const ::google::protobuf::MethodDescriptor* method,
+                         google::protobuf::RpcController* controller,
+                         const ::google::protobuf::Message* request,
+                         ::google::protobuf::Message* response,
+                         ::google::protobuf::Closure* done,
+                         double timeout)
 {
   RpcMessage message;
   message.set_type(REQUEST);
   int64_t id = id_.incrementAndGet();
   message.set_id(id);
+  message.set_method_id(methodId(method));
   message.set_service(method->service()->full_name());
   message.set_method(method->name());
-  message.set_request(request->SerializeAsString()); // FIXME: error check
 
-  OutstandingCall out = { response, done };
+  OutstandingCall out = { response, done, controller, NULL, TimerId() };
+  calls_->insert(id, out);
+  if (timeout > 0)
+  {
+    // insert before starting timer, so it never misses the call.
+    EventLoop* loop = conn_->getLoop();
+    std::weak_ptr<CallTable> weakCalls(calls_);
+    TimerId timer = loop->runAfter(timeout, [weakCalls, id] { onCallTimeout(weakCalls, id); });
+    calls_->setTimer(id, loop, timer);
+  }
+  // checks after insert, cancelAll() of closing connection runs after state changed.
+  if (!conn_->connected())
+  {
+    failCall(id, "UNAVAILABLE");
+    return id;
+  }
+  codec_->send(conn_, message, RpcMessage::kRequestFieldNumber, *request);
+  return id;
+}
+
+bool RpcChannel::cancel(int64_t id)
+{
+  return failCall(id, "CANCELED");
+}
+
+void RpcChannel::cancelAll()
+{
+  std::vector<OutstandingCall> outs;
+  calls_->takeAll(&outs);
+  for (const OutstandingCall& out : outs)
+  {
+    if (out.loop)
+    {
+      out.loop->cancel(out.timer);
+    }
+    finishCall(out, "CANCELED");
+  }
+  closeAllStreams("CANCELED");
+}
+
+bool RpcChannel::failCall(int64_t id, const string& failure)
+{
+  OutstandingCall out;
+  if (!calls_->take(id, &out))
+  {
+    return false;
+  }
+  if (out.loop)
+  {
+    out.loop->cancel(out.timer);
+  }
+  finishCall(out, failure);
+  return true;
+}
+
+size_t RpcChannel::numOutstandingCalls() const
+{
+  return calls_->size();
+}
+
+void RpcChannel::onCallTimeout(const std::weak_ptr<CallTable>& weakCalls, int64_t id)
+{
+  CallTablePtr calls(weakCalls.lock());
+  OutstandingCall out;
+  if (calls && calls->take(id, &out))
+  {
+    LOG_WARN << "RpcChannel::onCallTimeout - id " << id;
+    finishCall(out, ErrorCode_Name(TIMEOUT));
+  }
+}
+
+void RpcChannel::finishCall(const OutstandingCall& out, const string& failure)
+{
+  std::unique_ptr<google::protobuf::Message> d(out.response);
+  if (out.controller && !failure.empty())
+  {
+    out.controller->SetFailed(failure);
+  }
+  if (out.done)
   {
-  MutexLockGuard lock(mutex_);
-  outstandings_[id] = out;
+    out.done->Run();
   }
-  codec_.send(conn_, message);
 }
 
 void RpcChannel::onMessage(const TcpConnectionPtr& conn,
                            Buffer* buf,
                            Timestamp receiveTime)
 {
-  codec_.onMessage(conn, buf, receiveTime);
+  codec_->onMessage(conn, buf, receiveTime);
 }
 
 void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
-                              const RpcMessagePtr& messagePtr,
+                              const MessagePtr& messagePtr,
                               Timestamp receiveTime)
 {
   assert(conn == conn_);
   //printf("%s\n", message.DebugString().c_str());
-  RpcMessage& message = *messagePtr;
+  const RpcMessage& message = static_cast<const RpcMessage&>(*messagePtr);
+  // request or response, in conn's input buffer
+  const StringPiece payload = codec_->payload();
   if (message.type() == RESPONSE)
   {
     int64_t id = message.id();
-    assert(message.has_response() || message.has_error());
-
-    OutstandingCall out = { NULL, NULL };
+    assert(payload.data() != NULL || message.has_error());
 
+    OutstandingCall out;
+    // not found if timed out or canceled
+    if (calls_->take(id, &out))
     {
-      MutexLockGuard lock(mutex_);
-      std::map<int64_t, OutstandingCall>::iterator it = outstandings_.find(id);
-      if (it != outstandings_.end())
+      if (out.loop)
+      {
+        out.loop->cancel(out.timer);
+      }
+      if (payload.data() != NULL)
       {
-        out = it->second;
-        outstandings_.erase(it);
+        out.response->ParseFromArray(payload.data(), payload.size());
       }
+      finishCall(out, message.has_error() && message.error() != NO_ERROR
+                      ? ErrorCode_Name(message.error()) : string());
     }
-
-    if (out.response)
+  }
+  else if (message.type() == REQUEST)
+  {
+    google::protobuf::Service* service = NULL;
+    const google::protobuf::MethodDescriptor* method = NULL;
+    const MethodEntry* entry = NULL;
+    ErrorCode error = findMethod(message, services_, methods_, &service, &method, &entry);
+    ReplyTo replyTo = { static_cast<int64_t>(message.id()), codec_, conn_,
+                        std::shared_ptr<AtomicInt32>() };
+    if (error == NO_ERROR && entry && entry->maxConcurrency > 0)
     {
-      std::unique_ptr<google::protobuf::Message> d(out.response);
-      if (message.has_response())
+      // fail fast instead of queueing without bound
+      if (entry->concurrency->incrementAndGet() > entry->maxConcurrency)
       {
-        out.response->ParseFromString(message.response());
+        entry->concurrency->decrement();
+        error = OVERLOADED;
       }
-      if (out.done)
+      else
       {
-        out.done->Run();
+        replyTo.concurrency = entry->concurrency;
       }
     }
-  }
-  else if (message.type() == REQUEST)
-  {
-    // FIXME: extract to a function
-    ErrorCode error = WRONG_PROTO;
-    if (services_)
+    if (error == NO_ERROR)
     {
-      std::map<std::string, google::protobuf::Service*>::const_iterator it = services_->find(message.service());
-      if (it != services_->end())
+      std::shared_ptr<google::protobuf::Message> request(service->GetRequestPrototype(method).New());
+      // parse in I/O thread, payload is in input buffer
+      if (request->ParseFromArray(payload.data(), payload.size()))
       {
-        google::protobuf::Service* service = it->second;
-        assert(service != NULL);
-        const google::protobuf::ServiceDescriptor* desc = service->GetDescriptor();
-        const google::protobuf::MethodDescriptor* method
-          = desc->FindMethodByName(message.method());
-        if (method)
+        // response is deleted in doneCallback
+        google::protobuf::Message* response = service->GetResponsePrototype(method).New();
+        if (entry && entry->pool)
         {
-          std::unique_ptr<google::protobuf::Message> request(service->GetRequestPrototype(method).New());
-          if (request->ParseFromString(message.request()))
-          {
-            google::protobuf::Message* response = service->GetResponsePrototype(method).New();
-            // response is deleted in doneCallback
-            int64_t id = message.id();
-            service->CallMethod(method, NULL, get_pointer(request), response,
-                                NewCallback(this, &RpcChannel::doneCallback, response, id));
-            error = NO_ERROR;
-          }
-          else
+          // never blocks the I/O thread, a full queue of pool fails the request
+          if (!entry->pool->tryRun([service, method, request, response, replyTo]
+                                   { callService(service, method, request, response, replyTo); }))
           {
-            error = INVALID_REQUEST;
+            delete response;
+            error = OVERLOADED;
           }
         }
         else
         {
-          error = NO_METHOD;
+          callService(service, method, request, response, replyTo);
         }
       }
       else
       {
-        error = NO_SERVICE;
+        error = INVALID_REQUEST;
+      }
+      if (error != NO_ERROR && replyTo.concurrency)
+      {
+        replyTo.concurrency->decrement();
       }
-    }
-    else
-    {
-      error = NO_SERVICE;
     }
     if (error != NO_ERROR)
     {
       RpcMessage response;
       response.set_type(RESPONSE);
-      response.set_id(message.id());
+      response.set_id(replyTo.id);
       response.set_error(error);
-      codec_.send(conn_, response);
+      codec_->send(conn_, response);
     }
   }
+  else if (message.type() == STREAM || message.type() == STREAM_REPLY)
+  {
+    onStreamFrame(message);
+  }
   else if (message.type() == ERROR)
   {
   }
 }
 
-void RpcChannel::doneCallback(::google::protobuf::Message* response, int64_t id)
+void RpcChannel::callService(google::protobuf::Service* service,
+                             const google::protobuf::MethodDescriptor* method,
+                             const std::shared_ptr<google::protobuf::Message>& request,
+                             google::protobuf::Message* response,
+                             const ReplyTo& replyTo)
+{
+  service->CallMethod(method, NULL, get_pointer(request), response,
+                      NewCallback(&RpcChannel::doneCallback, response, replyTo));
+}
+
+void RpcChannel::doneCallback(::google::protobuf::Message* response, ReplyTo replyTo)
 {
   std::unique_ptr<google::protobuf::Message> d(response);
+  if (replyTo.concurrency)
+  {
+    replyTo.concurrency->decrement();
+  }
   RpcMessage message;
   message.set_type(RESPONSE);
-  message.set_id(id);
-  message.set_response(response->SerializeAsString()); // FIXME: error check
-  codec_.send(conn_, message);
+  message.set_id(replyTo.id);
+  replyTo.codec->send(replyTo.conn, message, RpcMessage::kResponseFieldNumber, *response);
 }
 
+
+RpcStreamPtr RpcChannel::newStream(const ::google::protobuf::MethodDescriptor* method)
+{
+  assert(conn_);
+  return std::make_shared<RpcStream>(shared_from_this(), conn_->getLoop(),
+                                     id_.incrementAndGet(), method, true);
+}
+
+size_t RpcChannel::numStreams() const
+{
+  MutexLockGuard lock(streamMutex_);
+  return openedStreams_.size() + acceptedStreams_.size();
+}
+
+bool RpcChannel::attachStream(const RpcStreamPtr& stream)
+{
+  conn_->getLoop()->assertInLoopThread();
+  if (!conn_->connected())
+  {
+    return false;
+  }
+  installStreamCallbacks();
+  {
+  MutexLockGuard lock(streamMutex_);
+  openedStreams_[stream->id()] = stream;
+  }
+  if (streamsBlocked_)
+  {
+    stream->setBlocked(true);
+  }
+  return true;
+}
+
+RpcStreamPtr RpcChannel::acceptStream(const RpcMessage& message)
+{
+  const StreamEntry* entry = streams_ ? streams_->find(message.method_id()) : NULL;
+  if (entry == NULL)
+  {
+    if (!message.has_error())
+    {
+      RpcMessage reply;
+      reply.set_type(STREAM_REPLY);
+      reply.set_id(message.id());
+      reply.set_error(NO_METHOD);
+      codec_->send(conn_, reply);
+    }
+    return RpcStreamPtr();
+  }
+
+  installStreamCallbacks();
+  int64_t id = static_cast<int64_t>(message.id());
+  RpcStreamPtr stream(std::make_shared<RpcStream>(shared_from_this(), conn_->getLoop(),
+                                                  id, entry->method, false));
+  {
+  MutexLockGuard lock(streamMutex_);
+  acceptedStreams_[id] = stream;
+  }
+  if (streamsBlocked_)
+  {
+    stream->setBlocked(true);
+  }
+  entry->callback(stream);
+  return stream;
+}
+
+void RpcChannel::removeStream(const RpcStreamPtr& stream)
+{
+  MutexLockGuard lock(streamMutex_);
+  std::unordered_map<int64_t, RpcStreamPtr>& streams =
+    stream->isOpener() ? openedStreams_ : acceptedStreams_;
+  std::unordered_map<int64_t, RpcStreamPtr>::iterator it = streams.find(stream->id());
+  if (it != streams.end() && it->second == stream)
+  {
+    streams.erase(it);
+  }
+}
+
+void RpcChannel::sendStreamFrame(const RpcMessage& frame)
+{
+  codec_->send(conn_, frame);
+}
+
+void RpcChannel::onStreamFrame(const RpcMessage& frame)
+{
+  // STREAM is sent by the opener, so this side accepted it.
+  bool accepted = frame.type() == STREAM;
+  int64_t id = static_cast<int64_t>(frame.id());
+  RpcStreamPtr stream;
+  {
+  MutexLockGuard lock(streamMutex_);
+  std::unordered_map<int64_t, RpcStreamPtr>& streams =
+    accepted ? acceptedStreams_ : openedStreams_;
+  std::unordered_map<int64_t, RpcStreamPtr>::iterator it = streams.find(id);
+  if (it != streams.end())
+  {
+    stream = it->second;
+  }
+  }
+  if (!stream && accepted && frame.has_method_id())
+  {
+    stream = acceptStream(frame);
+  }
+  // otherwise, late frames of a closed stream
+  if (stream)
+  {
+    stream->onFrame(frame);
+  }
+}
+
+void RpcChannel::installStreamCallbacks()
+{
+  if (!streamCallbacksInstalled_)
+  {
+    streamCallbacksInstalled_ = true;
+    // conn_ holds them, which must not hold this.
+    std::weak_ptr<RpcChannel> weakSelf(shared_from_this());
+    conn_->setHighWaterMarkCallback(
+        std::bind(&RpcChannel::onHighWaterMark, weakSelf, _1, _2), streamHighWaterMark_);
+    conn_->setWriteCompleteCallback(
+        std::bind(&RpcChannel::onWriteComplete, weakSelf, _1));
+  }
+}
+
+void RpcChannel::setStreamsBlocked(bool blocked)
+{
+  streamsBlocked_ = blocked;
+  std::vector<RpcStreamPtr> streams;
+  {
+  MutexLockGuard lock(streamMutex_);
+  streams.reserve(openedStreams_.size() + acceptedStreams_.size());
+  for (const auto& s : openedStreams_)
+  {
+    streams.push_back(s.second);
+  }
+  for (const auto& s : acceptedStreams_)
+  {
+    streams.push_back(s.second);
+  }
+  }
+  for (const RpcStreamPtr& stream : streams)
+  {
+    stream->setBlocked(blocked);
+  }
+}
+
+void RpcChannel::onHighWaterMark(const std::weak_ptr<RpcChannel>& weakSelf,
+                                 const TcpConnectionPtr& conn,
+                                 size_t len)
+{
+  RpcChannelPtr channel(weakSelf.lock());
+  if (channel && !channel->streamsBlocked_)
+  {
+    LOG_DEBUG << "RpcChannel::onHighWaterMark - " << conn->name() << " " << len;
+    channel->setStreamsBlocked(true);
+  }
+}
+
+void RpcChannel::onWriteComplete(const std::weak_ptr<RpcChannel>& weakSelf,
+                                 const TcpConnectionPtr& conn)
+{
+  RpcChannelPtr channel(weakSelf.lock());
+  // every send() completed in one go ends up here, so keep it cheap.
+  if (channel && channel->streamsBlocked_)
+  {
+    channel->setStreamsBlocked(false);
+  }
+}
+
+void RpcChannel::closeAllStreams(const string& reason)
+{
+  std::unordered_map<int64_t, RpcStreamPtr> opened;
+  std::unordered_map<int64_t, RpcStreamPtr> accepted;
+  {
+  MutexLockGuard lock(streamMutex_);
+  opened.swap(openedStreams_);
+  accepted.swap(acceptedStreams_);
+  }
+  if (!opened.empty() || !accepted.empty())
+  {
+    std::vector<RpcStreamPtr> streams;
+    for (const auto& s : opened)
+    {
+      streams.push_back(s.second);
+    }
+    for (const auto& s : accepted)
+    {
+      streams.push_back(s.second);
+    }
+    conn_->getLoop()->runInLoop([streams, reason]
+      {
+        for (const RpcStreamPtr& stream : streams)
+        {
+          stream->abort(reason);
+        }
+      });
+  }
+}
@@ -13,11 +13,15 @@
 
 #include "muduo/base/Atomic.h"
 #include "muduo/base/Mutex.h"
+#include "muduo/net/TimerId.h"
 #include "muduo/net/protorpc/RpcCodec.h"
+#include "muduo/net/protorpc/RpcStream.h"
 
 #include <google/protobuf/service.h>
 
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 // Service and RpcChannel classes are incorporated from
 // google/protobuf/service.h
@@ -76,9 +80,14 @@ class Service;
 
 namespace muduo
 {
+
+class ThreadPool;
+
 namespace net
 {
 
+class EventLoop;
+
 // Abstract interface for an RPC channel.  An RpcChannel represents a
 // communication line to a Service which can be used to call that Service's
 // methods.  The Service may be running on another machine.  Normally, you
@@ -88,9 +97,138 @@ namespace net
 //   RpcChannel* channel = new MyRpcChannel("remotehost.example.com:1234");
 //   MyService* service = new MyService::Stub(channel);
 //   service->MyMethod(request, &response, callback);
-class RpcChannel : public ::google::protobuf::RpcChannel
+class RpcChannel;
+typedef std::shared_ptr<RpcChannel> RpcChannelPtr;
+
+/// Entries of RpcChannel by method id, see RpcChannel::methodId().
+///
+/// A flat array of slots indexed by the low bits of id, with linear probing,
+/// at most half of the slots are used, so a lookup takes one or two probes.
+/// Entry must have a uint32_t id.
+template<typename Entry>
+class RpcIdTable
 {
  public:
+  typedef typename std::vector<Entry>::iterator iterator;
+  typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+  RpcIdTable()
+    : mask_(0)
+  {
+  }
+
+  /// NULL if not found.
+  const Entry* find(uint32_t id) const
+  {
+    if (slots_.empty())
+    {
+      return NULL;
+    }
+    for (uint32_t i = id & mask_; ; i = (i + 1) & mask_)
+    {
+      int index = slots_[i];
+      if (index < 0)
+      {
+        return NULL;
+      }
+      if (entries_[index].id == id)
+      {
+        return &entries_[index];
+      }
+    }
+  }
+
+  Entry* find(uint32_t id)
+  {
+    return const_cast<Entry*>(static_cast<const RpcIdTable*>(this)->find(id));
+  }
+
+  /// Replaces the entry of the same id.
+  /// Pointers of entries are invalidated.
+  void insert(const Entry& entry)
+  {
+    Entry* old = find(entry.id);
+    if (old)
+    {
+      *old = entry;
+      return;
+    }
+    entries_.push_back(entry);
+    if (entries_.size() * 2 > slots_.size())
+    {
+      rehash();
+    }
+    else
+    {
+      place(entries_.size() - 1);
+    }
+  }
+
+  size_t size() const { return entries_.size(); }
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+ private:
+  void rehash()
+  {
+    size_t n = 8;
+    while (n < entries_.size() * 2)
+    {
+      n *= 2;
+    }
+    slots_.assign(n, -1);
+    mask_ = static_cast<uint32_t>(n - 1);
+    for (size_t index = 0; index < entries_.size(); ++index)
+    {
+      place(index);
+    }
+  }
+
+  void place(size_t index)
+  {
+    uint32_t i = entries_[index].id & mask_;
+    while (slots_[i] >= 0)
+    {
+      i = (i + 1) & mask_;
+    }
+    slots_[i] = static_cast<int>(index);
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<int> slots_;  // index of entries_, -1 for empty
+  uint32_t mask_;
+};
+
+class RpcChannel : public ::google::protobuf::RpcChannel,
+                   public std::enable_shared_from_this<RpcChannel>
+{
+ public:
+  struct MethodEntry
+  {
+    uint32_t id;
+    ::google::protobuf::Service* service;
+    const ::google::protobuf::MethodDescriptor* method;
+    // runs in I/O thread if NULL, see RpcServer::setExecutionPolicy()
+    ThreadPool* pool;
+    int maxConcurrency;  // 0 for unlimited
+    std::shared_ptr<AtomicInt32> concurrency;  // running and queued requests
+  };
+  typedef RpcIdTable<MethodEntry> MethodTable;
+
+  /// Called in I/O thread when peer opens a stream,
+  /// sets callbacks of the stream, see RpcServer::registerStream().
+  typedef std::function<void (const RpcStreamPtr&)> StreamCallback;
+
+  struct StreamEntry
+  {
+    uint32_t id;
+    const ::google::protobuf::MethodDescriptor* method;
+    StreamCallback callback;
+  };
+  typedef RpcIdTable<StreamEntry> StreamTable;
+
   RpcChannel();
 
   explicit RpcChannel(const TcpConnectionPtr& conn);
@@ -107,6 +245,33 @@ class RpcChannel : public ::google::protobuf::RpcChannel
     services_ = services;
   }
 
+  /// Dispatches requests by method_id, instead of service and method names,
+  /// and applies execution policies.
+  /// methods must not change while the channel is in use.
+  void setMethods(const MethodTable* methods)
+  {
+    methods_ = methods;
+  }
+
+  /// Accepts streams opened by peer.
+  void setStreams(const StreamTable* streams)
+  {
+    streams_ = streams;
+  }
+
+  /// Stable id of method, FNV-1a hash of its full name, never 0.
+  /// Requests carry it along with service and method names, servers
+  /// dispatch by it if they know it, by the names otherwise, so proxies
+  /// may forward requests to servers of any version.
+  static uint32_t methodId(const ::google::protobuf::MethodDescriptor* method);
+
+  /// Default timeout of CallMethod(), in seconds, 0 for none.
+  /// A timed out call fails its controller with "TIMEOUT", and runs done.
+  void setCallTimeout(double seconds)
+  {
+    callTimeout_ = seconds;
+  }
+
   // Call the given method of the remote service.  The signature of this
   // procedure looks the same as Service::CallMethod(), but the requirements
   // are less strict in one important way:  the request and response objects
@@ -118,33 +283,123 @@ class RpcChannel : public ::google::protobuf::RpcChannel
                   ::google::protobuf::Message* response,
                   ::google::protobuf::Closure* done) override;
 
+  /// Same as CallMethod(), with its own timeout, 0 for none.
+  /// Returns id of the call, for cancel().
+  int64_t call(const ::google::protobuf::MethodDescriptor* method,
+               ::google::protobuf::RpcController* controller,
+               const ::google::protobuf::Message* request,
+               ::google::protobuf::Message* response,
+               ::google::protobuf::Closure* done,
+               double timeout);
+
+  /// Fails an outstanding call with "CANCELED" and runs its done in this thread.
+  /// Returns false if the call has finished.
+  bool cancel(int64_t id);
+
+  /// Cancels all outstanding calls, eg. when the connection is down.
+  /// Streams are closed with "CANCELED" too.
+  void cancelAll();
+
+  size_t numOutstandingCalls() const;
+
+  /// A new stream of method, call RpcStream::open() after setting its callbacks.
+  /// Streams are sent with method_id only, the peer must be built with
+  /// stream support. The channel must be managed by RpcChannelPtr,
+  /// and connected.
+  RpcStreamPtr newStream(const ::google::protobuf::MethodDescriptor* method);
+
+  /// Streams stop sending while output buffer of connection is above
+  /// this, default 4MiB. Unary calls and responses are not affected.
+  /// Takes the high water mark and write complete callbacks of
+  /// the connection, once the first stream opens.
+  void setStreamHighWaterMark(size_t bytes)
+  {
+    streamHighWaterMark_ = bytes;
+  }
+
+  size_t numStreams() const;
+
   void onMessage(const TcpConnectionPtr& conn,
                  Buffer* buf,
                  Timestamp receiveTime);
 
  private:
   void onRpcMessage(const TcpConnectionPtr& conn,
-                    const RpcMessagePtr& messagePtr,
+                    const MessagePtr& messagePtr,
                     Timestamp receiveTime);
 
-  void doneCallback(::google::protobuf::Message* response, int64_t id);
+  friend class RpcStream;
+  // in I/O thread
+  bool attachStream(const RpcStreamPtr& stream);
+  RpcStreamPtr acceptStream(const RpcMessage& message);
+  void removeStream(const RpcStreamPtr& stream);
+  void sendStreamFrame(const RpcMessage& frame);
+  void onStreamFrame(const RpcMessage& frame);
+  void installStreamCallbacks();
+  void setStreamsBlocked(bool blocked);
+  // thread safe
+  void closeAllStreams(const string& reason);
+  static void onHighWaterMark(const std::weak_ptr<RpcChannel>& weakSelf,
+                              const TcpConnectionPtr& conn,
+                              size_t len);
+  static void onWriteComplete(const std::weak_ptr<RpcChannel>& weakSelf,
+                              const TcpConnectionPtr& conn);
+
+  // everything to send a response, without the channel,
+  // which may be gone before a service runs done.
+  struct ReplyTo
+  {
+    int64_t id;
+    std::shared_ptr<RpcEnvelopeCodec> codec;
+    TcpConnectionPtr conn;
+    std::shared_ptr<AtomicInt32> concurrency;  // NULL for unlimited
+  };
+
+  static void callService(::google::protobuf::Service* service,
+                          const ::google::protobuf::MethodDescriptor* method,
+                          const std::shared_ptr<::google::protobuf::Message>& request,
+                          ::google::protobuf::Message* response,
+                          const ReplyTo& replyTo);
+
+  static void doneCallback(::google::protobuf::Message* response, ReplyTo replyTo);
 
   struct OutstandingCall
   {
     ::google::protobuf::Message* response;
     ::google::protobuf::Closure* done;
+    ::google::protobuf::RpcController* controller;
+    EventLoop* loop;  // of the timeout timer, NULL for none
+    TimerId timer;
   };
 
-  RpcCodec codec_;
+  class CallTable;
+  typedef std::shared_ptr<CallTable> CallTablePtr;
+
+  bool failCall(int64_t id, const string& failure);
+  static void onCallTimeout(const std::weak_ptr<CallTable>& weakCalls, int64_t id);
+  static void finishCall(const OutstandingCall& out, const string& failure);
+
+  // shared with requests running in pools
+  const std::shared_ptr<RpcEnvelopeCodec> codec_;
   TcpConnectionPtr conn_;
   AtomicInt64 id_;
+  double callTimeout_;
 
-  MutexLock mutex_;
-  std::map<int64_t, OutstandingCall> outstandings_ GUARDED_BY(mutex_);
+  // shared with timeout timers, which may outlive this channel
+  const CallTablePtr calls_;
 
   const std::map<std::string, ::google::protobuf::Service*>* services_;
+  const MethodTable* methods_;
+  const StreamTable* streams_;
+
+  size_t streamHighWaterMark_;
+  // in I/O thread
+  bool streamCallbacksInstalled_;
+  bool streamsBlocked_;
+  mutable MutexLock streamMutex_;
+  std::unordered_map<int64_t, RpcStreamPtr> openedStreams_ GUARDED_BY(streamMutex_);
+  std::unordered_map<int64_t, RpcStreamPtr> acceptedStreams_ GUARDED_BY(streamMutex_);
 };
-typedef std::shared_ptr<RpcChannel> RpcChannelPtr;
 
 }  // namespace net
 }  // namespace muduo
@@ -0,0 +1,526 @@
+#include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/RpcServer.h"
+#include "muduo/net/protorpc/rpcservice.pb.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/CurrentThread.h"
+#include "muduo/base/ThreadPool.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <google/protobuf/descriptor.h>
+
+#include <atomic>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 27800;
+// of a request with list_method
+const double kLate = 0.3;
+
+// answers listRpc with the service_name of request,
+// after kLate seconds if list_method is set.
+class TestService : public RpcService
+{
+ public:
+  explicit TestService(EventLoop* loop)
+    : loop_(loop),
+      served_(0),
+      servedBy_(0)
+  {
+  }
+
+  void listRpc(::google::protobuf::RpcController*,
+               const ListRpcRequest* request,
+               ListRpcResponse* response,
+               ::google::protobuf::Closure* done) override
+  {
+    ++served_;
+    servedBy_ = CurrentThread::tid();
+    response->set_error(NO_ERROR);
+    response->add_service_name(request->service_name());
+    if (request->list_method())
+    {
+      loop_->runAfter(kLate, [done] { done->Run(); });
+    }
+    else
+    {
+      done->Run();
+    }
+  }
+
+  void getService(::google::protobuf::RpcController*,
+                  const GetServiceRequest*,
+                  GetServiceResponse* response,
+                  ::google::protobuf::Closure* done) override
+  {
+    response->set_error(NO_SERVICE);
+    done->Run();
+  }
+
+  int served() const { return served_; }
+  // thread of the last request
+  int servedBy() const { return servedBy_; }
+
+ private:
+  EventLoop* loop_;
+  std::atomic<int> served_;
+  std::atomic<int> servedBy_;
+};
+
+class Controller : public ::google::protobuf::RpcController
+{
+ public:
+  void Reset() override { failure_.clear(); }
+  bool Failed() const override { return !failure_.empty(); }
+  std::string ErrorText() const override { return failure_; }
+  void StartCancel() override { }
+  void SetFailed(const std::string& reason) override { failure_ = reason; }
+  bool IsCanceled() const override { return false; }
+  void NotifyOnCancel(::google::protobuf::Closure*) override { }
+
+ private:
+  std::string failure_;
+};
+
+struct Result
+{
+  Result() : done(0) { }
+
+  Controller controller;
+  int done;
+  string answer;
+};
+
+// the channel deletes response after running done
+void onDone(Result* result, ListRpcResponse* response)
+{
+  ++result->done;
+  if (response->service_name_size() > 0)
+  {
+    result->answer = response->service_name(0);
+  }
+}
+
+const ::google::protobuf::MethodDescriptor* listRpcMethod()
+{
+  return RpcService::descriptor()->FindMethodByName("listRpc");
+}
+
+int64_t callListRpc(RpcChannel* channel, Result* result,
+                    const string& name, bool late, double timeout)
+{
+  ListRpcRequest request;
+  request.set_service_name(name);
+  request.set_list_method(late);
+  ListRpcResponse* response = new ListRpcResponse;
+  return channel->call(listRpcMethod(), &result->controller, &request, response,
+                       ::google::protobuf::NewCallback(onDone, result, response),
+                       timeout);
+}
+
+// an RpcServer and a client channel connected to it, in one loop,
+// with execution policy of listRpc.
+struct Fixture
+{
+  explicit Fixture(ThreadPool* pool = NULL, int maxConcurrency = 0)
+    : listenAddr("127.0.0.1", kPort),
+      service(&loop),
+      server(&loop, listenAddr),
+      client(&loop, listenAddr, "RpcChannelTest")
+  {
+    server.registerService(&service);
+    server.setExecutionPolicy(listRpcMethod()->full_name(), pool, maxConcurrency);
+    server.start();
+    channel = connect(&client);
+  }
+
+  ~Fixture()
+  {
+    client.disconnect();
+    runFor(0.1);
+  }
+
+  void runFor(double seconds)
+  {
+    loop.runAfter(seconds, [this] { loop.quit(); });
+    loop.loop();
+  }
+
+  // returns after connected
+  RpcChannelPtr connect(TcpClient* rpcClient)
+  {
+    RpcChannelPtr rpcChannel(new RpcChannel);
+    rpcClient->setConnectionCallback([this, rpcChannel](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        rpcChannel->setConnection(conn);
+        conn->setMessageCallback(
+            std::bind(&RpcChannel::onMessage, get_pointer(rpcChannel), _1, _2, _3));
+        loop.quit();
+      }
+    });
+    rpcClient->connect();
+    loop.loop();
+    return rpcChannel;
+  }
+
+  int64_t call(Result* result, const string& name, bool late, double timeout)
+  {
+    return callListRpc(get_pointer(channel), result, name, late, timeout);
+  }
+
+  EventLoop loop;
+  InetAddress listenAddr;
+  TestService service;
+  RpcServer server;
+  TcpClient client;
+  RpcChannelPtr channel;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testResponseBeforeTimeout)
+{
+  Fixture f;
+  Result result;
+  f.call(&result, "early", false, kLate);
+  f.runFor(0.1);
+  BOOST_CHECK_EQUAL(result.done, 1);
+  BOOST_CHECK(!result.controller.Failed());
+  BOOST_CHECK_EQUAL(result.answer, "early");
+  BOOST_CHECK_EQUAL(f.channel->numOutstandingCalls(), 0u);
+
+  // the timer was canceled, done never runs again
+  f.runFor(kLate);
+  BOOST_CHECK_EQUAL(result.done, 1);
+  BOOST_CHECK(!result.controller.Failed());
+}
+
+BOOST_AUTO_TEST_CASE(testTimeout)
+{
+  Fixture f;
+  Result result;
+  f.call(&result, "late", true, 0.1);
+  BOOST_CHECK_EQUAL(f.channel->numOutstandingCalls(), 1u);
+  f.runFor(0.2);
+  BOOST_CHECK_EQUAL(result.done, 1);
+  BOOST_CHECK_EQUAL(result.controller.ErrorText(), "TIMEOUT");
+  BOOST_CHECK_EQUAL(result.answer, "");
+  BOOST_CHECK_EQUAL(f.channel->numOutstandingCalls(), 0u);
+
+  // the late response is dropped
+  f.runFor(kLate);
+  BOOST_CHECK_EQUAL(f.service.served(), 1);
+  BOOST_CHECK_EQUAL(result.done, 1);
+  BOOST_CHECK_EQUAL(result.controller.ErrorText(), "TIMEOUT");
+  BOOST_CHECK_EQUAL(result.answer, "");
+
+  // the channel still works
+  Result next;
+  f.call(&next, "next", false, 0.1);
+  f.runFor(0.05);
+  BOOST_CHECK_EQUAL(next.done, 1);
+  BOOST_CHECK(!next.controller.Failed());
+  BOOST_CHECK_EQUAL(next.answer, "next");
+}
+
+BOOST_AUTO_TEST_CASE(testCancel)
+{
+  Fixture f;
+  Result result;
+  int64_t id = f.call(&result, "late", true, 0.1);
+  f.runFor(0.05);
+  BOOST_CHECK(f.channel->cancel(id));
+  // done runs in this thread, before cancel() returns
+  BOOST_CHECK_EQUAL(result.done, 1);
+  BOOST_CHECK_EQUAL(result.controller.ErrorText(), "CANCELED");
+  BOOST_CHECK(!f.channel->cancel(id));
+  BOOST_CHECK_EQUAL(f.channel->numOutstandingCalls(), 0u);
+
+  // neither the canceled timer nor the late response runs done again
+  f.runFor(kLate);
+  BOOST_CHECK_EQUAL(f.service.served(), 1);
+  BOOST_CHECK_EQUAL(result.done, 1);
+  BOOST_CHECK_EQUAL(result.controller.ErrorText(), "CANCELED");
+  BOOST_CHECK_EQUAL(result.answer, "");
+}
+
+BOOST_AUTO_TEST_CASE(testCancelAll)
+{
+  Fixture f;
+  Result first;
+  Result second;
+  f.call(&first, "first", true, 0);
+  f.call(&second, "second", true, kLate * 2);
+  f.runFor(0.05);
+  BOOST_CHECK_EQUAL(f.channel->numOutstandingCalls(), 2u);
+  f.channel->cancelAll();
+  BOOST_CHECK_EQUAL(first.done, 1);
+  BOOST_CHECK_EQUAL(first.controller.ErrorText(), "CANCELED");
+  BOOST_CHECK_EQUAL(second.done, 1);
+  BOOST_CHECK_EQUAL(second.controller.ErrorText(), "CANCELED");
+  BOOST_CHECK_EQUAL(f.channel->numOutstandingCalls(), 0u);
+
+  f.runFor(kLate * 2);
+  BOOST_CHECK_EQUAL(first.done, 1);
+  BOOST_CHECK_EQUAL(second.done, 1);
+}
+
+BOOST_AUTO_TEST_CASE(testMethodId)
+{
+  const ::google::protobuf::ServiceDescriptor* desc = RpcService::descriptor();
+  // FNV-1a of "muduo.net.RpcService.listRpc", peers of other languages compute the same
+  BOOST_CHECK_EQUAL(RpcChannel::methodId(desc->FindMethodByName("listRpc")), 0x004004f5u);
+  BOOST_CHECK_EQUAL(RpcChannel::methodId(desc->FindMethodByName("getService")), 0x7356d68du);
+}
+
+BOOST_AUTO_TEST_CASE(testIdTable)
+{
+  struct Entry
+  {
+    uint32_t id;
+    int value;
+  };
+  RpcIdTable<Entry> table;
+  BOOST_CHECK(table.find(1) == NULL);
+
+  // same low bits, probed linearly
+  for (uint32_t i = 1; i <= 100; ++i)
+  {
+    Entry entry = { i << 16, static_cast<int>(i) };
+    table.insert(entry);
+  }
+  Entry last = { 0xffffffff, -1 };
+  table.insert(last);
+  BOOST_CHECK_EQUAL(table.size(), 101u);
+  for (uint32_t i = 1; i <= 100; ++i)
+  {
+    const Entry* entry = table.find(i << 16);
+    BOOST_REQUIRE(entry != NULL);
+    BOOST_CHECK_EQUAL(entry->value, static_cast<int>(i));
+  }
+  BOOST_CHECK_EQUAL(table.find(0xffffffff)->value, -1);
+  BOOST_CHECK(table.find(101 << 16) == NULL);
+  BOOST_CHECK(table.find(1) == NULL);
+
+  Entry replaced = { 7 << 16, 700 };
+  table.insert(replaced);
+  BOOST_CHECK_EQUAL(table.size(), 101u);
+  BOOST_CHECK_EQUAL(table.find(7 << 16)->value, 700);
+}
+
+// requests of clients of every version
+BOOST_AUTO_TEST_CASE(testDispatchByIdOrNames)
+{
+  Fixture f;
+  std::vector<RpcMessagePtr> responses;
+  RpcCodec codec([&responses](const TcpConnectionPtr&, const RpcMessagePtr& message, Timestamp)
+                 { responses.push_back(message); });
+  TcpClient raw(&f.loop, f.listenAddr, "RawClient");
+  TcpConnectionPtr conn;
+  raw.setConnectionCallback([&f, &conn](const TcpConnectionPtr& c) {
+    if (c->connected())
+    {
+      conn = c;
+      f.loop.quit();
+    }
+  });
+  raw.setMessageCallback(std::bind(&RpcCodec::onMessage, &codec, _1, _2, _3));
+  raw.connect();
+  f.loop.loop();
+
+  ListRpcRequest request;
+  request.set_service_name("raw");
+  RpcMessage message;
+  message.set_type(REQUEST);
+  message.set_request(request.SerializeAsString());
+  // by id only, as streams are opened
+  message.set_id(1);
+  message.set_method_id(RpcChannel::methodId(listRpcMethod()));
+  codec.send(conn, message);
+  // by names only, as clients before method ids
+  message.set_id(2);
+  message.clear_method_id();
+  message.set_service("muduo.net.RpcService");
+  message.set_method("listRpc");
+  codec.send(conn, message);
+  // unknown id, by names
+  message.set_id(3);
+  message.set_method_id(12345);
+  codec.send(conn, message);
+  // unknown id, no names
+  message.set_id(4);
+  message.clear_service();
+  message.clear_method();
+  codec.send(conn, message);
+  f.runFor(0.1);
+
+  BOOST_REQUIRE_EQUAL(responses.size(), 4u);
+  for (uint64_t id = 1; id <= 3; ++id)
+  {
+    const RpcMessage& response = *responses[id - 1];
+    BOOST_CHECK_EQUAL(response.id(), id);
+    BOOST_CHECK(!response.has_error() || response.error() == NO_ERROR);
+    ListRpcResponse answer;
+    BOOST_CHECK(answer.ParseFromString(response.response()));
+    BOOST_CHECK_EQUAL(answer.service_name(0), "raw");
+  }
+  BOOST_CHECK_EQUAL(responses[3]->id(), 4u);
+  BOOST_CHECK_EQUAL(responses[3]->error(), NO_METHOD);
+  BOOST_CHECK_EQUAL(f.service.served(), 3);
+
+  raw.disconnect();
+  conn.reset();
+  f.runFor(0.1);
+}
+
+// A proxy forwards requests to servers of any version, so requests keep
+// service and method, even after responses of method id aware servers.
+BOOST_AUTO_TEST_CASE(testRequestsKeepNames)
+{
+  Fixture f;
+  InetAddress proxyAddr("127.0.0.1", static_cast<uint16_t>(kPort + 1));
+  std::vector<RpcMessage> requests;
+  RpcCodec* proxyCodec = NULL;
+  // answers as servers which echoed method_id did
+  RpcCodec codec([&requests, &proxyCodec](const TcpConnectionPtr& conn,
+                                          const RpcMessagePtr& message,
+                                          Timestamp)
+  {
+    requests.push_back(*message);
+    ListRpcResponse answer;
+    answer.set_error(NO_ERROR);
+    answer.add_service_name("proxy");
+    RpcMessage response;
+    response.set_type(RESPONSE);
+    response.set_id(message->id());
+    response.set_method_id(message->method_id());
+    response.set_response(answer.SerializeAsString());
+    proxyCodec->send(conn, response);
+  });
+  proxyCodec = &codec;
+  TcpServer proxy(&f.loop, proxyAddr, "Proxy");
+  proxy.setMessageCallback(std::bind(&RpcCodec::onMessage, &codec, _1, _2, _3));
+  proxy.start();
+
+  TcpClient client(&f.loop, proxyAddr, "ProxyClient");
+  RpcChannelPtr channel = f.connect(&client);
+  Result first;
+  callListRpc(get_pointer(channel), &first, "first", false, 0);
+  f.runFor(0.05);
+  Result second;
+  callListRpc(get_pointer(channel), &second, "second", false, 0);
+  f.runFor(0.05);
+
+  BOOST_CHECK_EQUAL(first.answer, "proxy");
+  BOOST_CHECK_EQUAL(second.answer, "proxy");
+  BOOST_REQUIRE_EQUAL(requests.size(), 2u);
+  for (const RpcMessage& request : requests)
+  {
+    BOOST_CHECK_EQUAL(request.method_id(), RpcChannel::methodId(listRpcMethod()));
+    BOOST_CHECK_EQUAL(request.service(), "muduo.net.RpcService");
+    BOOST_CHECK_EQUAL(request.method(), "listRpc");
+  }
+
+  client.disconnect();
+  f.runFor(0.1);
+}
+
+BOOST_AUTO_TEST_CASE(testInline)
+{
+  Fixture f;
+  Result result;
+  f.call(&result, "inline", false, 0);
+  f.runFor(0.05);
+  BOOST_CHECK_EQUAL(result.answer, "inline");
+  BOOST_CHECK_EQUAL(f.service.servedBy(), CurrentThread::tid());
+}
+
+BOOST_AUTO_TEST_CASE(testThreadPool)
+{
+  ThreadPool pool("RpcPool");
+  pool.start(2);
+  {
+  Fixture f(&pool);
+  Result first;
+  Result second;
+  f.call(&first, "first", false, 0);
+  f.call(&second, "second", false, 0);
+  f.runFor(0.1);
+  BOOST_CHECK(!first.controller.Failed());
+  BOOST_CHECK_EQUAL(first.answer, "first");
+  BOOST_CHECK(!second.controller.Failed());
+  BOOST_CHECK_EQUAL(second.answer, "second");
+  BOOST_CHECK_EQUAL(f.service.served(), 2);
+  BOOST_CHECK_NE(f.service.servedBy(), CurrentThread::tid());
+  }
+  pool.stop();
+}
+
+BOOST_AUTO_TEST_CASE(testOverloadedByConcurrency)
+{
+  Fixture f(NULL, 1);
+  Result first;
+  Result second;
+  f.call(&first, "first", true, 0);
+  f.call(&second, "second", true, 0);
+  f.runFor(0.1);
+  // fails without running
+  BOOST_CHECK_EQUAL(second.done, 1);
+  BOOST_CHECK_EQUAL(second.controller.ErrorText(), "OVERLOADED");
+  BOOST_CHECK_EQUAL(first.done, 0);
+  BOOST_CHECK_EQUAL(f.service.served(), 1);
+
+  f.runFor(kLate);
+  BOOST_CHECK_EQUAL(first.done, 1);
+  BOOST_CHECK_EQUAL(first.answer, "first");
+
+  // released after done
+  Result third;
+  f.call(&third, "third", false, 0);
+  f.runFor(0.05);
+  BOOST_CHECK(!third.controller.Failed());
+  BOOST_CHECK_EQUAL(third.answer, "third");
+}
+
+BOOST_AUTO_TEST_CASE(testOverloadedByQueue)
+{
+  ThreadPool pool("RpcPool");
+  pool.setMaxQueueSize(1);
+  pool.start(1);
+  CountDownLatch busy(1);
+  CountDownLatch release(1);
+  pool.run([&busy, &release] { busy.countDown(); release.wait(); });
+  busy.wait();
+  {
+  Fixture f(&pool);
+  Result first;
+  Result second;
+  Result third;
+  f.call(&first, "first", false, 0);
+  f.call(&second, "second", false, 0);
+  f.call(&third, "third", false, 0);
+  // the I/O thread never blocks on the full queue
+  f.runFor(0.1);
+  BOOST_CHECK_EQUAL(first.done, 0);
+  BOOST_CHECK_EQUAL(second.controller.ErrorText(), "OVERLOADED");
+  BOOST_CHECK_EQUAL(third.controller.ErrorText(), "OVERLOADED");
+  BOOST_CHECK_EQUAL(f.service.served(), 0);
+
+  release.countDown();
+  f.runFor(0.1);
+  BOOST_CHECK_EQUAL(first.done, 1);
+  BOOST_CHECK_EQUAL(first.answer, "first");
+  BOOST_CHECK_EQUAL(f.service.served(), 1);
+  }
+  pool.stop();
+}
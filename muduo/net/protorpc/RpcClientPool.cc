@@ -0,0 +1,501 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protorpc/RpcClientPool.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/protorpc/rpc.pb.h"
+
+#include <google/protobuf/descriptor.h>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+__thread uint32_t t_random = 0;
+
+// xorshift, good enough for picking connections.
+uint32_t fastRandom()
+{
+  if (t_random == 0)
+  {
+    t_random = static_cast<uint32_t>(Timestamp::now().microSecondsSinceEpoch()) | 1;
+  }
+  t_random ^= t_random << 13;
+  t_random ^= t_random >> 17;
+  t_random ^= t_random << 5;
+  return t_random;
+}
+
+// in loop thread of client, so no callback runs afterwards,
+// returns its connection, if any.
+TcpConnectionPtr detach(TcpClient* client)
+{
+  client->stop();
+  client->setConnectionCallback(defaultConnectionCallback);
+  client->setMessageCallback(defaultMessageCallback);
+  TcpConnectionPtr conn(client->connection());
+  if (conn)
+  {
+    conn->setConnectionCallback(defaultConnectionCallback);
+    conn->setMessageCallback(defaultMessageCallback);
+    conn->setContext(RpcChannelPtr());
+  }
+  return conn;
+}
+
+// as the context of a connection, counts down when it is destroyed
+class DestroyNotifier : noncopyable
+{
+ public:
+  explicit DestroyNotifier(CountDownLatch* latch)
+    : latch_(latch)
+  {
+  }
+
+  ~DestroyNotifier()
+  {
+    latch_->countDown();
+  }
+
+ private:
+  CountDownLatch* latch_;
+};
+
+}  // namespace
+
+struct RpcClientPool::Backend : noncopyable
+{
+  explicit Backend(const InetAddress& addr)
+    : address(addr)
+  {
+  }
+
+  const InetAddress address;
+  AtomicInt32 failures;  // consecutive
+  AtomicInt64 ejectedUntil;  // microseconds since epoch
+};
+
+struct RpcClientPool::Connection : noncopyable
+{
+  Connection(Backend* b, EventLoop* loop, const string& name)
+    : backend(b),
+      client(new TcpClient(loop, b->address, name))
+  {
+  }
+
+  RpcChannelPtr getChannel() const
+  {
+    MutexLockGuard lock(mutex);
+    return channel;
+  }
+
+  Backend* const backend;
+  std::unique_ptr<TcpClient> client;
+  AtomicInt32 up;
+  AtomicInt32 outstanding;
+  mutable MutexLock mutex;
+  // a new one for each TCP connection
+  RpcChannelPtr channel GUARDED_BY(mutex);
+};
+
+// Controller of a call sent by pool, forwards to the one of user,
+// and records failures for health checking.
+class RpcClientPool::Call : public ::google::protobuf::RpcController
+{
+ public:
+  Call(Connection* c,
+       ::google::protobuf::RpcController* controller,
+       ::google::protobuf::Closure* done)
+    : connection_(c),
+      controller_(controller),
+      done_(done),
+      failed_(false)
+  {
+  }
+
+  Connection* connection() const { return connection_; }
+  ::google::protobuf::Closure* done() const { return done_; }
+  // timed out, not errors of service. Canceled calls are not counted,
+  // a lost connection counts once in onConnection().
+  bool backendFailed() const
+  {
+    return failed_ && reason_ != ErrorCode_Name(CANCELED)
+        && reason_ != ErrorCode_Name(NO_METHOD)
+        && reason_ != ErrorCode_Name(NO_SERVICE)
+        && reason_ != ErrorCode_Name(INVALID_REQUEST)
+        && reason_ != ErrorCode_Name(OVERLOADED);
+  }
+
+  void Reset() override
+  {
+    failed_ = false;
+    reason_.clear();
+    if (controller_)
+      controller_->Reset();
+  }
+
+  bool Failed() const override { return failed_; }
+  std::string ErrorText() const override { return reason_; }
+
+  void StartCancel() override
+  {
+    if (controller_)
+      controller_->StartCancel();
+  }
+
+  void SetFailed(const std::string& reason) override
+  {
+    failed_ = true;
+    reason_ = reason;
+    if (controller_)
+      controller_->SetFailed(reason);
+  }
+
+  bool IsCanceled() const override
+  {
+    return controller_ && controller_->IsCanceled();
+  }
+
+  void NotifyOnCancel(::google::protobuf::Closure* callback) override
+  {
+    if (controller_)
+      controller_->NotifyOnCancel(callback);
+  }
+
+ private:
+  Connection* const connection_;
+  ::google::protobuf::RpcController* const controller_;
+  ::google::protobuf::Closure* const done_;
+  bool failed_;
+  std::string reason_;
+};
+
+RpcClientPool::RpcClientPool(EventLoop* loop,
+                             const std::vector<InetAddress>& backends,
+                             const string& nameArg,
+                             int connectionsPerBackend)
+  : loop_(loop),
+    name_(nameArg),
+    connectionsPerBackend_(connectionsPerBackend),
+    threadPool_(new EventLoopThreadPool(loop, nameArg)),
+    strategy_(kLeastOutstanding),
+    callTimeout_(0.0),
+    maxFailures_(5),
+    ejectionTime_(10.0)
+{
+  assert(!backends.empty());
+  assert(connectionsPerBackend > 0);
+  for (const InetAddress& addr : backends)
+  {
+    backends_.emplace_back(new Backend(addr));
+  }
+}
+
+RpcClientPool::~RpcClientPool()
+{
+  // callbacks of connections are bound to this, clears them in their loops
+  // before anything goes, then fails outstanding calls.
+  // Connections of io loops are closed there, and waited for, as they must
+  // be destroyed before threadPool_ quits their loops.
+  std::vector<std::unique_ptr<CountDownLatch>> destroyed;
+  for (const std::unique_ptr<Connection>& c : connections_)
+  {
+    EventLoop* ioLoop = c->client->getLoop();
+    if (ioLoop->isInLoopThread())
+    {
+      detach(get_pointer(c->client));
+    }
+    else
+    {
+      std::unique_ptr<CountDownLatch> latch(new CountDownLatch(1));
+      bool connected = false;
+      CountDownLatch done(1);
+      ioLoop->runInLoop([&c, &latch, &connected, &done] {
+        TcpConnectionPtr conn(detach(get_pointer(c->client)));
+        c->client.reset();
+        if (conn)
+        {
+          conn->setContext(std::make_shared<DestroyNotifier>(get_pointer(latch)));
+          // ~TcpClient doesn't close it, as we hold it too
+          conn->forceClose();
+          connected = true;
+        }
+        done.countDown();
+      });
+      done.wait();
+      if (connected)
+      {
+        destroyed.push_back(std::move(latch));
+      }
+    }
+    c->up.getAndSet(0);
+    RpcChannelPtr channel;
+    {
+      MutexLockGuard lock(c->mutex);
+      channel.swap(c->channel);
+    }
+    if (channel)
+    {
+      channel->cancelAll();
+    }
+  }
+  // TcpClients go before their loops in threadPool_
+  connections_.clear();
+  for (const std::unique_ptr<CountDownLatch>& latch : destroyed)
+  {
+    latch->wait();
+  }
+}
+
+void RpcClientPool::setThreadNum(int numThreads)
+{
+  assert(connections_.empty());
+  threadPool_->setThreadNum(numThreads);
+}
+
+void RpcClientPool::start()
+{
+  loop_->assertInLoopThread();
+  assert(connections_.empty());
+  threadPool_->start();
+  // interleaved, so neighbours are of different backends
+  for (int i = 0; i < connectionsPerBackend_; ++i)
+  {
+    for (const std::unique_ptr<Backend>& backend : backends_)
+    {
+      char buf[64];
+      snprintf(buf, sizeof buf, "-%s#%d", backend->address.toIpPort().c_str(), i);
+      Connection* c = new Connection(get_pointer(backend), threadPool_->getNextLoop(), name_ + buf);
+      connections_.emplace_back(c);
+      c->client->setConnectionCallback(
+          std::bind(&RpcClientPool::onConnection, this, c, _1));
+      c->client->setMessageCallback(&RpcClientPool::onMessage);
+      c->client->enableRetry();
+    }
+  }
+  for (const std::unique_ptr<Connection>& c : connections_)
+  {
+    c->client->connect();
+  }
+}
+
+void RpcClientPool::onConnection(Connection* c, const TcpConnectionPtr& conn)
+{
+  LOG_INFO << "RpcClientPool - " << conn->localAddress().toIpPort() << " -> "
+           << conn->peerAddress().toIpPort() << " is "
+           << (conn->connected() ? "UP" : "DOWN");
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    // not google::protobuf::RpcChannel, base class of this
+    RpcChannelPtr channel(new muduo::net::RpcChannel(conn));
+    channel->setCallTimeout(callTimeout_);
+    conn->setContext(channel);
+    {
+      MutexLockGuard lock(c->mutex);
+      c->channel = channel;
+    }
+    c->up.getAndSet(1);
+  }
+  else
+  {
+    c->up.getAndSet(0);
+    RpcChannelPtr channel;
+    {
+      MutexLockGuard lock(c->mutex);
+      channel.swap(c->channel);
+    }
+    conn->setContext(RpcChannelPtr());
+    onFailure(c->backend);
+    if (channel)
+    {
+      channel->cancelAll();
+    }
+  }
+}
+
+void RpcClientPool::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+  const RpcChannelPtr& channel = boost::any_cast<const RpcChannelPtr&>(conn->getContext());
+  if (channel)
+  {
+    channel->onMessage(conn, buf, receiveTime);
+  }
+}
+
+void RpcClientPool::CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                               ::google::protobuf::RpcController* controller,
+                               const ::google::protobuf::Message* request,
+                               ::google::protobuf::Message* response,
+                               ::google::protobuf::Closure* done)
+{
+  Connection* c = pick();
+  RpcChannelPtr channel;
+  if (c)
+  {
+    channel = c->getChannel();
+  }
+  if (!channel)
+  {
+    // same as RpcChannel, response is deleted after done
+    std::unique_ptr<google::protobuf::Message> d(response);
+    if (controller)
+    {
+      controller->SetFailed("UNAVAILABLE");
+    }
+    if (done)
+    {
+      done->Run();
+    }
+    return;
+  }
+
+  c->outstanding.increment();
+  Call* call = new Call(c, controller, done);
+  channel->CallMethod(method, call, request, response,
+                      NewCallback(this, &RpcClientPool::onCallDone, call));
+}
+
+void RpcClientPool::onCallDone(Call* call)
+{
+  std::unique_ptr<Call> d(call);
+  Connection* c = call->connection();
+  c->outstanding.decrement();
+  if (call->backendFailed())
+  {
+    onFailure(c->backend);
+  }
+  else if (c->backend->failures.get() != 0)
+  {
+    c->backend->failures.getAndSet(0);
+  }
+  if (call->done())
+  {
+    call->done()->Run();
+  }
+}
+
+void RpcClientPool::onFailure(Backend* backend)
+{
+  if (backend->failures.incrementAndGet() >= maxFailures_)
+  {
+    int64_t until = Timestamp::now().microSecondsSinceEpoch()
+      + static_cast<int64_t>(ejectionTime_ * Timestamp::kMicroSecondsPerSecond);
+    if (backend->ejectedUntil.getAndSet(until) < Timestamp::now().microSecondsSinceEpoch())
+    {
+      LOG_WARN << "RpcClientPool::onFailure - eject " << backend->address.toIpPort()
+               << " for " << ejectionTime_ << " seconds";
+    }
+    // gets another maxFailures chances after ejection
+    backend->failures.getAndSet(0);
+  }
+}
+
+bool RpcClientPool::isAvailable(Connection* c, int64_t now)
+{
+  return c->up.get() != 0 && c->backend->ejectedUntil.get() <= now;
+}
+
+RpcClientPool::Connection* RpcClientPool::pick()
+{
+  if (connections_.empty())
+  {
+    return NULL;
+  }
+  int64_t now = Timestamp::now().microSecondsSinceEpoch();
+  Connection* c = strategy_ == kPowerOfTwoChoices
+    ? pickPowerOfTwo(now) : pickLeastOutstanding(now, false);
+  if (c == NULL)
+  {
+    // all ejected, better than failing every call
+    c = pickLeastOutstanding(now, true);
+  }
+  return c;
+}
+
+RpcClientPool::Connection* RpcClientPool::pickLeastOutstanding(int64_t now, bool ignoreEjection)
+{
+  Connection* best = NULL;
+  int bestOutstanding = 0;
+  // starts at random position, spreads ties
+  const size_t n = connections_.size();
+  const size_t start = fastRandom() % n;
+  for (size_t i = 0; i < n; ++i)
+  {
+    Connection* c = get_pointer(connections_[(start + i) % n]);
+    if (ignoreEjection ? c->up.get() != 0 : isAvailable(c, now))
+    {
+      int outstanding = c->outstanding.get();
+      if (best == NULL || outstanding < bestOutstanding)
+      {
+        best = c;
+        bestOutstanding = outstanding;
+      }
+    }
+  }
+  return best;
+}
+
+RpcClientPool::Connection* RpcClientPool::pickPowerOfTwo(int64_t now)
+{
+  const size_t n = connections_.size();
+  if (n < 2)
+  {
+    return pickLeastOutstanding(now, false);
+  }
+  // two different ones
+  size_t i = fastRandom() % n;
+  size_t j = fastRandom() % (n - 1);
+  if (j >= i)
+  {
+    ++j;
+  }
+  Connection* a = get_pointer(connections_[i]);
+  Connection* b = get_pointer(connections_[j]);
+  bool aOk = isAvailable(a, now);
+  bool bOk = isAvailable(b, now);
+  if (aOk && bOk)
+  {
+    return a->outstanding.get() <= b->outstanding.get() ? a : b;
+  }
+  else if (aOk || bOk)
+  {
+    return aOk ? a : b;
+  }
+  // unlucky, or few are available
+  return pickLeastOutstanding(now, false);
+}
+
+int RpcClientPool::numConnected()
+{
+  int n = 0;
+  for (const std::unique_ptr<Connection>& c : connections_)
+  {
+    n += c->up.get();
+  }
+  return n;
+}
+
+int RpcClientPool::numOutstandingCalls()
+{
+  int n = 0;
+  for (const std::unique_ptr<Connection>& c : connections_)
+  {
+    n += c->outstanding.get();
+  }
+  return n;
+}
@@ -0,0 +1,127 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCCLIENTPOOL_H
+#define MUDUO_NET_PROTORPC_RPCCLIENTPOOL_H
+
+#include "muduo/base/Atomic.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class EventLoopThreadPool;
+class TcpClient;
+
+/// Connections to a group of equivalent backends, usable as the channel of stubs.
+///
+/// Keeps connectionsPerBackend connections to each backend, reconnects them
+/// with TcpClient::enableRetry(), and sends each call over the connection
+/// with fewest outstanding calls. A backend is ejected for a while after
+/// consecutive timeouts or disconnections, and is used again afterwards.
+///
+/// @code
+/// RpcClientPool pool(&loop, backends, "EchoClient", 4);
+/// pool.setThreadNum(4);
+/// pool.setCallTimeout(1.0);
+/// pool.start();
+/// echo::EchoService::Stub stub(&pool);
+/// @endcode
+///
+/// CallMethod() is thread safe. Calls fail with "UNAVAILABLE" if no backend
+/// is connected, with "CANCELED" if the connection is lost before response,
+/// or the pool is destroyed. Destroy it in loop thread.
+class RpcClientPool : public ::google::protobuf::RpcChannel,
+                      noncopyable
+{
+ public:
+  enum Strategy
+  {
+    kLeastOutstanding,  // scans all connections
+    kPowerOfTwoChoices,  // picks the better of two random connections
+  };
+
+  RpcClientPool(EventLoop* loop,
+                const std::vector<InetAddress>& backends,
+                const string& name,
+                int connectionsPerBackend = 1);
+  ~RpcClientPool() override;  // force out-line dtor, for std::unique_ptr members.
+
+  /// Spreads connections to numThreads event loops, default 0,
+  /// all connections are in loop.
+  /// Must be called before start().
+  void setThreadNum(int numThreads);
+
+  void setStrategy(Strategy strategy) { strategy_ = strategy; }
+
+  /// Default timeout of calls, in seconds, 0 for none.
+  /// Timeouts count as failures of backend, so set it for ejection.
+  /// Must be called before start().
+  void setCallTimeout(double seconds) { callTimeout_ = seconds; }
+
+  /// Ejects a backend for seconds after maxFailures consecutive failures,
+  /// default 5 failures and 10 seconds.
+  void setEjection(int maxFailures, double seconds)
+  {
+    maxFailures_ = maxFailures;
+    ejectionTime_ = seconds;
+  }
+
+  /// Must be called in loop thread, before any call.
+  void start();
+
+  void CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                  ::google::protobuf::RpcController* controller,
+                  const ::google::protobuf::Message* request,
+                  ::google::protobuf::Message* response,
+                  ::google::protobuf::Closure* done) override;
+
+  int numConnected();
+  /// Outstanding calls of all connections.
+  int numOutstandingCalls();
+
+ private:
+  struct Backend;
+  struct Connection;
+  class Call;
+
+  void onConnection(Connection* c, const TcpConnectionPtr& conn);
+  static void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+  void onCallDone(Call* call);
+  void onFailure(Backend* backend);
+
+  static bool isAvailable(Connection* c, int64_t now);
+  Connection* pick();
+  Connection* pickLeastOutstanding(int64_t now, bool ignoreEjection);
+  Connection* pickPowerOfTwo(int64_t now);
+
+  EventLoop* loop_;
+  const string name_;
+  const int connectionsPerBackend_;
+  std::unique_ptr<EventLoopThreadPool> threadPool_;
+  Strategy strategy_;
+  double callTimeout_;
+  int maxFailures_;
+  double ejectionTime_;
+  std::vector<std::unique_ptr<Backend>> backends_;
+  std::vector<std::unique_ptr<Connection>> connections_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCCLIENTPOOL_H
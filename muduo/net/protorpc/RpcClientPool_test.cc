@@ -0,0 +1,325 @@
+#include "muduo/net/protorpc/RpcClientPool.h"
+#include "muduo/net/protorpc/RpcServer.h"
+#include "muduo/net/protorpc/rpcservice.pb.h"
+#include "muduo/net/EventLoop.h"
+
+#include <google/protobuf/descriptor.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 27810;
+// of a request with list_method
+const double kLate = 1.0;
+
+// answers listRpc with its name, after kLate seconds
+// if list_method is set, or it is always late.
+class NamedService : public RpcService
+{
+ public:
+  NamedService(EventLoop* loop, const string& name, bool alwaysLate)
+    : loop_(loop),
+      name_(name),
+      alwaysLate_(alwaysLate),
+      served_(0)
+  {
+  }
+
+  void listRpc(::google::protobuf::RpcController*,
+               const ListRpcRequest* request,
+               ListRpcResponse* response,
+               ::google::protobuf::Closure* done) override
+  {
+    ++served_;
+    response->set_error(NO_ERROR);
+    response->add_service_name(name_);
+    if (alwaysLate_ || request->list_method())
+    {
+      loop_->runAfter(kLate, [done] { done->Run(); });
+    }
+    else
+    {
+      done->Run();
+    }
+  }
+
+  void getService(::google::protobuf::RpcController*,
+                  const GetServiceRequest*,
+                  GetServiceResponse* response,
+                  ::google::protobuf::Closure* done) override
+  {
+    response->set_error(NO_SERVICE);
+    done->Run();
+  }
+
+  int served() const { return served_; }
+
+ private:
+  EventLoop* loop_;
+  const string name_;
+  const bool alwaysLate_;
+  std::atomic<int> served_;
+};
+
+struct Backend
+{
+  Backend(EventLoop* loop, const string& name, uint16_t port, bool alwaysLate = false)
+    : service(loop, name, alwaysLate),
+      server(loop, InetAddress("127.0.0.1", port))
+  {
+    server.registerService(&service);
+    server.start();
+  }
+
+  NamedService service;
+  RpcServer server;
+};
+
+class Controller : public ::google::protobuf::RpcController
+{
+ public:
+  void Reset() override { failure_.clear(); }
+  bool Failed() const override { return !failure_.empty(); }
+  std::string ErrorText() const override { return failure_; }
+  void StartCancel() override { }
+  void SetFailed(const std::string& reason) override { failure_ = reason; }
+  bool IsCanceled() const override { return false; }
+  void NotifyOnCancel(::google::protobuf::Closure*) override { }
+
+ private:
+  std::string failure_;
+};
+
+struct Result
+{
+  Result() : done(0) { }
+
+  Controller controller;
+  int done;
+  string answer;
+};
+
+// the channel deletes response after running done
+void onDone(Result* result, ListRpcResponse* response)
+{
+  ++result->done;
+  if (response->service_name_size() > 0)
+  {
+    result->answer = response->service_name(0);
+  }
+}
+
+// backends "a" and "b", and a pool of them, which ejects a backend
+// for 10 seconds after 2 failures.
+struct Fixture
+{
+  explicit Fixture(bool aAlwaysLate = false)
+  {
+    backends.push_back(InetAddress("127.0.0.1", kPort));
+    backends.push_back(InetAddress("127.0.0.1", static_cast<uint16_t>(kPort + 1)));
+    a.reset(new Backend(&loop, "a", kPort, aAlwaysLate));
+    b.reset(new Backend(&loop, "b", static_cast<uint16_t>(kPort + 1)));
+  }
+
+  ~Fixture()
+  {
+    pool.reset();
+    runFor(0.1);
+  }
+
+  // also runs what was queued from outside the loop
+  void runFor(double seconds)
+  {
+    loop.wakeup();
+    loop.runAfter(seconds, [this] { loop.quit(); });
+    loop.loop();
+  }
+
+  void start(RpcClientPool::Strategy strategy, int numThreads, int connectionsPerBackend,
+             double callTimeout = 0.0)
+  {
+    pool.reset(new RpcClientPool(&loop, backends, "PoolTest", connectionsPerBackend));
+    pool->setStrategy(strategy);
+    pool->setThreadNum(numThreads);
+    pool->setCallTimeout(callTimeout);
+    pool->setEjection(2, 10.0);
+    pool->start();
+    waitConnected(2 * connectionsPerBackend);
+  }
+
+  void waitConnected(int n)
+  {
+    for (int i = 0; i < 100 && pool->numConnected() < n; ++i)
+    {
+      runFor(0.05);
+    }
+    BOOST_REQUIRE_EQUAL(pool->numConnected(), n);
+  }
+
+  void call(Result* result, bool late)
+  {
+    ListRpcRequest request;
+    request.set_list_method(late);
+    ListRpcResponse* response = new ListRpcResponse;
+    pool->CallMethod(RpcService::descriptor()->FindMethodByName("listRpc"),
+                     &result->controller, &request, response,
+                     ::google::protobuf::NewCallback(onDone, result, response));
+  }
+
+  EventLoop loop;
+  std::vector<InetAddress> backends;
+  std::unique_ptr<Backend> a;
+  std::unique_ptr<Backend> b;
+  std::unique_ptr<RpcClientPool> pool;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testPowerOfTwoChoices)
+{
+  Fixture f;
+  f.start(RpcClientPool::kPowerOfTwoChoices, 0, 1);
+  Result late;
+  f.call(&late, true);
+  f.runFor(0.05);
+
+  // the two choices are always both connections, so the busy one is never picked
+  Result results[20];
+  for (Result& result : results)
+  {
+    f.call(&result, false);
+    f.runFor(0.02);
+  }
+  Backend* busy = f.a->service.served() == 1 ? get_pointer(f.a) : get_pointer(f.b);
+  Backend* idle = busy == get_pointer(f.a) ? get_pointer(f.b) : get_pointer(f.a);
+  BOOST_CHECK_EQUAL(busy->service.served(), 1);
+  BOOST_CHECK_EQUAL(idle->service.served(), 20);
+  for (const Result& result : results)
+  {
+    BOOST_CHECK_EQUAL(result.done, 1);
+    BOOST_CHECK(!result.controller.Failed());
+  }
+
+  f.runFor(kLate);
+  BOOST_CHECK_EQUAL(late.done, 1);
+  BOOST_CHECK(!late.controller.Failed());
+}
+
+BOOST_AUTO_TEST_CASE(testEjectAfterTimeouts)
+{
+  Fixture f(true);
+  f.start(RpcClientPool::kLeastOutstanding, 0, 1, 0.1);
+
+  // two at a time, one to each backend while none is ejected
+  std::vector<std::unique_ptr<Result>> results;
+  for (int i = 0; i < 12; ++i)
+  {
+    for (int j = 0; j < 2; ++j)
+    {
+      results.emplace_back(new Result);
+      f.call(get_pointer(results.back()), false);
+    }
+    f.runFor(0.15);
+  }
+  BOOST_CHECK_EQUAL(f.a->service.served(), 2);
+  BOOST_CHECK_EQUAL(f.b->service.served(), 22);
+  int timeouts = 0;
+  for (const std::unique_ptr<Result>& result : results)
+  {
+    BOOST_CHECK_EQUAL(result->done, 1);
+    if (result->controller.Failed())
+    {
+      BOOST_CHECK_EQUAL(result->controller.ErrorText(), "TIMEOUT");
+      ++timeouts;
+    }
+    else
+    {
+      BOOST_CHECK_EQUAL(result->answer, "b");
+    }
+  }
+  BOOST_CHECK_EQUAL(timeouts, 2);
+  BOOST_CHECK_EQUAL(f.pool->numOutstandingCalls(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testDisconnectCountsOnce)
+{
+  Fixture f;
+  f.start(RpcClientPool::kLeastOutstanding, 0, 1);
+
+  // two outstanding calls on each backend
+  Result late[4];
+  for (Result& result : late)
+  {
+    f.call(&result, true);
+  }
+  f.runFor(0.05);
+  BOOST_CHECK_EQUAL(f.a->service.served(), 2);
+  BOOST_CHECK_EQUAL(f.b->service.served(), 2);
+
+  // its sockets are closed after the pending responses are dropped
+  f.a.reset();
+  f.runFor(kLate + 0.1);
+  BOOST_CHECK_EQUAL(f.pool->numConnected(), 1);
+  int canceled = 0;
+  for (const Result& result : late)
+  {
+    if (result.done == 1 && result.controller.ErrorText() == "CANCELED")
+    {
+      ++canceled;
+    }
+  }
+  BOOST_CHECK_EQUAL(canceled, 2);
+
+  // one failure of maxFailures 2, so it is not ejected after reconnecting
+  f.a.reset(new Backend(&f.loop, "a", kPort));
+  f.waitConnected(2);
+  Result results[4];
+  for (Result& result : results)
+  {
+    f.call(&result, false);
+  }
+  f.runFor(0.05);
+  BOOST_CHECK_GT(f.a->service.served(), 0);
+  for (const Result& result : results)
+  {
+    BOOST_CHECK_EQUAL(result.done, 1);
+    BOOST_CHECK(!result.controller.Failed());
+  }
+  f.runFor(kLate);
+}
+
+BOOST_AUTO_TEST_CASE(testTeardown)
+{
+  Fixture f;
+  // connections in other threads
+  f.start(RpcClientPool::kLeastOutstanding, 2, 2);
+  Result late[8];
+  for (Result& result : late)
+  {
+    f.call(&result, true);
+  }
+  f.runFor(0.05);
+  BOOST_CHECK_EQUAL(f.pool->numOutstandingCalls(), 8);
+
+  f.pool.reset();
+  for (const Result& result : late)
+  {
+    BOOST_CHECK_EQUAL(result.done, 1);
+    BOOST_CHECK_EQUAL(result.controller.ErrorText(), "CANCELED");
+  }
+  // late responses go nowhere
+  f.runFor(kLate + 0.1);
+  for (const Result& result : late)
+  {
+    BOOST_CHECK_EQUAL(result.done, 1);
+  }
+}
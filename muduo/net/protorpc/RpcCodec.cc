@@ -15,6 +15,9 @@
 #include "muduo/net/protorpc/rpc.pb.h"
 #include "muduo/net/protorpc/google-inl.h"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -35,3 +38,69 @@ namespace net
 const char rpctag [] = "RPC0";
 }
 }
+
+RpcEnvelopeCodec::RpcEnvelopeCodec(const ProtobufMessageCallback& messageCb)
+  : ProtobufCodecLite(&RpcMessage::default_instance(), rpctag, messageCb)
+{
+}
+
+bool RpcEnvelopeCodec::parseFromBuffer(StringPiece buf, google::protobuf::Message* message)
+{
+  using google::protobuf::internal::WireFormatLite;
+  payload_.clear();
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buf.data());
+  google::protobuf::io::CodedInputStream input(data, buf.size());
+  // [fieldBegin, fieldEnd) is the payload field, including its tag.
+  int fieldBegin = buf.size();
+  int fieldEnd = buf.size();
+  bool found = false;
+  while (true)
+  {
+    const int pos = input.CurrentPosition();
+    const uint32_t tag = input.ReadTag();
+    if (tag == 0)
+    {
+      break;
+    }
+    const int field = WireFormatLite::GetTagFieldNumber(tag);
+    if ((field == RpcMessage::kRequestFieldNumber || field == RpcMessage::kResponseFieldNumber)
+        && WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+    {
+      uint32_t len = 0;
+      if (found || !input.ReadVarint32(&len))
+      {
+        // more than one payload, never sent by RpcChannel
+        payload_.clear();
+        return false;
+      }
+      payload_.set(buf.data() + input.CurrentPosition(), static_cast<int>(len));
+      if (!input.Skip(static_cast<int>(len)))
+      {
+        payload_.clear();
+        return false;
+      }
+      fieldBegin = pos;
+      fieldEnd = input.CurrentPosition();
+      found = true;
+    }
+    else if (!WireFormatLite::SkipField(&input, tag))
+    {
+      return false;
+    }
+  }
+
+  // the payload field is the last one normally
+  if (!message->ParsePartialFromArray(data, fieldBegin))
+  {
+    return false;
+  }
+  if (fieldEnd < buf.size())
+  {
+    google::protobuf::io::CodedInputStream rest(data + fieldEnd, buf.size() - fieldEnd);
+    if (!message->MergePartialFromCodedStream(&rest))
+    {
+      return false;
+    }
+  }
+  return message->IsInitialized();
+}
@@ -31,14 +31,36 @@ extern const char rpctag[];// = "RPC0";
 //
 // Field     Length  Content
 //
-// size      4-byte  N+8
+// size      4-byte  N+8, highest 4 bits are the checksum type
 // "RPC0"    4-byte
 // payload   N-byte
-// checksum  4-byte  adler32 of "RPC0"+payload
+// checksum  4-byte  adler32 (default) of "RPC0"+payload
 //
 
 typedef ProtobufCodecLiteT<RpcMessage, rpctag> RpcCodec;
 
+/// Codec of RpcMessage for RpcChannel, same wire format as RpcCodec.
+///
+/// Doesn't copy request or response bytes into the decoded message,
+/// payload() refers to them in the input buffer instead, so user messages
+/// are parsed in place. Send them with
+/// send(conn, envelope, RpcMessage::kRequestFieldNumber, request),
+/// which serializes request directly after the envelope.
+class RpcEnvelopeCodec : public ProtobufCodecLite
+{
+ public:
+  explicit RpcEnvelopeCodec(const ProtobufMessageCallback& messageCb);
+
+  /// request or response bytes of the message passing to messageCb,
+  /// data() is NULL if absent. Valid only in messageCb.
+  StringPiece payload() const { return payload_; }
+
+  bool parseFromBuffer(StringPiece buf, google::protobuf::Message* message) override;
+
+ private:
+  StringPiece payload_;
+};
+
 }  // namespace net
 }  // namespace muduo
 
@@ -0,0 +1,86 @@
+#include "muduo/net/protorpc/RpcCodec.h"
+#include "muduo/net/protorpc/rpc.pb.h"
+#include "muduo/net/protobuf/ProtobufCodecLite.h"
+#include "muduo/net/Buffer.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+int g_received = 0;
+
+void messageCallback(const TcpConnectionPtr&,
+                     const MessagePtr&,
+                     Timestamp)
+{
+  ++g_received;
+}
+
+void checksumOnly(ProtobufCodecLite::ChecksumType type, const string& data, int loops)
+{
+  uint32_t sum = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < loops; ++i)
+  {
+    sum += static_cast<uint32_t>(ProtobufCodecLite::checksum(type, data.data(), static_cast<int>(data.size())));
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("  checksum %-8s %9.1f MiB/s  %08x\n",
+         ProtobufCodecLite::checksumTypeToString(type),
+         static_cast<double>(data.size()) * loops / seconds / 1024 / 1024,
+         sum);
+}
+
+void encodeDecode(ProtobufCodecLite::ChecksumType type, const RpcMessage& message, int loops)
+{
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  codec.setChecksumType(type);
+  codec.setAcceptNoChecksum(true);
+  codec.setReuseMessage(true);
+  g_received = 0;
+  size_t bytes = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < loops; ++i)
+  {
+    Buffer buf;
+    codec.fillEmptyBuffer(&buf, message);
+    bytes += buf.readableBytes();
+    codec.onMessage(TcpConnectionPtr(), &buf, start);
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  assert(g_received == loops); (void) g_received;
+  printf("  codec    %-8s %9.1f MiB/s  %9.0f msg/s\n",
+         ProtobufCodecLite::checksumTypeToString(type),
+         static_cast<double>(bytes) / seconds / 1024 / 1024,
+         loops / seconds);
+}
+
+int main(int argc, char* argv[])
+{
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+  const size_t kTotal = argc > 1 ? atoi(argv[1]) * 1024 * 1024 : 1024 * 1024 * 1024;
+  const size_t sizes[] = { 64, 1024, 64*1024, 1024*1024, 16*1024*1024 };
+  for (size_t size : sizes)
+  {
+    RpcMessage message;
+    message.set_type(REQUEST);
+    message.set_id(1);
+    message.set_service("EchoService");
+    message.set_method("Echo");
+    message.set_request(string(size, 'x'));
+    int loops = static_cast<int>(kTotal / size);
+    if (loops > 1000000)
+      loops = 1000000;
+    printf("payload %zu bytes, %d loops\n", size, loops);
+    for (int type = ProtobufCodecLite::kAdler32; type < ProtobufCodecLite::kNoChecksum; ++type)
+    {
+      checksumOnly(static_cast<ProtobufCodecLite::ChecksumType>(type), message.request(), loops);
+    }
+    for (int type = ProtobufCodecLite::kAdler32; type < ProtobufCodecLite::kNumChecksumTypes; ++type)
+    {
+      encodeDecode(static_cast<ProtobufCodecLite::ChecksumType>(type), message, loops);
+    }
+  }
+  google::protobuf::ShutdownProtobufLibrary();
+}
@@ -4,6 +4,8 @@
 #include "muduo/net/protobuf/ProtobufCodecLite.h"
 #include "muduo/net/Buffer.h"
 
+#include <vector>
+
 #include <stdio.h>
 
 using namespace muduo;
@@ -23,6 +25,22 @@ void messageCallback(const TcpConnectionPtr&,
   g_msgptr = msg;
 }
 
+std::vector<MessagePtr> g_kept;
+void keepCallback(const TcpConnectionPtr&,
+                  const MessagePtr& msg,
+                  Timestamp)
+{
+  g_kept.push_back(msg);
+}
+
+std::vector<const google::protobuf::Message*> g_seen;
+void recordCallback(const TcpConnectionPtr&,
+                    const MessagePtr& msg,
+                    Timestamp)
+{
+  g_seen.push_back(get_pointer(msg));
+}
+
 void print(const Buffer& buf)
 {
   printf("encoded to %zd bytes\n", buf.readableBytes());
@@ -77,5 +95,185 @@ int main()
   assert(g_msgptr->DebugString() == message.DebugString());
   }
 
+  {
+  // messages in one batch reuse the same object, unless the callback keeps it.
+  Buffer buf;
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", recordCallback);
+  codec.setReuseMessage(true);
+  for (int i = 0; i < 3; ++i)
+  {
+    Buffer frame;
+    codec.fillEmptyBuffer(&frame, message);
+    buf.append(frame.toStringPiece());
+  }
+  codec.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+  assert(buf.readableBytes() == 0);
+  assert(g_seen.size() == 3);
+  assert(g_seen[0] == g_seen[1] && g_seen[1] == g_seen[2]);
+  g_seen.clear();
+  }
+
+  {
+  Buffer buf;
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  codec.setUseArena(true);
+  codec.setReuseMessage(true);
+  for (int i = 0; i < 3; ++i)
+  {
+    Buffer frame;
+    codec.fillEmptyBuffer(&frame, message);
+    buf.append(frame.toStringPiece());
+  }
+  codec.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+  assert(buf.readableBytes() == 0);
+  assert(g_msgptr);
+  assert(g_msgptr->GetArena() != NULL);
+  // the arena outlives onMessage()
+  assert(g_msgptr->DebugString() == message.DebugString());
+  g_msgptr.reset();
+  }
+
+  {
+  // messages kept by the callback share the arena of their batch,
+  // the next batch gets a new one
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", keepCallback);
+  codec.setUseArena(true);
+  for (int batch = 0; batch < 2; ++batch)
+  {
+    Buffer buf;
+    for (int i = 0; i < 3; ++i)
+    {
+      RpcMessage m(message);
+      m.set_id(batch * 3 + i);
+      Buffer frame;
+      codec.fillEmptyBuffer(&frame, m);
+      buf.append(frame.toStringPiece());
+    }
+    codec.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+    assert(buf.readableBytes() == 0);
+  }
+  assert(g_kept.size() == 6);
+  for (size_t i = 0; i < g_kept.size(); ++i)
+  {
+    assert(g_kept[i]->GetArena() != NULL);
+    assert(g_kept[i]->GetArena() == g_kept[i / 3 * 3]->GetArena());
+    assert(static_cast<const RpcMessage&>(*g_kept[i]).id() == static_cast<uint64_t>(i));
+  }
+  assert(g_kept[0]->GetArena() != g_kept[3]->GetArena());
+  // the first batch goes away with its last message
+  g_kept.erase(g_kept.begin(), g_kept.begin() + 3);
+  assert(static_cast<const RpcMessage&>(*g_kept[0]).id() == 3u);
+  g_kept.clear();
+  }
+
+  {
+  // known answers
+  const char digits[] = "123456789";
+  assert(ProtobufCodecLite::checksum(ProtobufCodecLite::kCrc32c, digits, 9)
+         == static_cast<int32_t>(0xe3069283));
+  assert(ProtobufCodecLite::checksum(ProtobufCodecLite::kXxHash32, "", 0)
+         == static_cast<int32_t>(0x02cc5d05));
+  assert(ProtobufCodecLite::checksum(ProtobufCodecLite::kAdler32, digits, 9)
+         == ProtobufCodecLite::checksum(digits, 9));
+  }
+
+  for (int type = ProtobufCodecLite::kAdler32; type < ProtobufCodecLite::kNumChecksumTypes; ++type)
+  {
+  ProtobufCodecLite::ChecksumType checksumType = static_cast<ProtobufCodecLite::ChecksumType>(type);
+  RpcMessage big;
+  big.set_type(REQUEST);
+  big.set_id(type);
+  big.set_request(string(100000 + type, 'x'));
+
+  Buffer buf;
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  codec.setChecksumType(checksumType);
+  codec.fillEmptyBuffer(&buf, big);
+  // backward compatible
+  assert((static_cast<uint32_t>(buf.peekInt32()) >> 28) == static_cast<uint32_t>(type));
+
+  ProtobufCodecLite decoder(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  decoder.setAcceptNoChecksum(true);
+  decoder.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+  assert(buf.readableBytes() == 0);
+  assert(g_msgptr);
+  assert(g_msgptr->DebugString() == big.DebugString());
+  g_msgptr.reset();
+
+  if (checksumType != ProtobufCodecLite::kNoChecksum)
+  {
+    Buffer corrupted;
+    codec.fillEmptyBuffer(&corrupted, big);
+    const_cast<char*>(corrupted.peek())[1000] ^= 1;
+    ProtobufCodecLite::ErrorCode error = ProtobufCodecLite::kNoError;
+    ProtobufCodecLite strict(&RpcMessage::default_instance(), "RPC0", messageCallback,
+                             ProtobufCodecLite::RawMessageCallback(),
+                             [&error](const TcpConnectionPtr&, Buffer*, Timestamp,
+                                      ProtobufCodecLite::ErrorCode e)
+                             { error = e; });
+    strict.onMessage(TcpConnectionPtr(), &corrupted, Timestamp::now());
+    assert(error == ProtobufCodecLite::kCheckSumError);
+    assert(!g_msgptr);
+  }
+  else
+  {
+    // not accepted by default
+    Buffer unchecked;
+    codec.fillEmptyBuffer(&unchecked, big);
+    ProtobufCodecLite::ErrorCode error = ProtobufCodecLite::kNoError;
+    ProtobufCodecLite strict(&RpcMessage::default_instance(), "RPC0", messageCallback,
+                             ProtobufCodecLite::RawMessageCallback(),
+                             [&error](const TcpConnectionPtr&, Buffer*, Timestamp,
+                                      ProtobufCodecLite::ErrorCode e)
+                             { error = e; });
+    strict.onMessage(TcpConnectionPtr(), &unchecked, Timestamp::now());
+    assert(error == ProtobufCodecLite::kUnknownChecksumType);
+    assert(!g_msgptr);
+  }
+  }
+
+  {
+  // nested payload has the same wire format as bytes field
+  RpcMessage request;
+  request.set_type(REQUEST);
+  request.set_id(7);
+  request.set_service("muduo.net.RpcService");
+  request.set_method("listRpc");
+  RpcMessage envelope = request;
+  envelope.set_id(8);
+  request.set_request(envelope.SerializeAsString());
+
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  Buffer whole;
+  codec.fillEmptyBuffer(&whole, request);
+  RpcMessage header = request;
+  header.clear_request();
+  Buffer nested;
+  codec.fillEmptyBuffer(&nested, header, RpcMessage::kRequestFieldNumber, envelope);
+  assert(whole.toStringPiece() == nested.toStringPiece());
+
+  StringPiece payload;
+  RpcEnvelopeCodec* decoder = NULL;
+  RpcEnvelopeCodec envelopeCodec([&](const TcpConnectionPtr&, const MessagePtr& msg, Timestamp)
+                                 {
+                                   const RpcMessage& m = static_cast<const RpcMessage&>(*msg);
+                                   assert(m.id() == 7);
+                                   assert(!m.has_request());
+                                   assert(m.method() == "listRpc");
+                                   payload = decoder->payload();
+                                   RpcMessage inner;
+                                   bool parsed = inner.ParseFromArray(payload.data(), payload.size());
+                                   assert(parsed);
+                                   assert(inner.DebugString() == envelope.DebugString());
+                                 });
+  decoder = &envelopeCodec;
+  const char* begin = nested.peek();
+  const char* end = begin + nested.readableBytes();
+  envelopeCodec.onMessage(TcpConnectionPtr(), &nested, Timestamp::now());
+  assert(nested.readableBytes() == 0);
+  // parsed in place
+  assert(payload.data() > begin && payload.end() < end);
+  }
+
   google::protobuf::ShutdownProtobufLibrary();
 }
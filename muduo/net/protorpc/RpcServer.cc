@@ -19,7 +19,8 @@ using namespace muduo::net;
 
 RpcServer::RpcServer(EventLoop* loop,
                      const InetAddress& listenAddr)
-  : server_(loop, listenAddr, "RpcServer")
+  : server_(loop, listenAddr, "RpcServer"),
+    started_(false)
 {
   server_.setConnectionCallback(
       std::bind(&RpcServer::onConnection, this, _1));
@@ -29,12 +30,69 @@ RpcServer::RpcServer(EventLoop* loop,
 
 void RpcServer::registerService(google::protobuf::Service* service)
 {
+  if (started_)
+  {
+    LOG_FATAL << "RpcServer::registerService - after start()";
+  }
   const google::protobuf::ServiceDescriptor* desc = service->GetDescriptor();
   services_[desc->full_name()] = service;
+
+  for (int i = 0; i < desc->method_count(); ++i)
+  {
+    RpcChannel::MethodEntry entry = { RpcChannel::methodId(desc->method(i)), service, desc->method(i),
+                                      NULL, 0, std::make_shared<AtomicInt32>() };
+    const RpcChannel::MethodEntry* old = methods_.find(entry.id);
+    if (old && old->method->full_name() != entry.method->full_name())
+    {
+      LOG_FATAL << "RpcServer::registerService - method id collision "
+                << old->method->full_name() << " " << entry.method->full_name();
+    }
+    methods_.insert(entry);
+  }
+}
+
+void RpcServer::setExecutionPolicy(const string& name, ThreadPool* pool, int maxConcurrency)
+{
+  if (started_)
+  {
+    LOG_FATAL << "RpcServer::setExecutionPolicy - after start()";
+  }
+  bool found = false;
+  for (RpcChannel::MethodEntry& entry : methods_)
+  {
+    if (entry.method->full_name() == name || entry.method->service()->full_name() == name)
+    {
+      entry.pool = pool;
+      entry.maxConcurrency = maxConcurrency;
+      found = true;
+    }
+  }
+  if (!found)
+  {
+    LOG_FATAL << "RpcServer::setExecutionPolicy - unknown service or method " << name;
+  }
+}
+
+void RpcServer::registerStream(const google::protobuf::MethodDescriptor* method,
+                               const RpcChannel::StreamCallback& cb)
+{
+  if (started_)
+  {
+    LOG_FATAL << "RpcServer::registerStream - after start()";
+  }
+  RpcChannel::StreamEntry entry = { RpcChannel::methodId(method), method, cb };
+  const RpcChannel::StreamEntry* old = streams_.find(entry.id);
+  if (old && old->method->full_name() != entry.method->full_name())
+  {
+    LOG_FATAL << "RpcServer::registerStream - method id collision "
+              << old->method->full_name() << " " << entry.method->full_name();
+  }
+  streams_.insert(entry);
 }
 
 void RpcServer::start()
 {
+  started_ = true;
   server_.start();
 }
 
@@ -47,6 +105,8 @@ void RpcServer::onConnection(const TcpConnectionPtr& conn)
   {
     RpcChannelPtr channel(new RpcChannel(conn));
     channel->setServices(&services_);
+    channel->setMethods(&methods_);
+    channel->setStreams(&streams_);
     conn->setMessageCallback(
         std::bind(&RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
     conn->setContext(channel);
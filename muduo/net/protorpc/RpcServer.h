@@ -12,6 +12,7 @@
 #define MUDUO_NET_PROTORPC_RPCSERVER_H
 
 #include "muduo/net/TcpServer.h"
+#include "muduo/net/protorpc/RpcChannel.h"
 
 namespace google {
 namespace protobuf {
@@ -37,7 +38,27 @@ class RpcServer
     server_.setThreadNum(numThreads);
   }
 
+  /// Must be called before start(). Aborts if two methods have the same
+  /// RpcChannel::methodId(), then rename one of them.
   void registerService(::google::protobuf::Service*);
+
+  /// Execution policy of a service, or a method, eg. "sudoku.SudokuService.Solve".
+  /// - pool is NULL, runs in I/O thread, default
+  /// - otherwise runs in pool, response is sent back by I/O thread of the connection,
+  ///   requests fail with OVERLOADED if the queue of pool is full,
+  ///   see ThreadPool::setMaxQueueSize().
+  /// At most maxConcurrency requests of each method are running or queued,
+  /// others fail immediately with OVERLOADED, 0 for unlimited.
+  /// Must be called after registerService() and before start().
+  void setExecutionPolicy(const string& name, ThreadPool* pool, int maxConcurrency = 0);
+
+  /// Accepts streams of method opened by clients, see RpcStream.
+  /// cb runs in I/O thread of the connection, sets callbacks of the stream.
+  /// method needs not be of a registered service.
+  /// Must be called before start().
+  void registerStream(const ::google::protobuf::MethodDescriptor* method,
+                      const RpcChannel::StreamCallback& cb);
+
   void start();
 
  private:
@@ -49,6 +70,10 @@ class RpcServer
 
   TcpServer server_;
   std::map<std::string, ::google::protobuf::Service*> services_;
+  RpcChannel::MethodTable methods_;
+  RpcChannel::StreamTable streams_;
+  // tables above are read by channels without lock
+  bool started_;
 };
 
 }  // namespace net
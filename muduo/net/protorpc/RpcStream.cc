@@ -0,0 +1,436 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protorpc/RpcStream.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/rpc.pb.h"
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include <vector>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// at least one byte each, so empty messages are flow controlled too.
+int64_t cost(const string& data)
+{
+  return static_cast<int64_t>(data.size()) + 1;
+}
+
+const google::protobuf::Message* incomingPrototype(const google::protobuf::MethodDescriptor* method,
+                                                   bool opener)
+{
+  return google::protobuf::MessageFactory::generated_factory()->GetPrototype(
+      opener ? method->output_type() : method->input_type());
+}
+
+}  // namespace
+
+RpcStream::RpcStream(const std::shared_ptr<RpcChannel>& channel,
+                     EventLoop* loop,
+                     int64_t id,
+                     const google::protobuf::MethodDescriptor* method,
+                     bool opener)
+  : channel_(channel),
+    loop_(loop),
+    id_(id),
+    method_(method),
+    prototype_(incomingPrototype(method, opener)),
+    opener_(opener),
+    pendingBytes_(0),
+    sendWindow_(kInitialWindow),
+    opened_(!opener),  // by peer
+    closing_(false),
+    aborted_(false),
+    blocked_(false),
+    flushScheduled_(false),
+    wantWritable_(false),
+    openSent_(!opener),
+    endSent_(false),
+    remoteClosed_(false),
+    closeNotified_(false),
+    removed_(false),
+    paused_(false),
+    consumed_(0),
+    grant_(0)
+{
+  assert(prototype_ != NULL);
+}
+
+void RpcStream::open()
+{
+  {
+  MutexLockGuard lock(mutex_);
+  if (opened_ || aborted_)
+  {
+    return;
+  }
+  opened_ = true;
+  // openInLoop() flushes
+  flushScheduled_ = true;
+  }
+  RpcStreamPtr self(shared_from_this());
+  loop_->runInLoop([self] { self->openInLoop(); });
+}
+
+void RpcStream::openInLoop()
+{
+  {
+  MutexLockGuard lock(mutex_);
+  if (aborted_)
+  {
+    return;
+  }
+  }
+  RpcChannelPtr channel(channel_.lock());
+  if (!channel || !channel->attachStream(shared_from_this()))
+  {
+    abort("UNAVAILABLE");
+    return;
+  }
+  flush();
+}
+
+bool RpcStream::write(const google::protobuf::Message& message)
+{
+  string data;
+  // same as unary calls, receiver checks required fields
+  message.AppendPartialToString(&data);
+  bool schedule = false;
+  bool ok = false;
+  {
+  MutexLockGuard lock(mutex_);
+  if (closing_ || aborted_)
+  {
+    return false;
+  }
+  pendingBytes_ += cost(data);
+  pending_.push_back(std::move(data));
+  if (opened_ && !flushScheduled_)
+  {
+    flushScheduled_ = true;
+    schedule = true;
+  }
+  ok = !blocked_ && pendingBytes_ < sendWindow_;
+  if (!ok)
+  {
+    wantWritable_ = true;
+  }
+  }
+  if (schedule)
+  {
+    // not runInLoop(), batches writes of this iteration of loop
+    loop_->queueInLoop(std::bind(&RpcStream::flush, shared_from_this()));
+  }
+  return ok;
+}
+
+bool RpcStream::writable() const
+{
+  MutexLockGuard lock(mutex_);
+  return !closing_ && !aborted_ && !blocked_ && pendingBytes_ < sendWindow_;
+}
+
+size_t RpcStream::pendingBytes() const
+{
+  MutexLockGuard lock(mutex_);
+  return static_cast<size_t>(pendingBytes_);
+}
+
+void RpcStream::close()
+{
+  bool schedule = false;
+  {
+  MutexLockGuard lock(mutex_);
+  if (closing_ || aborted_)
+  {
+    return;
+  }
+  closing_ = true;
+  if (opened_ && !flushScheduled_)
+  {
+    flushScheduled_ = true;
+    schedule = true;
+  }
+  }
+  if (schedule)
+  {
+    loop_->queueInLoop(std::bind(&RpcStream::flush, shared_from_this()));
+  }
+}
+
+void RpcStream::reset()
+{
+  {
+  MutexLockGuard lock(mutex_);
+  if (aborted_)
+  {
+    return;
+  }
+  aborted_ = true;
+  pending_.clear();
+  pendingBytes_ = 0;
+  }
+  RpcStreamPtr self(shared_from_this());
+  loop_->runInLoop([self] { self->resetInLoop(CANCELED); });
+}
+
+void RpcStream::resetInLoop(int error)
+{
+  loop_->assertInLoopThread();
+  RpcChannelPtr channel(channel_.lock());
+  if (channel && openSent_)
+  {
+    RpcMessage frame;
+    frame.set_type(opener_ ? STREAM : STREAM_REPLY);
+    frame.set_id(id_);
+    frame.set_error(static_cast<ErrorCode>(error));
+    channel->sendStreamFrame(frame);
+  }
+  finish(ErrorCode_Name(static_cast<ErrorCode>(error)));
+  removeIfDone();
+}
+
+void RpcStream::pauseReading()
+{
+  loop_->assertInLoopThread();
+  paused_ = true;
+}
+
+void RpcStream::resumeReading()
+{
+  loop_->assertInLoopThread();
+  paused_ = false;
+  if (consumed_ > 0)
+  {
+    grant_ += consumed_;
+    consumed_ = 0;
+    scheduleFlush();
+  }
+}
+
+void RpcStream::setBlocked(bool blocked)
+{
+  {
+  MutexLockGuard lock(mutex_);
+  blocked_ = blocked;
+  }
+  if (!blocked)
+  {
+    scheduleFlush();
+  }
+}
+
+void RpcStream::scheduleFlush()
+{
+  {
+  MutexLockGuard lock(mutex_);
+  if (!opened_ || aborted_ || flushScheduled_)
+  {
+    return;
+  }
+  flushScheduled_ = true;
+  }
+  loop_->queueInLoop(std::bind(&RpcStream::flush, shared_from_this()));
+}
+
+void RpcStream::flush()
+{
+  loop_->assertInLoopThread();
+  RpcChannelPtr channel(channel_.lock());
+  if (!channel)
+  {
+    abort("UNAVAILABLE");
+    return;
+  }
+
+  std::vector<RpcMessage> frames;
+  bool notify = false;
+  {
+  MutexLockGuard lock(mutex_);
+  flushScheduled_ = false;
+  if (aborted_)
+  {
+    return;
+  }
+  bool more = true;
+  while (more)
+  {
+    RpcMessage frame;
+    frame.set_type(opener_ ? STREAM : STREAM_REPLY);
+    frame.set_id(id_);
+    bool useful = false;
+    if (!openSent_)
+    {
+      frame.set_method_id(RpcChannel::methodId(method_));
+      openSent_ = true;
+      useful = true;
+    }
+    if (grant_ > 0)
+    {
+      frame.set_window(static_cast<uint32_t>(grant_));
+      grant_ = 0;
+      useful = true;
+    }
+    int64_t batch = 0;
+    while (!blocked_ && !pending_.empty() && batch < kMaxBatchBytes)
+    {
+      int64_t n = cost(pending_.front());
+      // never beyond the window, except a message larger than the whole window,
+      // which goes alone once nothing is in flight, or it would never go.
+      if (n > sendWindow_ && !(n > kInitialWindow && sendWindow_ >= kInitialWindow && batch == 0))
+      {
+        break;
+      }
+      frame.add_stream_data()->swap(pending_.front());
+      pending_.pop_front();
+      pendingBytes_ -= n;
+      sendWindow_ -= n;
+      batch += n;
+    }
+    if (closing_ && pending_.empty() && !endSent_)
+    {
+      frame.set_end_stream(true);
+      endSent_ = true;
+      useful = true;
+    }
+    more = batch >= kMaxBatchBytes;
+    if (useful || batch > 0)
+    {
+      frames.push_back(std::move(frame));
+    }
+  }
+  if (wantWritable_ && !closing_ && !blocked_ && pendingBytes_ < sendWindow_)
+  {
+    wantWritable_ = false;
+    notify = true;
+  }
+  }
+
+  for (const RpcMessage& frame : frames)
+  {
+    channel->sendStreamFrame(frame);
+  }
+  if (notify && writableCallback_)
+  {
+    writableCallback_(shared_from_this());
+  }
+  removeIfDone();
+}
+
+void RpcStream::onFrame(const RpcMessage& frame)
+{
+  loop_->assertInLoopThread();
+  RpcStreamPtr self(shared_from_this());
+  if (frame.has_error() && frame.error() != NO_ERROR)
+  {
+    abort(ErrorCode_Name(frame.error()));
+    return;
+  }
+  if (frame.has_window())
+  {
+    {
+    MutexLockGuard lock(mutex_);
+    sendWindow_ += frame.window();
+    }
+    scheduleFlush();
+  }
+  for (int i = 0; i < frame.stream_data_size() && !remoteClosed_ && !closeNotified_; ++i)
+  {
+    const string& data = frame.stream_data(i);
+    MessagePtr message(prototype_->New());
+    if (!message->ParseFromString(data))
+    {
+      LOG_ERROR << "RpcStream::onFrame - invalid message of stream " << id_
+                << " " << method_->full_name();
+      {
+      MutexLockGuard lock(mutex_);
+      aborted_ = true;
+      pending_.clear();
+      pendingBytes_ = 0;
+      }
+      resetInLoop(opener_ ? INVALID_RESPONSE : INVALID_REQUEST);
+      return;
+    }
+    consumed_ += cost(data);
+    if (messageCallback_)
+    {
+      messageCallback_(self, message);
+    }
+  }
+  if (!paused_ && consumed_ >= kInitialWindow / 2)
+  {
+    grant_ += consumed_;
+    consumed_ = 0;
+    scheduleFlush();
+  }
+  if (frame.end_stream() && !remoteClosed_)
+  {
+    remoteClosed_ = true;
+    finish(string());
+  }
+  removeIfDone();
+}
+
+void RpcStream::abort(const string& reason)
+{
+  loop_->assertInLoopThread();
+  {
+  MutexLockGuard lock(mutex_);
+  aborted_ = true;
+  pending_.clear();
+  pendingBytes_ = 0;
+  }
+  finish(reason);
+  removeIfDone();
+}
+
+void RpcStream::finish(const string& reason)
+{
+  if (closeNotified_)
+  {
+    return;
+  }
+  closeNotified_ = true;
+  error_ = reason;
+  if (closeCallback_)
+  {
+    closeCallback_(shared_from_this());
+  }
+}
+
+void RpcStream::removeIfDone()
+{
+  if (removed_)
+  {
+    return;
+  }
+  bool done = false;
+  {
+  MutexLockGuard lock(mutex_);
+  done = aborted_ || (endSent_ && remoteClosed_);
+  }
+  if (done)
+  {
+    removed_ = true;
+    RpcStreamPtr self(shared_from_this());
+    RpcChannelPtr channel(channel_.lock());
+    if (channel)
+    {
+      channel->removeStream(self);
+    }
+  }
+}
@@ -0,0 +1,184 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCSTREAM_H
+#define MUDUO_NET_PROTORPC_RPCSTREAM_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/protobuf/ProtobufCodecLite.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace google {
+namespace protobuf {
+
+class MethodDescriptor;
+class Message;
+
+}  // namespace protobuf
+}  // namespace google
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class RpcChannel;
+class RpcMessage;
+class RpcStream;
+typedef std::shared_ptr<RpcStream> RpcStreamPtr;
+
+/// A sequence of messages in each direction of a method, over an RpcChannel.
+///
+/// The opener sends messages of method->input_type() and receives messages of
+/// method->output_type(), the acceptor the other way round. Server push is
+/// a stream whose opener writes one message, bidirectional streams write
+/// any number on both sides.
+///
+/// Each direction is flow controlled by a window of kInitialWindow bytes,
+/// which the receiver replenishes after its message callback returns.
+/// A message larger than the window is sent alone, when the whole window
+/// is available.
+/// Messages written in one loop iteration are batched into few frames.
+/// write() returns false once the window is used up, or the output buffer
+/// of the connection is above RpcChannel::setStreamHighWaterMark(),
+/// the producer should stop then and resume in writable callback.
+///
+/// @code
+/// RpcStreamPtr stream = channel->newStream(FeedService::descriptor()->method(0));
+/// stream->setMessageCallback(onUpdate);
+/// stream->setCloseCallback(onClose);
+/// stream->open();
+/// stream->write(request);
+/// stream->close();  // no more requests, updates keep coming
+/// @endcode
+///
+/// Callbacks run in the I/O thread of the connection. write(), close(),
+/// reset() and open() are thread safe.
+class RpcStream : noncopyable,
+                  public std::enable_shared_from_this<RpcStream>
+{
+ public:
+  typedef std::function<void (const RpcStreamPtr&,
+                              const MessagePtr&)> MessageCallback;
+  typedef std::function<void (const RpcStreamPtr&)> WritableCallback;
+  typedef std::function<void (const RpcStreamPtr&)> CloseCallback;
+
+  static const int kInitialWindow = 256 * 1024;
+  static const int kMaxBatchBytes = 64 * 1024;
+
+  // use RpcChannel::newStream()
+  RpcStream(const std::shared_ptr<RpcChannel>& channel,
+            EventLoop* loop,
+            int64_t id,
+            const ::google::protobuf::MethodDescriptor* method,
+            bool opener);
+
+  int64_t id() const { return id_; }
+  const ::google::protobuf::MethodDescriptor* method() const { return method_; }
+  bool isOpener() const { return opener_; }
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Not thread safe, set them before open(), or in the accept callback.
+  void setMessageCallback(const MessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Called after write() returned false, when the stream is writable again.
+  void setWritableCallback(const WritableCallback& cb)
+  { writableCallback_ = cb; }
+
+  /// Called once, after the last message from peer, error() is empty
+  /// if the peer closed its side normally.
+  void setCloseCallback(const CloseCallback& cb)
+  { closeCallback_ = cb; }
+
+  /// Sends the open frame, along with messages written before.
+  void open();
+
+  /// Queues message, returns false if the producer should wait for
+  /// writable callback. The message is queued nevertheless, unless
+  /// the stream is closed.
+  bool write(const ::google::protobuf::Message& message);
+  bool writable() const;
+  size_t pendingBytes() const;
+
+  /// Half close, no more messages from this side.
+  /// Queued messages are sent before that.
+  void close();
+
+  /// Aborts both directions, drops queued messages, peer gets "CANCELED".
+  void reset();
+
+  /// Stops replenishing the window of peer, it stops sending once
+  /// the window is used up. Messages already sent are still delivered.
+  /// Must be called in I/O thread.
+  void pauseReading();
+  void resumeReading();
+
+  /// Reason of closing, valid in close callback.
+  const string& error() const { return error_; }
+
+ private:
+  friend class RpcChannel;
+
+  // called by RpcChannel, in I/O thread
+  void openInLoop();
+  void onFrame(const RpcMessage& frame);
+  void setBlocked(bool blocked);
+  void abort(const string& reason);
+
+  void scheduleFlush();
+  void flush();
+  void finish(const string& reason);
+  void removeIfDone();
+  void resetInLoop(int error);  // ErrorCode of rpc.proto
+
+  const std::weak_ptr<RpcChannel> channel_;
+  EventLoop* const loop_;
+  const int64_t id_;
+  const ::google::protobuf::MethodDescriptor* const method_;
+  const ::google::protobuf::Message* const prototype_;  // of incoming messages
+  const bool opener_;
+
+  MessageCallback messageCallback_;
+  WritableCallback writableCallback_;
+  CloseCallback closeCallback_;
+
+  mutable MutexLock mutex_;
+  std::deque<string> pending_ GUARDED_BY(mutex_);
+  int64_t pendingBytes_ GUARDED_BY(mutex_);
+  int64_t sendWindow_ GUARDED_BY(mutex_);
+  bool opened_ GUARDED_BY(mutex_);
+  bool closing_ GUARDED_BY(mutex_);  // close() called
+  bool aborted_ GUARDED_BY(mutex_);
+  bool blocked_ GUARDED_BY(mutex_);  // by high water mark of connection
+  bool flushScheduled_ GUARDED_BY(mutex_);
+  bool wantWritable_ GUARDED_BY(mutex_);
+
+  // in I/O thread
+  bool openSent_;
+  bool endSent_;
+  bool remoteClosed_;
+  bool closeNotified_;
+  bool removed_;
+  bool paused_;
+  int64_t consumed_;  // not granted to peer yet
+  int64_t grant_;  // to be sent to peer
+  string error_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCSTREAM_H
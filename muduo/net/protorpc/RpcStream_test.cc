@@ -0,0 +1,249 @@
+#include "muduo/net/protorpc/RpcStream.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/RpcServer.h"
+#include "muduo/net/protorpc/rpcservice.pb.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+
+#include <google/protobuf/descriptor.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kPort = 27820;
+const int kMessageSize = 10000;
+
+// listRpc as a stream, the opener writes ListRpcRequest
+const ::google::protobuf::MethodDescriptor* streamMethod()
+{
+  return RpcService::descriptor()->FindMethodByName("listRpc");
+}
+
+// bytes of window used by a message
+int64_t cost(const ::google::protobuf::Message& message)
+{
+  return static_cast<int64_t>(message.ByteSizeLong()) + 1;
+}
+
+// the accepted side of every test
+struct Acceptor
+{
+  Acceptor()
+    : paused(false),
+      received(0),
+      closed(false)
+  {
+  }
+
+  void onAccept(const RpcStreamPtr& s)
+  {
+    stream = s;
+    if (paused)
+    {
+      s->pauseReading();
+    }
+    s->setMessageCallback([this](const RpcStreamPtr&, const MessagePtr& message) {
+      const ListRpcRequest& request = static_cast<const ListRpcRequest&>(*message);
+      // in order
+      BOOST_CHECK_EQUAL(request.list_method(), received % 2 == 1);
+      ++received;
+    });
+    s->setCloseCallback([this](const RpcStreamPtr& closing) {
+      closed = true;
+      error = closing->error();
+    });
+  }
+
+  RpcStreamPtr stream;
+  bool paused;
+  int received;
+  bool closed;
+  string error;
+};
+
+// an RpcServer accepting streams and a client channel, in one loop
+struct Fixture
+{
+  Fixture()
+    : listenAddr("127.0.0.1", kPort),
+      server(&loop, listenAddr),
+      client(&loop, listenAddr, "RpcStreamTest"),
+      channel(new RpcChannel)
+  {
+    server.registerStream(streamMethod(), std::bind(&Acceptor::onAccept, &acceptor, _1));
+    server.start();
+    client.setConnectionCallback([this](const TcpConnectionPtr& conn) {
+      if (conn->connected())
+      {
+        channel->setConnection(conn);
+        conn->setMessageCallback(
+            std::bind(&RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
+        loop.quit();
+      }
+      else
+      {
+        channel->cancelAll();
+      }
+    });
+    client.connect();
+    loop.loop();
+  }
+
+  ~Fixture()
+  {
+    client.disconnect();
+    runFor(0.1);
+  }
+
+  // also runs what was queued from outside the loop
+  void runFor(double seconds)
+  {
+    loop.wakeup();
+    loop.runAfter(seconds, [this] { loop.quit(); });
+    loop.loop();
+  }
+
+  RpcStreamPtr open()
+  {
+    RpcStreamPtr stream(channel->newStream(streamMethod()));
+    stream->setWritableCallback([this](const RpcStreamPtr&) { ++writable; });
+    stream->setCloseCallback([this](const RpcStreamPtr& s) {
+      openerClosed = true;
+      openerError = s->error();
+    });
+    stream->open();
+    return stream;
+  }
+
+  // writes until write() returns false, returns number of messages written
+  int writeUntilFull(const RpcStreamPtr& stream, int max)
+  {
+    ListRpcRequest request;
+    request.set_service_name(string(kMessageSize, 'x'));
+    for (int i = 0; i < max; ++i)
+    {
+      request.set_list_method(written++ % 2 == 1);
+      if (!stream->write(request))
+      {
+        return i + 1;
+      }
+    }
+    return max;
+  }
+
+  EventLoop loop;
+  InetAddress listenAddr;
+  Acceptor acceptor;
+  RpcServer server;
+  TcpClient client;
+  RpcChannelPtr channel;
+  int written = 0;
+  int writable = 0;
+  bool openerClosed = false;
+  string openerError;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testWindow)
+{
+  Fixture f;
+  f.acceptor.paused = true;
+  RpcStreamPtr stream = f.open();
+  const int kMessages = 40;
+  int written = f.writeUntilFull(stream, kMessages);
+  // the window is used up before all are written
+  BOOST_CHECK_LT(written, kMessages);
+  BOOST_CHECK(!stream->writable());
+  // queued anyway
+  for (int i = written; i < kMessages; )
+  {
+    i += f.writeUntilFull(stream, kMessages - i);
+  }
+  f.runFor(0.2);
+
+  ListRpcRequest sample;
+  sample.set_service_name(string(kMessageSize, 'x'));
+  sample.set_list_method(true);
+  const int64_t n = cost(sample);
+  // not a byte beyond the window while the acceptor is not reading
+  BOOST_CHECK_EQUAL(f.acceptor.received, static_cast<int>(RpcStream::kInitialWindow / n));
+  BOOST_CHECK_EQUAL(f.writable, 0);
+  BOOST_CHECK(stream->pendingBytes() > 0);
+
+  // WINDOW_UPDATE
+  f.acceptor.stream->resumeReading();
+  f.runFor(0.2);
+  BOOST_CHECK_EQUAL(f.acceptor.received, kMessages);
+  BOOST_CHECK_EQUAL(stream->pendingBytes(), 0u);
+  BOOST_CHECK_EQUAL(f.writable, 1);
+  BOOST_CHECK(stream->writable());
+
+  stream->close();
+  f.runFor(0.05);
+  BOOST_CHECK(f.acceptor.closed);
+  BOOST_CHECK_EQUAL(f.acceptor.error, "");
+  f.acceptor.stream->close();
+  f.runFor(0.05);
+  BOOST_CHECK(f.openerClosed);
+  BOOST_CHECK_EQUAL(f.openerError, "");
+  BOOST_CHECK_EQUAL(f.channel->numStreams(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testLargerThanWindow)
+{
+  Fixture f;
+  RpcStreamPtr stream = f.open();
+  ListRpcRequest request;
+  request.set_service_name(string(RpcStream::kInitialWindow * 2, 'x'));
+  stream->write(request);
+  request.set_list_method(true);
+  stream->write(request);
+  f.written = 2;
+  f.runFor(0.2);
+  BOOST_CHECK_EQUAL(f.acceptor.received, 2);
+  BOOST_CHECK_EQUAL(stream->pendingBytes(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testReset)
+{
+  Fixture f;
+  RpcStreamPtr stream = f.open();
+  f.writeUntilFull(stream, 2);
+  f.runFor(0.05);
+  BOOST_CHECK_EQUAL(f.acceptor.received, 2);
+
+  stream->reset();
+  ListRpcRequest request;
+  BOOST_CHECK(!stream->write(request));
+  f.runFor(0.05);
+  BOOST_CHECK(f.openerClosed);
+  BOOST_CHECK_EQUAL(f.openerError, "CANCELED");
+  BOOST_CHECK(f.acceptor.closed);
+  BOOST_CHECK_EQUAL(f.acceptor.error, "CANCELED");
+  BOOST_CHECK_EQUAL(f.channel->numStreams(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testAbortByDisconnect)
+{
+  Fixture f;
+  RpcStreamPtr stream = f.open();
+  f.writeUntilFull(stream, 2);
+  f.runFor(0.05);
+  BOOST_CHECK_EQUAL(f.acceptor.received, 2);
+
+  f.client.disconnect();
+  f.runFor(0.05);
+  BOOST_CHECK(f.openerClosed);
+  BOOST_CHECK_EQUAL(f.openerError, "CANCELED");
+  BOOST_CHECK(f.acceptor.closed);
+  BOOST_CHECK_EQUAL(f.acceptor.error, "CANCELED");
+  BOOST_CHECK_EQUAL(f.channel->numStreams(), 0u);
+}
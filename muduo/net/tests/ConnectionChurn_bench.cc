@@ -0,0 +1,192 @@
+// Connection churn: a client keeps a window of connections open, closing a
+// random one for each new one, so connection-scoped objects are freed in
+// an order unrelated to their allocation. Reports connections per second,
+// RSS and fragmentation of the heap.
+//
+// Usage: connectionchurn_bench [io_threads] [connections] [window]
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/SlabAllocator.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+
+#include <atomic>
+#include <vector>
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+std::atomic<int> g_alive(0);
+std::atomic<int> g_total(0);
+
+long rssKiB()
+{
+  long pages = 0, rss = 0;
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if (fp)
+  {
+    if (fscanf(fp, "%ld %ld", &pages, &rss) != 2)
+    {
+      rss = 0;
+    }
+    fclose(fp);
+  }
+  return rss * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+struct HeapStats
+{
+  size_t arena;     // from sbrk()
+  size_t mmapped;   // large blocks
+  size_t inUse;     // of arena
+  size_t free;      // of arena
+};
+
+HeapStats heapStats()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2();
+#else
+  // int fields, which wrap beyond 2GiB
+  struct mallinfo mi = mallinfo();
+#endif
+  HeapStats stats = { static_cast<size_t>(mi.arena), static_cast<size_t>(mi.hblkhd),
+                      static_cast<size_t>(mi.uordblks), static_cast<size_t>(mi.fordblks) };
+  return stats;
+}
+
+void report(const char* when, const std::vector<EventLoop*>& loops)
+{
+  HeapStats heap = heapStats();
+  printf("%-8s rss %6ld KiB, heap %6zd KiB, in use %6zd KiB, free %6zd KiB (%.1f%% fragmented)\n",
+         when, rssKiB(), (heap.arena + heap.mmapped) / 1024, (heap.inUse + heap.mmapped) / 1024,
+         heap.free / 1024,
+         heap.arena ? 100.0 * static_cast<double>(heap.free) / static_cast<double>(heap.arena) : 0.0);
+  SlabAllocator::Stats total = { 0, 0, 0, 0 };
+  for (EventLoop* loop : loops)
+  {
+    SlabAllocator::Stats stats = loop->allocator()->stats();
+    total.slabBytes += stats.slabBytes;
+    total.bytesInUse += stats.bytesInUse;
+    total.allocations += stats.allocations;
+    total.fallbacks += stats.fallbacks;
+  }
+  printf("         pools %6zd KiB, in use %6zd KiB, %lld allocations, %lld fallbacks\n",
+         total.slabBytes / 1024, total.bytesInUse / 1024,
+         static_cast<long long>(total.allocations), static_cast<long long>(total.fallbacks));
+}
+
+int connectionsAlive(const std::vector<EventLoop*>& loops)
+{
+  int alive = 0;
+  for (EventLoop* loop : loops)
+  {
+    alive += loop->numConnections();
+  }
+  return alive;
+}
+
+int connectTo(const InetAddress& addr)
+{
+  int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sockfd < 0 || ::connect(sockfd, addr.getSockAddr(), sizeof(struct sockaddr_in)) < 0)
+  {
+    perror("connect");
+    abort();
+  }
+  return sockfd;
+}
+
+void churn(const InetAddress& addr, int connections, int window)
+{
+  std::vector<int> open;
+  uint32_t random = 2463534242;
+  char buf[16] = "hello";
+  for (int i = 0; i < connections; ++i)
+  {
+    if (static_cast<int>(open.size()) >= window)
+    {
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      size_t victim = random % open.size();
+      ::close(open[victim]);
+      open[victim] = open.back();
+      open.pop_back();
+    }
+    int sockfd = connectTo(addr);
+    // a round trip, so the server has established the connection
+    if (::write(sockfd, buf, sizeof buf) != sizeof buf
+        || ::read(sockfd, buf, sizeof buf) <= 0)
+    {
+      perror("echo");
+      abort();
+    }
+    open.push_back(sockfd);
+  }
+  for (int sockfd : open)
+  {
+    ::close(sockfd);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int ioThreads = argc > 1 ? atoi(argv[1]) : 2;
+  int connections = argc > 2 ? atoi(argv[2]) : 20000;
+  int window = argc > 3 ? atoi(argv[3]) : 1000;
+  Logger::setLogLevel(Logger::WARN);
+
+  EventLoop loop;
+  InetAddress listenAddr("127.0.0.1", 23456);
+  TcpServer server(&loop, listenAddr, "ConnectionChurn");
+  server.setThreadNum(ioThreads);
+  server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      ++g_alive;
+      ++g_total;
+    }
+    else
+    {
+      --g_alive;
+    }
+  });
+  server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->send(buf);
+  });
+  server.start();
+  printf("%d io threads, %d connections, window %d\n", ioThreads, connections, window);
+  std::vector<EventLoop*> loops = server.threadPool()->getAllLoops();
+  report("start", loops);
+
+  Timestamp start;
+  Thread client([&] {
+    start = Timestamp::now();
+    churn(listenAddr, connections, window);
+    // wait for the server to destroy them all, in their loops
+    while (g_alive.load() > 0 || connectionsAlive(loops) > 0)
+    {
+      ::usleep(1000);
+    }
+    loop.quit();
+  }, "client");
+  client.start();
+  loop.runEvery(1.0, [&loops] { report("churn", loops); });
+  loop.loop();
+  client.join();
+
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%d connections in %.2fs, %.0f connections/s\n",
+         g_total.load(), seconds, g_total.load() / seconds);
+  report("end", loops);
+}
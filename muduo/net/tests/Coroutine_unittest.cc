@@ -0,0 +1,140 @@
+#include "muduo/net/Coroutine.h"
+#include "muduo/net/Endian.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+
+#include <stdexcept>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// all run in the loop of main thread, where checks are safe
+int g_sessionsClosed = 0;
+
+coro::Task<int> add(EventLoop* loop, int a, int b)
+{
+  co_await coro::sleep(loop, 0.01);
+  co_return a + b;
+}
+
+coro::Task<> fail(EventLoop* loop)
+{
+  co_await coro::sleep(loop, 0.001);
+  throw std::runtime_error("fail");
+}
+
+coro::Task<> testTasks(EventLoop* loop, bool* done)
+{
+  Timestamp start(Timestamp::now());
+  int sum = co_await add(loop, 1, 2);
+  BOOST_CHECK_EQUAL(sum, 3);
+  BOOST_CHECK(timeDifference(Timestamp::now(), start) >= 0.01);
+  BOOST_CHECK(loop->isInLoopThread());
+
+  bool caught = false;
+  try
+  {
+    co_await fail(loop);
+  }
+  catch (const std::runtime_error& e)
+  {
+    caught = true;
+  }
+  BOOST_CHECK(caught);
+  *done = true;
+}
+
+// echoes length prefixed messages
+coro::Task<> session(TcpConnectionPtr conn)
+{
+  coro::Stream stream(conn);
+  while (Buffer* buf = co_await stream.read(sizeof(int32_t)))
+  {
+    size_t len = static_cast<size_t>(buf->peekInt32());
+    buf = co_await stream.read(sizeof(int32_t) + len);
+    if (!buf)
+    {
+      break;
+    }
+    string message(buf->peek(), sizeof(int32_t) + len);
+    buf->retrieve(sizeof(int32_t) + len);
+    bool ok = co_await stream.write(message);
+    BOOST_CHECK(ok);
+  }
+  BOOST_CHECK_EQUAL(conn->inputBuffer()->readableBytes(), 0u);
+  ++g_sessionsClosed;
+}
+
+coro::Task<> testClient(EventLoop* loop, TcpClient* client, bool* done)
+{
+  TcpConnectionPtr conn = co_await coro::connect(client);
+  BOOST_CHECK(conn && conn->connected());
+  coro::Stream stream(conn);
+  for (size_t len : { 0, 1, 100, 100000 })
+  {
+    // sent in two pieces, to split the frame
+    string payload(len, 'x');
+    int32_t be32 = sockets::hostToNetwork32(static_cast<int32_t>(len));
+    bool ok = co_await stream.write(StringPiece(reinterpret_cast<const char*>(&be32), 2));
+    BOOST_CHECK(ok);
+    co_await coro::sleep(loop, 0.001);
+    Buffer frame;
+    frame.append(reinterpret_cast<const char*>(&be32) + 2, 2);
+    frame.append(payload);
+    ok = co_await stream.write(&frame);
+    BOOST_CHECK(ok);
+
+    Buffer* buf = co_await stream.read(sizeof(int32_t) + len);
+    BOOST_CHECK(buf != NULL);
+    if (buf == NULL)
+    {
+      break;
+    }
+    BOOST_CHECK_EQUAL(static_cast<size_t>(buf->readInt32()), len);
+    BOOST_CHECK_EQUAL(string(buf->peek(), len), payload);
+    buf->retrieve(len);
+  }
+  stream.shutdown();
+  // read until the server closes
+  Buffer* eof = co_await stream.read();
+  BOOST_CHECK(eof == NULL);
+  *done = true;
+  loop->quit();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testCoroutines)
+{
+  EventLoop loop;
+  bool tasksDone = false;
+  coro::spawn(testTasks(&loop, &tasksDone));
+  BOOST_CHECK(!tasksDone);
+
+  InetAddress listenAddr("127.0.0.1", 28765);
+  TcpServer server(&loop, listenAddr, "CoroutineServer");
+  server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      coro::spawn(session(conn));
+    }
+  });
+  server.start();
+
+  TcpClient client(&loop, listenAddr, "CoroutineClient");
+  bool clientDone = false;
+  coro::spawn(testClient(&loop, &client, &clientDone));
+  loop.runAfter(10, [&loop] { loop.quit(); });
+  loop.loop();
+
+  BOOST_CHECK(tasksDone);
+  BOOST_CHECK(clientDone);
+  BOOST_CHECK_EQUAL(g_sessionsClosed, 1);
+}
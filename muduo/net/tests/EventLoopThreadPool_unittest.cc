@@ -1,8 +1,14 @@
 #include "muduo/net/EventLoopThreadPool.h"
 #include "muduo/net/EventLoop.h"
+#include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Thread.h"
 
+#include <algorithm>
+#include <atomic>
+
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 using namespace muduo;
@@ -63,6 +69,134 @@ int main()
     assert(nextLoop == model.getNextLoop());
   }
 
+  {
+    printf("Pinned threads:\n");
+    EventLoopThreadPool model(&loop, "pinned");
+    model.setThreadNum(2);
+    model.setCpuAffinity({ {0} }, true);
+    model.start(init);
+    EventLoop* first = model.getLoopForCpu(0);
+    EventLoop* second = model.getLoopForCpu(0);
+    if (first == NULL || second == NULL || first == second
+        || model.getLoopForCpu(1) != NULL)
+    {
+      printf("getLoopForCpu FAIL\n");
+      abort();
+    }
+    CountDownLatch latch(2);
+    std::atomic<int> wellPinned(0);
+    for (EventLoop* pinned : { first, second })
+    {
+      pinned->runInLoop([pinned, &latch, &wellPinned] {
+        cpu_set_t set;
+        pthread_getaffinity_np(pthread_self(), sizeof set, &set);
+        printf("pinned: cpus = %d, cpu0 = %d, numa node = %d\n",
+               CPU_COUNT(&set), CPU_ISSET(0, &set) ? 1 : 0, pinned->numaNode());
+        if (CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set) && pinned->numaNode() >= 0)
+        {
+          ++wellPinned;
+        }
+        latch.countDown();
+      });
+    }
+    // EventLoop::quit() is lost if called before loop()
+    latch.wait();
+    if (wellPinned != 2)
+    {
+      printf("setCpuAffinity FAIL\n");
+      abort();
+    }
+  }
+
+  {
+    printf("Least connections:\n");
+    EventLoopThreadPool model(&loop, "least");
+    model.setThreadNum(3);
+    model.setPlacement(EventLoopThreadPool::kLeastConnections);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    loops[0]->addConnections(2);
+    loops[1]->addConnections(1);
+    // the emptiest loop, ties are broken by round-robin
+    EventLoop* expected[] = { loops[2], loops[1], loops[2], loops[0], loops[1], loops[2] };
+    for (EventLoop* e : expected)
+    {
+      EventLoop* next = model.getNextLoop();
+      if (next != e)
+      {
+        printf("kLeastConnections FAIL\n");
+        abort();
+      }
+      next->addConnections(1);
+    }
+
+    model.setPlacement(EventLoopThreadPool::kPowerOfTwoChoices);
+    for (int i = 0; i < 3000; ++i)
+    {
+      model.getNextLoop()->addConnections(1);
+    }
+    printf("power of two choices: %d %d %d\n", loops[0]->numConnections(),
+           loops[1]->numConnections(), loops[2]->numConnections());
+    // a random choice is off by tens, two choices by a few
+    int most = std::max({ loops[0]->numConnections(), loops[1]->numConnections(),
+                          loops[2]->numConnections() });
+    int least = std::min({ loops[0]->numConnections(), loops[1]->numConnections(),
+                           loops[2]->numConnections() });
+    if (most - least > 5)
+    {
+      printf("kPowerOfTwoChoices FAIL\n");
+      abort();
+    }
+    for (EventLoop* l : loops)
+    {
+      l->addConnections(-l->numConnections());
+      l->runInLoop(std::bind(print, l));
+    }
+    CountDownLatch latch(3);
+    for (EventLoop* l : loops)
+    {
+      l->runInLoop([&latch] { latch.countDown(); });
+    }
+    latch.wait();
+
+    // the first two are busy for a while, the third is idle
+    model.setPlacement(EventLoopThreadPool::kLeastBusy);
+    CountDownLatch busy(2);
+    loops[0]->runInLoop([&busy] { ::usleep(20 * 1000); busy.countDown(); });
+    loops[1]->runInLoop([&busy] { ::usleep(50 * 1000); busy.countDown(); });
+    busy.wait();
+    // busy time is added after the iteration, and sampled every 100ms
+    ::usleep(EventLoopThreadPool::kBusySampleInterval * 1000 + 50 * 1000);
+    // connections of a burst don't show up in busy time
+    for (int i = 0; i < 3; ++i)
+    {
+      EventLoop* next = model.getNextLoop();
+      if (next != loops[2])
+      {
+        printf("kLeastBusy FAIL\n");
+        abort();
+      }
+      next->addConnections(1);
+    }
+    // all idle since, the fewest connections then
+    ::usleep(EventLoopThreadPool::kBusySampleInterval * 1000 + 50 * 1000);
+    EventLoop* expectedIdle[] = { loops[0], loops[1] };
+    for (EventLoop* e : expectedIdle)
+    {
+      EventLoop* next = model.getNextLoop();
+      if (next != e)
+      {
+        printf("kLeastBusy FAIL\n");
+        abort();
+      }
+      next->addConnections(1);
+    }
+    for (EventLoop* l : loops)
+    {
+      l->addConnections(-l->numConnections());
+    }
+  }
+
   loop.loop();
 }
 
@@ -0,0 +1,142 @@
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+
+#include <atomic>
+#include <memory>
+
+#include <stdlib.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// counts every operator new, of all threads and of the calling thread
+std::atomic<int64_t> g_allocations(0);
+__thread int64_t t_allocations = 0;
+
+void* operator new(size_t size)
+{
+  ++g_allocations;
+  ++t_allocations;
+  void* p = ::malloc(size == 0 ? 1 : size);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+// gcc sees free() of what operator new returned
+#if __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept
+{
+  ::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  ::free(p);
+}
+
+namespace
+{
+
+class Session
+{
+ public:
+  void send(const string& message) { bytes_ += message.size(); }
+  void close() { ++closed_; }
+  size_t bytes() const { return bytes_; }
+
+ private:
+  size_t bytes_ = 0;
+  int closed_ = 0;
+};
+
+const int kFunctors = 10000;
+
+void postMany(EventLoop* loop, Session* session, const std::shared_ptr<Session>& shared)
+{
+  for (int i = 0; i < kFunctors; ++i)
+  {
+    // the common cases: a lambda holding a shared_ptr, a bound member function
+    // with this and a short string, as TcpConnection::send() of another thread
+    loop->queueInLoop([shared] { shared->close(); });
+    loop->runInLoop(std::bind(&Session::send, session, string("hello")));
+  }
+}
+
+// The pending queue is two vectors, one is filled while the loop runs
+// the other. Grows both to kFunctors * 2 + 1, by filling one while
+// the loop is blocked in a functor of the other.
+void warmUp(EventLoop* loop, Session* session, const std::shared_ptr<Session>& shared)
+{
+  CountDownLatch started1(1), release1(1), started2(1), release2(1), done(1);
+  loop->queueInLoop([&] { started1.countDown(); release1.wait(); });
+  started1.wait();
+  loop->queueInLoop([&] { started2.countDown(); release2.wait(); });
+  postMany(loop, session, shared);
+  release1.countDown();
+  started2.wait();
+  postMany(loop, session, shared);
+  loop->queueInLoop([&done] { done.countDown(); });
+  release2.countDown();
+  done.wait();
+}
+
+// posts from this thread while the loop is blocked, so the queue is full
+void post(EventLoop* loop, Session* session, const std::shared_ptr<Session>& shared)
+{
+  CountDownLatch started(1);
+  CountDownLatch blocked(1);
+  CountDownLatch done(1);
+  loop->queueInLoop([&started, &blocked] { started.countDown(); blocked.wait(); });
+  started.wait();
+  postMany(loop, session, shared);
+  loop->queueInLoop([&done] { done.countDown(); });
+  blocked.countDown();
+  done.wait();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testInline)
+{
+  std::shared_ptr<Session> session(new Session);
+  EventLoop::Functor lambda([session] { session->close(); });
+  BOOST_CHECK(lambda.isInline());
+  EventLoop::Functor bound(std::bind(&Session::send, get_pointer(session), string("hello")));
+  BOOST_CHECK(bound.isInline());
+  TimerCallback timer(std::bind(&Session::close, session));
+  BOOST_CHECK(timer.isInline());
+  Channel::ReadEventCallback read(std::bind(&Session::send, get_pointer(session), string()));
+  BOOST_CHECK(read.isInline());
+  BOOST_CHECK_LE(sizeof(EventLoop::Functor), 64u);
+}
+
+BOOST_AUTO_TEST_CASE(testNoAllocation)
+{
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+  std::shared_ptr<Session> session(new Session);
+  warmUp(loop, get_pointer(session), session);
+
+  int64_t global = g_allocations.load();
+  int64_t local = t_allocations;
+  post(loop, get_pointer(session), session);
+  int64_t allocations = g_allocations.load() - global;
+  int64_t localAllocations = t_allocations - local;
+  BOOST_TEST_MESSAGE(kFunctors * 2 + 2 << " functors posted, " << allocations
+                     << " allocations, " << localAllocations << " in posting thread");
+  BOOST_CHECK_EQUAL(localAllocations, 0);
+  BOOST_CHECK_EQUAL(allocations, 0);
+  BOOST_CHECK_EQUAL(session->bytes(), 3u * kFunctors * 5);
+}
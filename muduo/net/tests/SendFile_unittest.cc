@@ -0,0 +1,216 @@
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const size_t kFileSize = 8 * 1024 * 1024 + 123;
+const int64_t kOffset = 100;
+const size_t kHighWaterMark = 1024 * 1024;
+
+// a temporary file of kFileSize bytes
+struct File
+{
+  File()
+    : fd(-1)
+  {
+    char path[] = "/tmp/sendfile_unittest_XXXXXX";
+    fd = ::mkstemp(path);
+    ::unlink(path);
+    content.resize(kFileSize);
+    for (size_t i = 0; i < kFileSize; ++i)
+    {
+      content[i] = static_cast<char>('a' + i % 26);
+    }
+    written = ::write(fd, content.data(), kFileSize);
+  }
+
+  ~File()
+  {
+    ::close(fd);
+  }
+
+  int fd;
+  string content;
+  ssize_t written;
+};
+
+// header, the file from kOffset, trailer, then 8 bytes from a pipe,
+// false if the pipe fails.
+bool sendAll(const TcpConnectionPtr& conn, int fd)
+{
+  conn->send("header");
+  conn->sendFile(fd, kOffset, kFileSize - kOffset);
+  conn->send("trailer");
+  int pipefd[2];
+  if (::pipe(pipefd) != 0)
+  {
+    return false;
+  }
+  bool ok = ::write(pipefd[1], "pipedata", 8) == 8;
+  conn->sendFile(pipefd[0], 0, 8);
+  ::close(pipefd[0]);
+  ::close(pipefd[1]);
+  conn->shutdown();
+  return ok;
+}
+
+// everything until the peer closes, empty if connecting fails
+string receive(const InetAddress& addr)
+{
+  string result;
+  int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  // so the output piles up for the high water mark
+  int rcvbuf = 16 * 1024;
+  if (::setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf) == 0
+      && ::connect(sockfd, addr.getSockAddr(), sizeof(struct sockaddr_in)) == 0)
+  {
+    ::usleep(100 * 1000);
+    char buf[65536];
+    ssize_t n;
+    while ((n = ::read(sockfd, buf, sizeof buf)) > 0)
+    {
+      result.append(buf, n);
+    }
+  }
+  ::close(sockfd);
+  return result;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testSendFile)
+{
+  File file;
+  BOOST_REQUIRE_EQUAL(file.written, static_cast<ssize_t>(kFileSize));
+  const string expected = "header" + file.content.substr(kOffset) + "trailer" + "pipedata";
+
+  EventLoop loop;
+  InetAddress listenAddr("127.0.0.1", 26543);
+  TcpServer server(&loop, listenAddr, "SendFile");
+  TcpConnectionPtr second;
+  CountDownLatch secondConnected(1);
+  int connections = 0;
+  bool firstSent = false;
+  std::atomic<int> writeCompletes(0);
+  std::atomic<int> highWaterMarks(0);
+  server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (!conn->connected())
+    {
+      return;
+    }
+    conn->setHighWaterMarkCallback(
+        [&highWaterMarks](const TcpConnectionPtr&, size_t len) {
+          BOOST_CHECK_GE(len, kHighWaterMark);
+          ++highWaterMarks;
+        },
+        kHighWaterMark);
+    if (++connections == 1)
+    {
+      firstSent = sendAll(conn, file.fd);  // in loop thread
+    }
+    else
+    {
+      second = conn;
+      secondConnected.countDown();
+    }
+  });
+  server.setWriteCompleteCallback([&writeCompletes](const TcpConnectionPtr&) {
+    ++writeCompletes;
+  });
+  server.start();
+
+  string firstReceived;
+  int firstHighWaterMarks = 0;
+  int firstWriteCompletes = 0;
+  string secondReceived;
+  bool secondSent = false;
+  Thread test([&] {
+    firstReceived = receive(listenAddr);
+    firstHighWaterMarks = highWaterMarks;
+    firstWriteCompletes = writeCompletes;
+
+    Thread client([&] { secondReceived = receive(listenAddr); });
+    client.start();
+    secondConnected.wait();
+    secondSent = sendAll(second, file.fd);  // from another thread
+    client.join();
+    loop.quit();
+  });
+  test.start();
+  loop.loop();
+  test.join();
+  second.reset();
+
+  BOOST_CHECK(firstSent);
+  BOOST_CHECK(firstReceived == expected);
+  BOOST_CHECK_EQUAL(firstHighWaterMarks, 1);
+  BOOST_CHECK_GE(firstWriteCompletes, 1);
+  BOOST_CHECK(secondSent);
+  BOOST_CHECK(secondReceived == expected);
+  BOOST_CHECK_EQUAL(highWaterMarks.load(), 2);
+  BOOST_CHECK_GE(writeCompletes.load(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(testShortFile)
+{
+  File file;
+  BOOST_REQUIRE_EQUAL(file.written, static_cast<ssize_t>(kFileSize));
+
+  EventLoop loop;
+  InetAddress listenAddr("127.0.0.1", 26544);
+  TcpServer server(&loop, listenAddr, "ShortFile");
+  int connections = 0;
+  std::atomic<int> disconnections(0);
+  server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (!conn->connected())
+    {
+      ++disconnections;
+      return;
+    }
+    if (++connections == 1)
+    {
+      // ends while the socket is blocked, in handleWrite()
+      conn->sendFile(file.fd, kOffset, kFileSize);
+    }
+    else
+    {
+      // ends at once, in sendFileInLoop()
+      conn->sendFile(file.fd, kFileSize, 10);
+    }
+    conn->send("trailer");
+  });
+  server.start();
+
+  string firstReceived;
+  string secondReceived;
+  Thread test([&] {
+    firstReceived = receive(listenAddr);
+    secondReceived = receive(listenAddr);
+    loop.quit();
+  });
+  test.start();
+  loop.loop();
+  test.join();
+
+  // what is there, then closed without the trailer
+  BOOST_CHECK(firstReceived == file.content.substr(kOffset));
+  BOOST_CHECK(secondReceived.empty());
+  BOOST_CHECK_EQUAL(disconnections.load(), 2);
+}
@@ -0,0 +1,52 @@
+#include "muduo/net/SlowEventLog.h"
+#include "muduo/net/EventLoop.h"
+
+#include <unistd.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+BOOST_AUTO_TEST_CASE(testSlowEvents)
+{
+  EventLoop loop;
+  loop.setSlowThreshold(0.01);
+  loop.runAfter(0.01, [] { });                  // fast
+  loop.runAfter(0.02, [] { ::usleep(20*1000); });  // slow timer
+  loop.runAfter(0.05, [&loop] {
+    loop.queueInLoop([] { ::usleep(20*1000); });  // slow functors
+  });
+  loop.runAfter(0.1, [&loop] { loop.quit(); });
+  loop.loop();
+
+  BOOST_TEST_MESSAGE(SlowEventLog::instance().toString());
+  std::vector<SlowEvent> events = SlowEventLog::instance().recent();
+  BOOST_REQUIRE_EQUAL(events.size(), 2u);
+  BOOST_CHECK_EQUAL(events[0].what.find("TimerQueue"), 0u);
+  BOOST_CHECK_GE(events[0].microSeconds, 20*1000);
+  BOOST_CHECK_EQUAL(events[1].what, "pending functors x1");
+  BOOST_CHECK_EQUAL(events[1].tid, CurrentThread::tid());
+}
+
+BOOST_AUTO_TEST_CASE(testOldestDropped)
+{
+  // BOOST_CHECK_EQUAL takes a reference, SlowEventLog::kCapacity has no definition
+  const size_t kCapacity = SlowEventLog::kCapacity;
+  int64_t total = SlowEventLog::instance().total();
+  for (size_t i = 0; i < kCapacity + 10; ++i)
+  {
+    SlowEvent event;
+    event.microSeconds = static_cast<int64_t>(i);
+    SlowEventLog::instance().append(std::move(event));
+  }
+  std::vector<SlowEvent> events = SlowEventLog::instance().recent();
+  BOOST_CHECK_EQUAL(events.size(), kCapacity);
+  BOOST_CHECK_EQUAL(events.front().microSeconds, 10);
+  BOOST_CHECK_EQUAL(events.back().microSeconds,
+                    static_cast<int64_t>(kCapacity + 9));
+  BOOST_CHECK_EQUAL(SlowEventLog::instance().total(),
+                    total + static_cast<int64_t>(kCapacity + 10));
+}
@@ -0,0 +1,274 @@
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SpliceRelay.h"
+#include "muduo/net/TcpServer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// counts every operator new of the calling thread
+__thread int64_t t_allocations = 0;
+
+void* operator new(size_t size)
+{
+  ++t_allocations;
+  void* p = ::malloc(size == 0 ? 1 : size);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+// gcc sees free() of what operator new returned
+#if __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept
+{
+  ::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  ::free(p);
+}
+
+namespace
+{
+
+const size_t kPayload = 8 * 1024 * 1024 + 321;
+const size_t kPipeSize = 64 * 1024;
+
+// -1 on failure
+int connectTo(const InetAddress& addr, int rcvbuf)
+{
+  int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sockfd >= 0
+      && (rcvbuf <= 0 || ::setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf) == 0)
+      && ::connect(sockfd, addr.getSockAddr(), sizeof(struct sockaddr_in)) == 0)
+  {
+    return sockfd;
+  }
+  ::close(sockfd);
+  return -1;
+}
+
+bool writeAll(int sockfd, const string& data)
+{
+  size_t written = 0;
+  while (written < data.size())
+  {
+    ssize_t n = ::write(sockfd, data.data() + written, data.size() - written);
+    if (n <= 0)
+    {
+      return false;
+    }
+    written += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// until EOF, what has been read on error
+string readAll(int sockfd)
+{
+  string result;
+  char buf[65536];
+  ssize_t n;
+  while ((n = ::read(sockfd, buf, sizeof buf)) > 0)
+  {
+    result.append(buf, n);
+  }
+  return result;
+}
+
+double cpuSeconds()
+{
+  struct rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+      + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testSpliceRelay)
+{
+  string payload(kPayload, '\0');
+  for (size_t i = 0; i < kPayload; ++i)
+  {
+    payload[i] = static_cast<char>('a' + i % 26);
+  }
+
+  EventLoop loop;
+  // any free port, so tests can run in parallel
+  TcpServer server(&loop, InetAddress("127.0.0.1", 0), "SpliceRelay");
+  const InetAddress listenAddr(server.listenAddress());
+  std::vector<TcpConnectionPtr> conns;
+  SpliceRelayPtr relay;
+  CountDownLatch closed(2);
+  std::atomic<int> disconnections(0);
+  server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      conns.push_back(conn);
+      if (conns.size() == 2)
+      {
+        relay = std::make_shared<SpliceRelay>(conns[0], conns[1], kPipeSize);
+        relay->start();
+      }
+    }
+    else
+    {
+      ++disconnections;
+      closed.countDown();
+    }
+  });
+  // kept for the relay
+  server.setMessageCallback([](const TcpConnectionPtr&, Buffer*, Timestamp) {});
+  server.start();
+
+  // results of the test thread, checked in this one
+  int first = -1;
+  int second = -1;
+  bool earlyWritten = false;
+  std::atomic<bool> payloadWritten(false);
+  double cpu = 0;
+  string secondReceived;
+  bool replyWritten = false;
+  string firstReceived;
+  Thread test([&] {
+    first = connectTo(listenAddr, 0);
+    earlyWritten = writeAll(first, "early");
+    ::usleep(100 * 1000);
+    // slow, so the relay stops reading the first
+    second = connectTo(listenAddr, 16 * 1024);
+    if (first < 0 || second < 0)
+    {
+      ::close(first);
+      ::close(second);
+      loop.quit();
+      return;
+    }
+
+    Thread writer([first, &payload, &payloadWritten] {
+      payloadWritten = writeAll(first, payload);
+      ::shutdown(first, SHUT_WR);
+    });
+    writer.start();
+    cpu = cpuSeconds();
+    ::usleep(300 * 1000);
+    cpu = cpuSeconds() - cpu;
+
+    // the first has half-closed, the other direction still works
+    secondReceived = readAll(second);
+    writer.join();
+    replyWritten = writeAll(second, "reply");
+    ::shutdown(second, SHUT_WR);
+    firstReceived = readAll(first);
+    closed.wait();
+    ::close(first);
+    ::close(second);
+    loop.quit();
+  });
+  test.start();
+  loop.loop();
+  test.join();
+
+  BOOST_REQUIRE_GE(first, 0);
+  BOOST_REQUIRE_GE(second, 0);
+  BOOST_CHECK(earlyWritten);
+  BOOST_CHECK(payloadWritten);
+  BOOST_TEST_MESSAGE(cpu << "s CPU when the second is not reading");
+  BOOST_CHECK_LT(cpu, 0.15);
+  BOOST_CHECK(secondReceived == "early" + payload);
+  BOOST_CHECK(replyWritten);
+  BOOST_CHECK_EQUAL(firstReceived, "reply");
+
+  BOOST_REQUIRE(relay);
+  BOOST_CHECK_EQUAL(relay->firstToSecond(), static_cast<int64_t>(kPayload));
+  BOOST_CHECK_EQUAL(relay->secondToFirst(), 5);
+  BOOST_REQUIRE_EQUAL(conns.size(), 2u);
+  BOOST_CHECK(conns[0]->disconnected() && conns[1]->disconnected());
+  BOOST_CHECK_EQUAL(disconnections.load(), 2);
+  relay.reset();
+  conns.clear();
+}
+
+// the loop thread allocates nothing per splice(2), one page at a time
+BOOST_AUTO_TEST_CASE(testNoAllocationPerHop)
+{
+  const size_t kPageSize = 4096;
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress("127.0.0.1", 0), "SpliceRelayHops");
+  const InetAddress listenAddr(server.listenAddress());
+  std::vector<TcpConnectionPtr> conns;
+  SpliceRelayPtr relay;
+  int64_t allocations = 0;
+  CountDownLatch closed(2);
+  server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      conns.push_back(conn);
+      if (conns.size() == 2)
+      {
+        relay = std::make_shared<SpliceRelay>(conns[0], conns[1], kPageSize);
+        relay->start();
+        allocations = t_allocations;
+      }
+    }
+    else
+    {
+      if (closed.getCount() == 2)
+      {
+        allocations = t_allocations - allocations;
+      }
+      closed.countDown();
+    }
+  });
+  server.setMessageCallback([](const TcpConnectionPtr&, Buffer*, Timestamp) {});
+  server.start();
+
+  std::atomic<size_t> received(0);
+  Thread test([&] {
+    int first = connectTo(listenAddr, 0);
+    int second = connectTo(listenAddr, 0);
+    Thread reader([second, &received] { received = readAll(second).size(); });
+    reader.start();
+    writeAll(first, string(kPayload, 'x'));
+    ::shutdown(first, SHUT_WR);
+    reader.join();
+    ::shutdown(second, SHUT_WR);
+    closed.wait();
+    ::close(first);
+    ::close(second);
+    loop.quit();
+  });
+  test.start();
+  loop.loop();
+  test.join();
+
+  BOOST_CHECK_EQUAL(received.load(), kPayload);
+  BOOST_REQUIRE(relay);
+  const int64_t minHops = static_cast<int64_t>(kPayload / kPageSize);
+  BOOST_TEST_MESSAGE(allocations << " allocations in " << minHops << "+ hops");
+  // a few for closing and for pausing when the reader falls behind
+  BOOST_CHECK_LT(allocations, minHops / 16);
+  relay.reset();
+  conns.clear();
+}
@@ -0,0 +1,100 @@
+#include "muduo/net/TcpInfoSampler.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// a peer which never reads
+int connectSlowPeer(const InetAddress& addr)
+{
+  int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int rcvbuf = 4096;
+  ::setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+  if (::connect(sockfd, addr.getSockAddr(), sizeof(struct sockaddr_in)) != 0)
+  {
+    ::close(sockfd);
+    return -1;
+  }
+  return sockfd;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testSlowPeer)
+{
+  EventLoop loop;
+  // any free port, so tests can run in parallel
+  TcpServer server(&loop, InetAddress("127.0.0.1", 0), "TcpInfoSampler_unittest");
+  const InetAddress serverAddr(server.listenAddress());
+  server.setThreadNum(2);
+
+  // set in the loop thread, checked after it quits
+  int slowPeers = 0;
+  size_t outputBytes = 0;
+  string report;
+  bool closed = false;
+  std::weak_ptr<TcpConnection> closedConn;
+  server.setTcpInfoSampling(0.05, 256 * 1024,
+      [&](const TcpConnectionPtr& conn, const TcpInfoSample& sample) {
+    // runs in loop of conn, reports once
+    if (conn->connected())
+    {
+      size_t bytes = static_cast<size_t>(sample.outputBytes);
+      string all = TcpInfoSampler::reportAll();
+      loop.runInLoop([&, bytes, all] {
+        ++slowPeers;
+        outputBytes = bytes;
+        report = all;
+      });
+      conn->forceClose();
+    }
+  });
+  server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      conn->send(string(4 * 1024 * 1024, 'x'));
+    }
+    else
+    {
+      std::weak_ptr<TcpConnection> weak(conn);
+      loop.runInLoop([&, weak] {
+        closed = true;
+        closedConn = weak;
+      });
+    }
+  });
+  server.start();
+
+  int sockfd = -1;
+  loop.runAfter(0.01, [&] { sockfd = connectSlowPeer(serverAddr); });
+  // quits once the connection is destroyed in its loop, as ~TcpServer
+  // doesn't wait for connections being destroyed.
+  loop.runEvery(0.01, [&] {
+    if (closed && closedConn.expired())
+    {
+      loop.quit();
+    }
+  });
+  loop.runAfter(5.0, [&] { loop.quit(); });
+  loop.loop();
+
+  BOOST_TEST_MESSAGE(report);
+  BOOST_CHECK_GE(sockfd, 0);
+  BOOST_CHECK(closed);
+  BOOST_CHECK_EQUAL(slowPeers, 1);
+  BOOST_CHECK_GE(outputBytes, 256 * 1024u);
+  BOOST_CHECK(report.find("1 connections sampled, 1 slow peers") != string::npos);
+  ::close(sockfd);
+}